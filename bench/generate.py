@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""Generate a large Lox script whose cost is mostly in the front end.
+
+The script declares many small functions and calls each of them once, so
+scanning, parsing, resolving and optimizing it take longer than running it.
+"""
+
+import argparse
+import sys
+
+TEMPLATE = """fun f{n}(a, b) {{
+  var x = a * 2 + b;
+  if (x > {n}) {{
+    x = x - 1;
+  }} else {{
+    x = x + 1;
+  }}
+  while (x > 100) x = x / 2;
+  for (var i = 0; i < b; i = i + 1) {{
+    var y = (x - i) * (x + i) / (1 + i);
+    if (y < 0 and !(y == -1) or y > 1000) x = x + 1;
+  }}
+  return x;
+}}
+var v{n} = f{n}({n}, "s{n}" == "s{n}" and 1);
+"""
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("output", help="path of the generated script")
+    parser.add_argument("--functions", type=int, default=20000,
+                        help="number of generated functions")
+    args = parser.parse_args()
+
+    with open(args.output, "w") as output:
+        output.write("// Generated by bench/generate.py, do not edit.\n")
+        for n in range(args.functions):
+            output.write(TEMPLATE.format(n=n))
+        output.write("print v{};\n".format(args.functions - 1))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""Run the Lox benchmark corpus and report wall time and peak RSS.
+
+Every benchmark is run several times. The results (median, minimum, maximum
+and standard deviation of the wall time and of the peak resident set size)
+are written as JSON, and can be compared against a baseline file saved by an
+earlier run.
+"""
+
+import argparse
+import json
+import os
+import statistics
+import subprocess
+import sys
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+
+
+def measure(command):
+    """Run the command once, returns its wall time (s) and peak RSS (KiB)."""
+    start = time.perf_counter()
+    process = subprocess.Popen(command, stdout=subprocess.PIPE,
+                               stderr=subprocess.STDOUT)
+    output = process.stdout.read()
+    _, status, usage = os.wait4(process.pid, 0)
+    wall = time.perf_counter() - start
+    process.stdout.close()
+
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        sys.exit("{} failed:\n{}".format(" ".join(command),
+                                         output.decode(errors="replace")))
+    # ru_maxrss is in KiB on Linux.
+    return wall, usage.ru_maxrss, output
+
+
+def summarize(samples):
+    return {
+        "median": statistics.median(samples),
+        "min": min(samples),
+        "max": max(samples),
+        "stdev": statistics.stdev(samples) if len(samples) > 1 else 0.0,
+    }
+
+
+def run_benchmark(binary, flags, script, runs):
+    command = [binary] + flags + [script]
+    walls, rss = [], []
+    expected = None
+    for _ in range(runs):
+        wall, peak, output = measure(command)
+        if expected is not None and output != expected:
+            sys.exit("{} printed different output on two runs".format(script))
+        expected = output
+        walls.append(wall)
+        rss.append(peak)
+
+    return {"wall_s": summarize(walls), "peak_rss_kib": summarize(rss)}
+
+
+def compare(results, baseline, threshold):
+    """Print the change of every median, returns whether any regressed."""
+    regressed = False
+    print("{:<16} {:>10} {:>10} {:>8}   {:>10} {:>10} {:>8}".format(
+        "benchmark", "wall", "base", "change", "rss KiB", "base", "change"),
+        file=sys.stderr)
+
+    for name, result in results["benchmarks"].items():
+        base = baseline["benchmarks"].get(name)
+        if base is None:
+            print("{:<16} (not in the baseline)".format(name), file=sys.stderr)
+            continue
+
+        row = [name]
+        for metric in ("wall_s", "peak_rss_kib"):
+            new = result[metric]["median"]
+            old = base[metric]["median"]
+            change = (new - old) / old * 100 if old else 0.0
+            mark = ""
+            if change > threshold:
+                mark = " !"
+                regressed = True
+            row += [new, old, "{:+.1f}%{}".format(change, mark)]
+
+        print("{:<16} {:>10.3f} {:>10.3f} {:>8}   {:>10} {:>10} {:>8}"
+              .format(*row), file=sys.stderr)
+
+    return regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--binary", default="out/bin/cpplox",
+                        help="interpreter to benchmark")
+    parser.add_argument("--flags", default="",
+                        help="options passed to the interpreter, e.g. "
+                             "'--engine=vm'")
+    parser.add_argument("--runs", type=int, default=5,
+                        help="runs of every benchmark")
+    parser.add_argument("--output", help="file the JSON results are saved to")
+    parser.add_argument("--baseline",
+                        help="results of an earlier run to compare against")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="slowdown or growth (in percent) of a median "
+                             "which counts as a regression")
+    parser.add_argument("--generated-dir", default="out/bench",
+                        help="directory of the generated front end script")
+    args = parser.parse_args()
+
+    os.makedirs(args.generated_dir, exist_ok=True)
+    generated = os.path.join(args.generated_dir, "generated.lox")
+    subprocess.check_call([sys.executable,
+                           os.path.join(BENCH_DIR, "generate.py"), generated])
+
+    scripts = sorted(os.path.join(BENCH_DIR, name)
+                     for name in os.listdir(BENCH_DIR) if name.endswith(".lox"))
+    scripts.append(generated)
+
+    flags = args.flags.split()
+    results = {"binary": args.binary, "flags": flags, "runs": args.runs,
+               "benchmarks": {}}
+    for script in scripts:
+        name = os.path.splitext(os.path.basename(script))[0]
+        print("running {}...".format(name), file=sys.stderr)
+        results["benchmarks"][name] = run_benchmark(args.binary, flags,
+                                                    script, args.runs)
+
+    text = json.dumps(results, indent=2)
+    print(text)
+    if args.output:
+        with open(args.output, "w") as output:
+            output.write(text + "\n")
+
+    if args.baseline:
+        with open(args.baseline) as baseline:
+            if compare(results, json.load(baseline), args.threshold):
+                return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,56 @@
+#ifndef __ALLOCATION_SITES_H
+#define __ALLOCATION_SITES_H
+
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+
+#include "object.h"
+
+// Allocation-site profiler.
+//
+// Counts the runtime allocations (and their bytes) per source line and kind.
+// The kinds are the heap objects, which the Heap records as it allocates
+// them, and the growths of the tree-walking and closure engines' value stack,
+// which holds their locals and call arguments. The
+// engines keep the current line up to date while tracking is enabled: the
+// tree-walking and closure engines at every statement, the VM at the
+// instructions which allocate.
+class Allocation_sites {
+public:
+    // Kind of the value stack growths, following the heap object kinds.
+    static constexpr size_t STACK = OBJ_TYPE_COUNT;
+private:
+    struct Site {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+    };
+
+    // Sites keyed by their line (high bits) and kind (low bits).
+    std::unordered_map<uint64_t, Site> sites;
+    // Line being executed.
+    uint32_t line = 0;
+
+    // Print the sites with the highest count or bytes.
+    void write_top(std::ostream& out, size_t top, bool by_bytes);
+public:
+    Allocation_sites() = default;
+    Allocation_sites(const Allocation_sites&) = delete;
+    Allocation_sites(Allocation_sites&&) = delete;
+    ~Allocation_sites() = default;
+    Allocation_sites& operator=(Allocation_sites&) = delete;
+    Allocation_sites& operator=(Allocation_sites&&) = delete;
+
+    void set_line(uint32_t line) { this->line = line; }
+    // Record an allocation of the given kind at the current line.
+    void record(size_t kind, size_t bytes) {
+        Site& site = sites[static_cast<uint64_t>(line) << 8 | kind];
+        site.count++;
+        site.bytes += bytes;
+    }
+
+    // Print the top sites by count, and the top sites by bytes.
+    void write(std::ostream& out, size_t top);
+};
+
+#endif // __ALLOCATION_SITES_H
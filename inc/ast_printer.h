@@ -3,25 +3,28 @@
 
 #include "tree.h"
 
-class Ast_printer : public Expr_visitor,
-                    public std::enable_shared_from_this<Ast_printer> {
+class Ast_printer : public Expr_visitor {
     std::string result;
+    // Tokens the AST refers to.
+    const Tokens& tokens;
+    // Arena the AST lives in.
+    Ast& ast;
 public:
-    Ast_printer() = default;
+    Ast_printer(const Tokens& tokens, Ast& ast) : tokens(tokens), ast(ast) {}
     Ast_printer(const Ast_printer&) = delete;
     Ast_printer(Ast_printer&&) = delete;
     ~Ast_printer() = default;
     Ast_printer& operator=(Ast_printer&) = delete;
     Ast_printer& operator=(Ast_printer&&) = delete;
 
-    void visit_binary_expr(const std::shared_ptr<Binary_expr> expr) override;
-    void visit_unary_expr(const std::shared_ptr<Unary_expr> expr) override;
-    void visit_grouping_expr(const std::shared_ptr<Grouping_expr> expr) override;
-    void visit_literal_expr(const std::shared_ptr<Literal_expr> expr) override;
+    void visit_binary_expr(Binary_expr& expr) override;
+    void visit_unary_expr(Unary_expr& expr) override;
+    void visit_grouping_expr(Grouping_expr& expr) override;
+    void visit_literal_expr(Literal_expr& expr) override;
 
-    std::string&& print(std::shared_ptr<Expr> expr) {
-        if (expr != nullptr)
-            expr->accept(shared_from_this());
+    std::string&& print(Expr_id expr) {
+        if (expr != NO_NODE)
+            ast.accept_expr(expr, *this);
         return std::move(result);
     }
 };
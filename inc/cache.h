@@ -0,0 +1,60 @@
+#ifndef __CACHE_H
+#define __CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "token.h"
+#include "tree.h"
+
+class Heap;
+
+// Version of the cache file format. Bump it whenever the encoding of the
+// tokens or of the AST nodes changes in a way their sizes don't show (e.g.
+// reordered token types), so that older cache files are ignored.
+constexpr uint32_t CACHE_VERSION = 4;
+
+// Cache file holding the front end output of a script: its token stream and
+// its resolved (and possibly optimized) AST.
+//
+// A file is keyed by a hash of the source text, the cache version and the
+// layout of the nodes, any mismatch makes it a miss. So is a damaged file:
+// files end with a checksum, and every id read is checked against the
+// arrays it indexes. Later runs of an unchanged script skip the scanner,
+// parser, resolver and optimizer: the file is mapped while it is checked,
+// and its arrays are copied into the Tokens and the Ast, which own them.
+// The copy is not free, the loaded script takes as much memory as a parsed
+// one, plus the mapping until the load returns. The tokens keep referring
+// to the source text for their lexemes.
+class Cache_file {
+    // Path of the cache file.
+    std::string path;
+    // Source text the cached tokens are sliced from.
+    std::string_view source;
+    // Hash of the source text.
+    uint64_t source_hash;
+    // Whether the cached AST went through the Optimizer.
+    bool optimized;
+public:
+    // Files are stored next to the source (foo.lox gets foo.o.loxc, or
+    // foo.n.loxc when not optimized), or in the given directory, named after
+    // the source hash.
+    Cache_file(const std::string& source_path, std::string_view source,
+               const std::string& directory, bool optimized);
+    Cache_file(const Cache_file&) = delete;
+    Cache_file(Cache_file&&) = delete;
+    ~Cache_file() = default;
+    Cache_file& operator=(Cache_file&) = delete;
+    Cache_file& operator=(Cache_file&&) = delete;
+
+    // Load the cached tokens and AST. Returns false on a miss, in which
+    // case tokens and ast are left as they were, and no string of the file
+    // has been interned.
+    bool load(Heap& heap, Tokens& tokens, Ast& ast, Id_list& statements);
+    // Write the tokens and AST of the script. A cache which can't be written
+    // is not an error, the next run just misses again.
+    void store(const Tokens& tokens, Ast& ast, Id_list statements);
+};
+
+#endif // __CACHE_H
@@ -4,20 +4,22 @@
 #include <memory>
 #include <vector>
 
-#include "literal.h"
+#include "object.h"
 
 class Interpreter;
 
 // Represents a callable object.
-class Callable {
+class Callable : public Obj {
 public:
     // Invoke a call operator on the Callable instance (class or function).
-    virtual Literal call(std::shared_ptr<Interpreter> interpreter,
-                         std::vector<Literal>& arguments) = 0;
+    // The frame starts at the given stack slot, which holds the callee, and
+    // the arguments follow it.
+    virtual Value call(std::shared_ptr<Interpreter> interpreter,
+                       size_t frame) = 0;
     // Check the arity of the function.
     virtual uint32_t arity() = 0;
 
-    Callable() = default;
+    Callable(Obj_type type) : Obj(type) {}
     Callable(const Callable&) = delete;
     Callable(Callable&&) = delete;
     virtual ~Callable() = default;
@@ -25,4 +27,47 @@ public:
     Callable& operator=(Callable&&) = delete;
 };
 
+// Whether the value is a heap object which implements Callable.
+inline bool is_callable(Value value) {
+    if (!value.is_obj())
+        return false;
+
+    switch (value.as_obj()->get_type()) {
+    case Obj_type::NATIVE:
+    case Obj_type::FUNCTION:
+    case Obj_type::LAMBDA:
+    case Obj_type::CLASS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Function implemented in C++.
+class Native : public Callable {
+public:
+    using native_fn = Value (*)(int arg_count, Value* args);
+private:
+    native_fn function;
+    uint32_t native_arity;
+public:
+    // Invoke a call operator on the native function.
+    Value call(std::shared_ptr<Interpreter> interpreter, size_t frame) override;
+    // Check the arity of the function.
+    uint32_t arity() override { return native_arity; }
+
+    Native(native_fn function, uint32_t arity)
+        : Callable(Obj_type::NATIVE), function(function), native_arity(arity) {}
+    Native(const Native&) = delete;
+    Native(Native&&) = delete;
+    ~Native() = default;
+    Native& operator=(Native&) = delete;
+    Native& operator=(Native&&) = delete;
+
+    native_fn get_function() { return function; }
+};
+
+// Native clock() function, returns the number of seconds since the epoch.
+Value clock_native(int arg_count, Value* args);
+
 #endif // __CALLABLE_H
@@ -0,0 +1,98 @@
+#ifndef __CHUNK_H
+#define __CHUNK_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <utility>
+
+#include "token.h"
+#include "value.h"
+
+// Enum class representing all bytecode instructions.
+// Operands are listed next to the instructions which take them; "u8" and
+// "u16" are one and two byte (big-endian) unsigned operands. Operands which
+// don't fit are extended by LONG prefixes.
+enum class Op_code : uint8_t {
+    CONSTANT,       // u16 constant index
+    NIL,
+    TRUE,
+    FALSE,
+    POP,
+    GET_LOCAL,      // u8 stack slot
+    SET_LOCAL,      // u8 stack slot
+    GET_GLOBAL,     // u16 name constant
+    DEFINE_GLOBAL,  // u16 name constant
+    SET_GLOBAL,     // u16 name constant
+    GET_UPVALUE,    // u8 upvalue index
+    SET_UPVALUE,    // u8 upvalue index
+    GET_PROPERTY,   // u16 name constant
+    SET_PROPERTY,   // u16 name constant
+    GET_SUPER,      // u16 name constant
+    EQUAL,
+    GREATER,
+    GREATER_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    NOT,
+    NEGATE,
+    PRINT,
+    JUMP,           // u16 forward offset
+    JUMP_IF_FALSE,  // u16 forward offset
+    LOOP,           // u16 backward offset
+    CALL,           // u8 argument count
+    CLOSURE,        // u16 function constant, then (u8 is_local, u16 index)
+                    // for every captured variable
+    CLOSE_UPVALUE,
+    RETURN,
+    CLASS,          // u16 name constant
+    INHERIT,
+    METHOD,         // u16 name constant
+    LONG            // u8 byte prepended to the first operand of the next
+                    // instruction, which may have several LONG prefixes
+};
+
+// Largest constant index, a u16 operand extended by a LONG prefix.
+constexpr size_t MAX_CONSTANTS = 0xffffff;
+// Largest stack slot and upvalue index, a u8 operand extended by a LONG
+// prefix.
+constexpr size_t MAX_LOCALS = 0xffff;
+
+// A sequence of bytecode instructions together with the constants they use.
+class Chunk {
+    // Instruction stream.
+    std::vector<uint8_t> code;
+    // Constant pool.
+    std::vector<Value> constants;
+    // Source token of the instructions, stored as (first offset, token) runs.
+    // Only needed to report runtime errors at the right place.
+    std::vector<std::pair<uint32_t, Token_id>> tokens;
+public:
+    Chunk() = default;
+    Chunk(const Chunk&) = delete;
+    Chunk(Chunk&&) = delete;
+    ~Chunk() = default;
+    Chunk& operator=(Chunk&) = delete;
+    Chunk& operator=(Chunk&&) = delete;
+
+    // Append a byte produced by the given source token.
+    void write(uint8_t byte, Token_id token);
+    // Add a value to the constant pool and return its index.
+    size_t add_constant(Value value);
+    // Get the source token of the instruction at the given offset.
+    Token_id token_at(size_t offset) const;
+
+    std::vector<uint8_t>& get_code() { return code; }
+    std::vector<Value>& get_constants() { return constants; }
+    // Bytes of the code, the constants and the token runs.
+    size_t payload_size() const {
+        return code.capacity() + constants.capacity() * sizeof(Value)
+               + tokens.capacity() * sizeof(tokens[0]);
+    }
+};
+
+#endif // __CHUNK_H
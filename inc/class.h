@@ -4,22 +4,30 @@
 #include <string>
 #include <unordered_map>
 
-#include "function.h"
+#include "callable.h"
+#include "shape.h"
 
-// Represents a Lox class.
-class Class : public Callable,
-              public std::enable_shared_from_this<Class>{
+// Represents a Lox class. Shared by both engines: the methods are
+// Functions when the class was declared by the tree-walker, and Closures
+// when it was declared by the VM.
+class Class : public Callable {
 public:
-    using method_map = std::unordered_map<std::string, std::shared_ptr<Function>>;
+    using method_map = std::unordered_map<String*, Value, String_hash>;
 private:
     std::string name;
-    std::shared_ptr<Class> superclass;
+    // Line of the name in the class declaration, for the profiler.
+    uint32_t line;
+    Class* superclass;
     method_map methods;
+    // The init method (own or inherited), nullptr if there is none.
+    Obj* initializer = nullptr;
+    // Shape of the instances without any fields, root of the class'
+    // transition tree.
+    Shape root_shape;
 public:
-    Class(std::string name, std::shared_ptr<Class> superclass,
-          method_map methods)
-        : name(name), superclass(superclass), methods(methods) {}
-    Class() = default;
+    Class(std::string name, uint32_t line, Class* superclass, method_map methods)
+        : Callable(Obj_type::CLASS), name(name), line(line),
+          superclass(superclass), methods(methods) {}
     Class(const Class&) = delete;
     Class(Class&&) = delete;
     ~Class() = default;
@@ -27,13 +35,24 @@ public:
     Class& operator=(Class&&) = delete;
 
     // Invoke a call operator on the Callable instance (class or function).
-    Literal call(std::shared_ptr<Interpreter> interpreter,
-                 std::vector<Literal>& arguments) override;
+    Value call(std::shared_ptr<Interpreter> interpreter, size_t frame) override;
     // Check the arity of the function.
     uint32_t arity() override;
 
-    std::string get_name() { return name; }
-    std::shared_ptr<Function> find_method(std::string name);
+    const std::string& get_name() { return name; }
+    Class* get_superclass() { return superclass; }
+    void set_superclass(Class* klass) { superclass = klass; }
+    method_map& get_methods() { return methods; }
+    Obj* get_initializer() { return initializer; }
+    Shape* get_root_shape() { return &root_shape; }
+    void set_initializer(Obj* method) { initializer = method; }
+    size_t payload_size() const {
+        return name.size() + map_payload_size(methods) + root_shape.get_tree_size();
+    }
+
+    void trace(Heap& heap) override;
+    // Find a method in the class or its superclasses, nullptr if missing.
+    Obj* find_method(String* name);
 };
 
 #endif // __CLASS_H
@@ -0,0 +1,107 @@
+#ifndef __CLOSURE_COMPILER_H
+#define __CLOSURE_COMPILER_H
+
+#include <deque>
+#include <functional>
+
+#include "tree.h"
+#include "value.h"
+
+class Interpreter;
+class Heap;
+
+// Compiled expression, returns the value of the expression.
+using Expr_code = std::function<Value()>;
+// Compiled statement, returns whether a return statement was executed. The
+// returned value is then in the result register of the interpreter.
+using Stmt_code = std::function<bool()>;
+
+// Compiled body of a function, a lambda or the script.
+struct Compiled_body {
+    Stmt_code code;
+};
+
+// Visitor class which turns the resolved AST into a tree of C++ closures.
+//
+// The closures run on the runtime state of the tree-walking interpreter
+// (stack, upvalues, globals, temporary roots and inline caches), but the
+// operator, variable resolution and scope decisions are made once here,
+// instead of on every evaluation.
+class Closure_compiler : public Expr_visitor,
+                         public Stmt_visitor {
+    // Interpreter whose state the closures run on.
+    Interpreter& interpreter;
+    Heap& heap;
+    // Tokens the AST refers to.
+    const Tokens& tokens;
+    // Arena the AST lives in.
+    Ast& ast;
+
+    // Compiled function bodies. A deque, so that the Functions and Lambdas
+    // can keep pointing at their bodies while more are added.
+    std::deque<Compiled_body> bodies;
+    // Number of blocks and function bodies around the compiled node, zero
+    // for the top level, whose declarations are globals.
+    int scope_depth = 0;
+
+    // Since visit methods don't return anything, they leave the compiled
+    // node here.
+    Expr_code expr_code;
+    Stmt_code stmt_code;
+
+    // Compile a single expression.
+    Expr_code compile_expr(Expr_id expr);
+    // Compile a single statement.
+    Stmt_code compile_stmt(Stmt_id stmt);
+    // Compile a list of statements into a single closure which runs them
+    // in order, and stops at a return.
+    Stmt_code compile_statements(Id_list statements);
+    // Compile a function or lambda body.
+    const Compiled_body* compile_body(Id_list body);
+    // Compile a binary operation, apply gets both operand values.
+    template <typename Apply>
+    Expr_code compile_binary(Binary_expr& expr, Apply apply);
+    // Compile a definition of a variable in the current scope, value
+    // computes the defined value.
+    Stmt_code compile_define(Token_id name, Expr_code value);
+    // Compile a read of a resolved variable, a global is looked up by the
+    // name token.
+    Expr_code compile_variable(Resolution& resolution, Token_id name);
+public:
+    // Overridden visitor methods.
+    void visit_binary_expr(Binary_expr& expr) override;
+    void visit_unary_expr(Unary_expr& expr) override;
+    void visit_grouping_expr(Grouping_expr& expr) override;
+    void visit_literal_expr(Literal_expr& expr) override;
+    void visit_variable_expr(Variable_expr& expr) override;
+    void visit_assign_expr(Assign_expr& expr) override;
+    void visit_logical_expr(Logical_expr& expr) override;
+    void visit_call_expr(Call_expr& expr) override;
+    void visit_lambda_expr(Lambda_expr& expr) override;
+    void visit_get_expr(Get_expr& expr) override;
+    void visit_set_expr(Set_expr& expr) override;
+    void visit_this_expr(This_expr& expr) override;
+    void visit_super_expr(Super_expr& expr) override;
+
+    void visit_expression_stmt(Expression_stmt& stmt) override;
+    void visit_print_stmt(Print_stmt& stmt) override;
+    void visit_var_stmt(Var_stmt& stmt) override;
+    void visit_block_stmt(Block_stmt& stmt) override;
+    void visit_if_stmt(If_stmt& stmt) override;
+    void visit_while_stmt(While_stmt& stmt) override;
+    void visit_function_stmt(Function_stmt& stmt) override;
+    void visit_return_stmt(Return_stmt& stmt) override;
+    void visit_class_stmt(Class_stmt& stmt) override;
+
+    // Compile the top level statements of the script.
+    const Compiled_body& compile_script(Id_list statements);
+
+    Closure_compiler(Interpreter& interpreter, const Tokens& tokens, Ast& ast);
+    Closure_compiler(const Closure_compiler&) = delete;
+    Closure_compiler(Closure_compiler&&) = delete;
+    ~Closure_compiler() = default;
+    Closure_compiler& operator=(Closure_compiler&) = delete;
+    Closure_compiler& operator=(Closure_compiler&&) = delete;
+};
+
+#endif // __CLOSURE_COMPILER_H
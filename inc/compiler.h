@@ -0,0 +1,196 @@
+#ifndef __COMPILER_H
+#define __COMPILER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "tree.h"
+#include "chunk.h"
+#include "object.h"
+#include "error_handling.h"
+
+class Heap;
+
+// Visitor class which lowers the resolved AST into bytecode for the Vm.
+class Compiler : public Expr_visitor,
+                 public Stmt_visitor {
+    // Custom compiler exception class.
+    class Compile_error : public std::exception {};
+    // Thrown when a forward jump does not fit in its u16 operand.
+    class Jump_overflow : public std::exception {};
+
+    // Describes which kind of function body is being compiled.
+    enum class Function_type {
+        SCRIPT,
+        FUNCTION,
+        LAMBDA,
+        METHOD,
+        INITIALIZER
+    };
+
+    // Local variable living in a stack slot of the current function.
+    struct Local {
+        std::string_view name;
+        // Scope depth of the declaration.
+        int depth;
+        // Whether a closure captured the variable.
+        bool is_captured;
+    };
+
+    // Variable captured by the function being compiled.
+    struct Upvalue_ref {
+        // Slot (local) or upvalue index in the enclosing function.
+        uint16_t index;
+        bool is_local;
+    };
+
+    // Compilation state of a single function body.
+    struct Function_state {
+        Function_state* enclosing;
+        Prototype* function;
+        Function_type type;
+        std::vector<Local> locals;
+        std::vector<Upvalue_ref> upvalues;
+        int scope_depth = 0;
+        // Number of stack slots in use at the current instruction, and the
+        // most the body uses at any instruction.
+        uint32_t stack_depth = 0;
+        uint32_t max_stack = 0;
+        // Already emitted constants, keyed by number bits or string.
+        std::unordered_map<uint64_t, uint32_t> number_constants;
+        std::unordered_map<String*, uint32_t, String_hash> string_constants;
+    };
+
+    // Compilation state of a class declaration.
+    struct Class_state {
+        Class_state* enclosing;
+        bool has_superclass;
+    };
+
+    // Heap which owns the produced objects.
+    Heap& heap;
+
+    Function_state* current = nullptr;
+    Class_state* current_class = nullptr;
+
+    // Tokens the AST refers to.
+    const Tokens& tokens;
+    // Arena the AST lives in.
+    Ast& ast;
+    // Reporter of the compile errors.
+    error_handling::Reporter& errors;
+    // Source token of the instructions currently being emitted.
+    Token_id token = 0;
+    // Whether forward jumps are extended by LONG prefixes, set once a
+    // script turned out to need them.
+    bool long_jumps = false;
+
+    // Compile a single statement.
+    void compile_stmt(Stmt_id stmt);
+    // Compile a single expression.
+    void compile_expr(Expr_id expr);
+    // Compile a list of statements.
+    void compile(Id_list statements);
+    // Compile the program into a new top-level script function.
+    Prototype* script(Id_list statements);
+    // Compile a function body and emit the closure creating it. Lambdas
+    // have no name, the closure is attributed to the given token.
+    void function(String* name,
+                  Token_id where,
+                  Id_list params,
+                  Id_list body,
+                  Function_type type);
+
+    // Report an error at the given token and throw an exception.
+    Compile_error error(Token_id token, std::string msg);
+
+    Chunk& chunk() { return current->function->get_chunk(); }
+    void emit_byte(uint8_t byte) { chunk().write(byte, token); }
+    void emit_op(Op_code op);
+    void emit_short(uint16_t value);
+    void emit_op(Op_code op, uint8_t operand);
+    void emit_op_short(Op_code op, uint16_t operand);
+    // Emit the LONG prefixes carrying the high bits of the next operand.
+    void emit_long(uint32_t high);
+    // Emit an instruction taking a constant index, prefixed by LONG if the
+    // index does not fit in its u16 operand.
+    void emit_op_constant(Op_code op, uint32_t constant);
+    // Emit an instruction taking a stack slot or upvalue index, prefixed
+    // by LONG if the index does not fit in its u8 operand.
+    void emit_op_slot(Op_code op, uint32_t slot);
+    // Account for the values an instruction pushes (or pops).
+    void adjust_stack(int effect);
+    // Emit a forward jump and return the offset of its operand.
+    size_t emit_jump(Op_code op);
+    // Point the forward jump at the current end of the chunk.
+    void patch_jump(size_t offset);
+    // Emit a backward jump to the loop start.
+    void emit_loop(size_t loop_start);
+    // Emit the implicit return at the end of a function body.
+    void emit_return();
+
+    // Add a value to the constant pool of the current chunk. Errors are
+    // reported at the token which needs the constant.
+    uint32_t make_constant(Value value, Token_id token);
+    uint32_t number_constant(double number, Token_id token);
+    uint32_t string_constant(std::string_view chars, Token_id token);
+
+    void begin_scope() { current->scope_depth++; }
+    void end_scope();
+    // Declare a local variable named by the token in the current scope.
+    void add_local(std::string_view name, Token_id token);
+    // Find the stack slot of a local variable, or -1.
+    int resolve_local(Function_state* state, std::string_view name);
+    // Find the upvalue index of a captured variable, or -1.
+    int resolve_upvalue(Function_state* state, std::string_view name,
+                        Token_id token);
+    int add_upvalue(Function_state* state, uint16_t index, bool is_local,
+                    Token_id token);
+    // Emit a read of the named variable.
+    void get_variable(std::string_view name, Token_id token);
+    // Emit a write of the value on top of the stack to the named variable.
+    void set_variable(std::string_view name, Token_id token);
+    // Bind the value on top of the stack to a freshly declared variable.
+    void define_variable(std::string_view name, Token_id token);
+public:
+    // Overridden visitor methods.
+    void visit_binary_expr(Binary_expr& expr) override;
+    void visit_unary_expr(Unary_expr& expr) override;
+    void visit_grouping_expr(Grouping_expr& expr) override;
+    void visit_literal_expr(Literal_expr& expr) override;
+    void visit_variable_expr(Variable_expr& expr) override;
+    void visit_assign_expr(Assign_expr& expr) override;
+    void visit_logical_expr(Logical_expr& expr) override;
+    void visit_call_expr(Call_expr& expr) override;
+    void visit_lambda_expr(Lambda_expr& expr) override;
+    void visit_get_expr(Get_expr& expr) override;
+    void visit_set_expr(Set_expr& expr) override;
+    void visit_this_expr(This_expr& expr) override;
+    void visit_super_expr(Super_expr& expr) override;
+
+    void visit_expression_stmt(Expression_stmt& stmt) override;
+    void visit_print_stmt(Print_stmt& stmt) override;
+    void visit_var_stmt(Var_stmt& stmt) override;
+    void visit_block_stmt(Block_stmt& stmt) override;
+    void visit_if_stmt(If_stmt& stmt) override;
+    void visit_while_stmt(While_stmt& stmt) override;
+    void visit_function_stmt(Function_stmt& stmt) override;
+    void visit_return_stmt(Return_stmt& stmt) override;
+    void visit_class_stmt(Class_stmt& stmt) override;
+
+    // Compile the program into the top-level script function.
+    // Returns nullptr if the program exceeds the limits of the bytecode.
+    Prototype* compile_script(Id_list statements);
+
+    Compiler(Heap& heap, const Tokens& tokens, Ast& ast,
+             error_handling::Reporter& errors)
+        : heap(heap), tokens(tokens), ast(ast), errors(errors) {}
+    Compiler(const Compiler&) = delete;
+    Compiler(Compiler&&) = delete;
+    ~Compiler() = default;
+    Compiler& operator=(Compiler&) = delete;
+    Compiler& operator=(Compiler&&) = delete;
+};
+
+#endif // __COMPILER_H
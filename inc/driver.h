@@ -3,7 +3,9 @@
 
 #include <string>
 
-// Run the interpreter.
-void run(std::string source);
+#include "isolate.h"
+
+// Run the interpreter on a script file, returns false on errors.
+bool run(std::string source, const Options& options = Options());
 
 #endif // __DRIVER_H
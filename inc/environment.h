@@ -3,43 +3,76 @@
 
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include <memory>
 
 #include "token.h"
 #include "runtime_error.h"
-#include "literal.h"
+#include "value.h"
+#include "object.h"
 
 // Class describing a runtime environment.
-class Environment : public std::enable_shared_from_this<Environment> {
+//
+// Values are stored in slots, in the order in which the variables are
+// defined. The tree-walking engines only use it for the globals, which are
+// looked up by name until their slot is known; local variables live on the
+// interpreter's stack, or in upvalues once captured.
+class Environment : public Obj {
     // Enclosing (parent) environment.
-    std::shared_ptr<Environment> enclosing;
-    // Map of defined values.
-    std::unordered_map<std::string, Literal> values;
+    Environment* enclosing;
+    // Defined values, indexed by slot.
+    std::vector<Value> values;
+    // Slots of the global variables. Only used by the outermost environment.
+    std::unordered_map<String*, uint32_t, String_hash> global_slots;
 public:
-    Environment() : enclosing(nullptr), values() {}
-    Environment(std::shared_ptr<Environment> enclosing) : enclosing(enclosing) {}
+    Environment() : Obj(Obj_type::ENVIRONMENT), enclosing(nullptr), values() {}
+    Environment(Environment* enclosing, size_t size = 0)
+        : Obj(Obj_type::ENVIRONMENT), enclosing(enclosing) {
+        values.reserve(size);
+    }
     Environment(const Environment&) = delete;
     Environment(Environment&&) = delete;
     ~Environment() = default;
     Environment& operator=(Environment&) = delete;
     Environment& operator=(Environment&&) = delete;
 
-    // Define a new variable.
-    void define(std::string name, Literal value) { values[name] = value; }
-    // Assign to an existing variable.
-    void assign(std::shared_ptr<Token> name, Literal value);
-    // Get the value of an existing variable.
-    Literal get(std::shared_ptr<Token> name);
+    // Define a new local variable in the next free slot, returns the slot.
+    uint32_t define(Value value) {
+        values.push_back(value);
+        return values.size() - 1;
+    }
+    // Define (or redefine) a global variable, returns its slot.
+    uint32_t define_global(String* name, Value value);
+    // Assign to an existing global variable.
+    void assign_global(String* name, Token_id token, Value value);
+    // Get the value of an existing global variable.
+    Value get_global(String* name, Token_id token);
+    // Find the slot of a global variable, -1 if it isn't defined.
+    int64_t find_global(String* name);
     // Get the value of an existing variable, at the desired depth in the
     // environment stack.
-    Literal get_at(int distance, std::string name);
+    Value get_at(int distance, uint32_t slot) {
+        return ancestor(distance)->values[slot];
+    }
     // Get the environment at the desired depth.
-    std::shared_ptr<Environment> ancestor(int distance);
+    Environment* ancestor(int distance) {
+        Environment* environment = this;
+        for (int i = 0; i < distance; i++)
+            environment = environment->enclosing;
+        return environment;
+    }
     // Set the value of an existing variable, at the desired depth in the
     // environment stack.
-    void assign_at(int distance, std::shared_ptr<Token> name, Literal value);
+    void assign_at(int distance, uint32_t slot, Value value) {
+        ancestor(distance)->values[slot] = value;
+    }
 
-    std::shared_ptr<Environment> get_enclosing() { return enclosing; }
+    Environment* get_enclosing() { return enclosing; }
+    size_t payload_size() const {
+        return values.capacity() * sizeof(Value) + map_payload_size(global_slots);
+    }
+
+    void trace(Heap& heap) override;
 };
 
 #endif // __ENVIRONMENT_H
@@ -2,19 +2,35 @@
 #define __ERROR_HANDLING_H
 
 #include <string>
-#include <memory>
+#include <ostream>
 
 #include "token.h"
 
 namespace error_handling {
 
-// Whether we've seen an error.
-extern bool had_error;
+// Error state of a single interpreter instance. Every stage of an instance
+// reports through the same Reporter, so instances don't see each other's
+// errors.
+class Reporter {
+    // Stream the errors are written to.
+    std::ostream& out;
+    // Whether we've seen an error.
+    bool had_error = false;
+public:
+    Reporter(std::ostream& out) : out(out) {}
+    Reporter(const Reporter&) = delete;
+    Reporter(Reporter&&) = delete;
+    ~Reporter() = default;
+    Reporter& operator=(Reporter&) = delete;
+    Reporter& operator=(Reporter&&) = delete;
 
-// Error reporting functions.
-void error(uint32_t line, std::string msg);
-void error(std::shared_ptr<Token> tok, std::string msg);
-void report(uint32_t line, std::string where, std::string msg);
+    // Error reporting functions.
+    void error(uint32_t line, std::string msg);
+    void error(const Tokens& tokens, Token_id tok, std::string msg);
+    void report(uint32_t line, std::string where, std::string msg);
+
+    bool has_error() { return had_error; }
+};
 
 }
 
@@ -4,35 +4,58 @@
 #include <vector>
 
 #include "callable.h"
+#include "tree.h"
 
-class Function_stmt;
-class Environment;
+struct Compiled_body;
+class Instance;
+class Heap;
 
 // Represents a Lox function.
 class Function : public Callable {
-    std::shared_ptr<Function_stmt> declaration = nullptr;
-    std::shared_ptr<Environment> closure;
+    // The node is copied, so the function doesn't point into the arena.
+    Function_stmt declaration;
+    String* name;
+    // Variables of the enclosing functions which the function uses.
+    std::vector<Upvalue*> upvalues;
+    // Body compiled by the Closure_compiler, nullptr when the tree-walker
+    // runs the declaration.
+    const Compiled_body* code = nullptr;
     bool is_initializer;
+    // Instance a method is bound to, nullptr for functions and unbound
+    // methods.
+    Instance* receiver;
 public:
     // Invoke a call operator on the Callable instance (class or function).
-    Literal call(std::shared_ptr<Interpreter> interpreter,
-                 std::vector<Literal>& arguments) override;
+    Value call(std::shared_ptr<Interpreter> interpreter, size_t frame) override;
+    // Call the method on an instance, without binding it first. The
+    // instance takes slot 0 of the frame.
+    Value invoke(std::shared_ptr<Interpreter> interpreter, Instance* instance,
+                 size_t frame);
     // Check the arity of the function.
     uint32_t arity() override;
     // Bind a class instance to the class method invocation.
-    std::shared_ptr<Function> bind(std::shared_ptr<Instance> instance);
+    Function* bind(Heap& heap, Instance* instance);
+    // Get the name of the function.
+    const std::string& get_name();
+    // Run the body compiled by the Closure_compiler on calls.
+    void set_code(const Compiled_body* code) { this->code = code; }
+    size_t payload_size() const { return upvalues.capacity() * sizeof(Upvalue*); }
 
-    Function(std::shared_ptr<Function_stmt> declaration,
-             std::shared_ptr<Environment> closure,
-             bool is_initializer)
-        : declaration(declaration), closure(closure),
-          is_initializer(is_initializer) {}
-    Function() = default;
+    Function(const Function_stmt& declaration,
+             String* name,
+             std::vector<Upvalue*> upvalues,
+             bool is_initializer,
+             Instance* receiver = nullptr)
+        : Callable(Obj_type::FUNCTION), declaration(declaration), name(name),
+          upvalues(std::move(upvalues)), is_initializer(is_initializer),
+          receiver(receiver) {}
     Function(const Function&) = delete;
     Function(Function&&) = delete;
     ~Function() = default;
     Function& operator=(Function&) = delete;
     Function& operator=(Function&&) = delete;
+
+    void trace(Heap& heap) override;
 };
 
 #endif // __LOX_FUNCTION_H
@@ -0,0 +1,173 @@
+#ifndef __HEAP_H
+#define __HEAP_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <ostream>
+
+#include "object.h"
+#include "allocation_sites.h"
+
+// Source of garbage collection roots, e.g. an execution engine.
+class Root_set {
+public:
+    virtual ~Root_set() = default;
+
+    // Mark every object the root set references directly.
+    virtual void mark_roots(Heap& heap) = 0;
+};
+
+// Tunables of the garbage collector.
+struct Gc_config {
+    // Number of allocated bytes which triggers the first collection.
+    size_t initial_threshold = 1024 * 1024;
+    // After a collection, the next one is triggered once the heap grows to
+    // the number of live bytes multiplied by this factor.
+    double growth_factor = 2.0;
+};
+
+// Statistics gathered by the garbage collector.
+struct Gc_stats {
+    uint64_t collections = 0;
+    uint64_t objects_allocated = 0;
+    // Objects allocated, indexed by their Obj_type.
+    std::array<uint64_t, OBJ_TYPE_COUNT> objects_by_type{};
+    uint64_t bytes_allocated = 0;
+    uint64_t objects_freed = 0;
+    uint64_t bytes_freed = 0;
+    // Largest number of live bytes the heap reached.
+    uint64_t peak_bytes = 0;
+    // Total time spent in collections.
+    double pause_seconds = 0.;
+    // Longest single collection.
+    double max_pause_seconds = 0.;
+
+    // Overloaded ostream operator for printing out the statistics.
+    friend std::ostream& operator<<(std::ostream& os, const Gc_stats& stats);
+};
+
+// Owner of all the heap objects referenced by Values.
+//
+// Objects are reclaimed by a tracing mark-sweep collector. Allocating never
+// collects; the engines call maybe_collect() at safe points where all the
+// objects they still use are reachable from their root sets.
+class Heap {
+    // Hasher for the intern table, produces the same hash as String.
+    struct Chars_hash {
+        size_t operator()(std::string_view chars) const { return hash_string(chars); }
+    };
+
+    // List of all allocated objects.
+    Obj* objects = nullptr;
+    // Table of interned strings, keyed by their contents. The table doesn't
+    // keep the strings alive.
+    std::unordered_map<std::string_view, String*, Chars_hash> strings;
+
+    // Names the engines look up on their own.
+    String* init_string;
+    String* this_string;
+    String* super_string;
+
+    Gc_config config;
+    Gc_stats stats;
+    // Allocation-site profiler, nullptr unless tracking allocations.
+    Allocation_sites* allocation_sites = nullptr;
+    // Bytes currently allocated.
+    size_t bytes_allocated = 0;
+    // Number of allocated bytes which triggers the next collection.
+    size_t next_gc;
+
+    std::vector<Root_set*> root_sets;
+    // Marked objects whose references have not been traced yet.
+    std::vector<Obj*> gray_stack;
+
+    // Mark phase.
+    void mark_roots();
+    void trace_references();
+    // Sweep phase.
+    void remove_white_strings();
+    void sweep();
+
+    // Count bytes the object gained (or lost) in the number of live bytes.
+    void account(Obj* obj, size_t size) {
+        if (size >= obj->get_size()) {
+            bytes_allocated += size - obj->get_size();
+            stats.bytes_allocated += size - obj->get_size();
+        } else {
+            bytes_allocated -= obj->get_size() - size;
+            stats.bytes_freed += obj->get_size() - size;
+        }
+        obj->set_size(size);
+        if (bytes_allocated > stats.peak_bytes)
+            stats.peak_bytes = bytes_allocated;
+    }
+public:
+    Heap(Gc_config config = Gc_config());
+    Heap(const Heap&) = delete;
+    Heap(Heap&&) = delete;
+    ~Heap();
+    Heap& operator=(Heap&) = delete;
+    Heap& operator=(Heap&&) = delete;
+
+    // Allocate a new heap object. The object is charged for its payload
+    // too, as far as it exists after construction.
+    template <typename T, typename... Args>
+    T* allocate(Args&&... args) {
+        T* obj = new T(std::forward<Args>(args)...);
+        obj->set_next(objects);
+        objects = obj;
+
+        size_t size = sizeof(T) + obj->payload_size();
+        stats.objects_allocated++;
+        stats.objects_by_type[static_cast<size_t>(obj->get_type())]++;
+        if (allocation_sites != nullptr)
+            allocation_sites->record(static_cast<size_t>(obj->get_type()), size);
+        account(obj, size);
+        return obj;
+    }
+    // Count the payload of an object again, after it grew or shrank.
+    template <typename T>
+    void resize(T* obj) { account(obj, sizeof(T) + obj->payload_size()); }
+
+    // Get the unique String with the given contents, creating it if needed.
+    String* intern(std::string_view chars);
+    // Keep the object alive until the heap is destroyed. Only objects which
+    // don't reference other objects (strings) may be pinned.
+    void pin(Obj* obj) { obj->set_pinned(); }
+
+    // Register and unregister a source of roots.
+    void add_roots(Root_set* roots) { root_sets.push_back(roots); }
+    void remove_roots(Root_set* roots);
+
+    // Mark an object (or the object stored in a value) as reachable.
+    void mark_object(Obj* obj);
+    void mark_value(Value value) {
+        if (value.is_obj())
+            mark_object(value.as_obj());
+    }
+
+    // Run a collection if the heap has grown past the threshold.
+    void maybe_collect() {
+        if (bytes_allocated > next_gc)
+            collect();
+    }
+    // Free all the objects which are not reachable from the roots.
+    void collect();
+
+    const Gc_stats& get_stats() { return stats; }
+    // Track the allocations with the given profiler, or not at all if
+    // nullptr.
+    void set_allocation_sites(Allocation_sites* sites) { allocation_sites = sites; }
+    Allocation_sites* get_allocation_sites() { return allocation_sites; }
+    size_t get_bytes_allocated() { return bytes_allocated; }
+
+    String* get_init_string() { return init_string; }
+    String* get_this_string() { return this_string; }
+    String* get_super_string() { return super_string; }
+};
+
+#endif // __HEAP_H
@@ -0,0 +1,99 @@
+#ifndef __INLINE_CACHE_H
+#define __INLINE_CACHE_H
+
+#include <cstdint>
+#include <ostream>
+
+class Obj;
+class Shape;
+
+// Per-site cache of property lookups, keyed by the shape of the instance.
+//
+// Shapes are never shared between classes, so a shape also identifies the
+// class, and the result of a lookup stays valid for as long as an instance
+// has the same shape. A site starts empty, becomes monomorphic after its
+// first lookup and polymorphic after a few more; once all the entries are
+// taken the site is megamorphic and further misses are not cached.
+class Inline_cache {
+public:
+    static constexpr uint32_t ENTRIES = 4;
+
+    // What a cached lookup found.
+    enum class Kind : uint8_t {
+        // A field, in the given slot.
+        FIELD,
+        // A method of the class (or one of its superclasses).
+        METHOD,
+        // No field, setting one moves the instance to the given shape.
+        TRANSITION
+    };
+
+    struct Entry {
+        uint64_t shape_id;
+        Kind kind;
+        uint32_t slot;
+        union {
+            Obj* method;
+            Shape* shape;
+        };
+    };
+private:
+    Entry entries[ENTRIES];
+    uint32_t count = 0;
+public:
+    Inline_cache() = default;
+    Inline_cache(const Inline_cache&) = default;
+    Inline_cache(Inline_cache&&) = default;
+    ~Inline_cache() = default;
+    Inline_cache& operator=(const Inline_cache&) = default;
+    Inline_cache& operator=(Inline_cache&&) = default;
+
+    // Find the entry for a shape, nullptr on a miss.
+    const Entry* lookup(uint64_t shape_id) const {
+        for (uint32_t entry = 0; entry < count; entry++) {
+            if (entries[entry].shape_id == shape_id)
+                return &entries[entry];
+        }
+        return nullptr;
+    }
+
+    void add_field(uint64_t shape_id, uint32_t slot) {
+        if (Entry* entry = next_entry(shape_id, Kind::FIELD))
+            entry->slot = slot;
+    }
+    void add_method(uint64_t shape_id, Obj* method) {
+        if (Entry* entry = next_entry(shape_id, Kind::METHOD))
+            entry->method = method;
+    }
+    void add_transition(uint64_t shape_id, Shape* shape) {
+        if (Entry* entry = next_entry(shape_id, Kind::TRANSITION))
+            entry->shape = shape;
+    }
+
+    bool is_empty() const { return count == 0; }
+    bool is_megamorphic() const { return count == ENTRIES; }
+private:
+    // Take the next free entry, nullptr if the site is megamorphic.
+    Entry* next_entry(uint64_t shape_id, Kind kind) {
+        if (count == ENTRIES)
+            return nullptr;
+
+        Entry* entry = &entries[count++];
+        entry->shape_id = shape_id;
+        entry->kind = kind;
+        return entry;
+    }
+};
+
+// Hit and miss counters of all the inline caches of an interpreter.
+struct Ic_stats {
+    uint64_t get_hits = 0;
+    uint64_t get_misses = 0;
+    uint64_t set_hits = 0;
+    uint64_t set_misses = 0;
+
+    // Overloaded ostream operator for printing out the statistics.
+    friend std::ostream& operator<<(std::ostream& os, const Ic_stats& stats);
+};
+
+#endif // __INLINE_CACHE_H
@@ -2,31 +2,67 @@
 #define __INSTANCE_H
 
 #include <memory>
-#include <unordered_map>
+#include <vector>
 
-#include "literal.h"
+#include "object.h"
+#include "shape.h"
 
 class Class;
-class Token;
+class Heap;
 
 // Describes a class instance.
-class Instance : public std::enable_shared_from_this<Instance> {
-    using fields_map = std::unordered_map<std::string, Literal>;
+//
+// The names of the fields are kept by the instance's Shape, the instance
+// itself only stores the values, indexed by slot. The first few values are
+// stored inline in the instance.
+class Instance : public Obj {
+    static constexpr uint32_t INLINE_FIELDS = 4;
 
-    std::shared_ptr<Class> klass;
-    fields_map fields;
+    Class* klass;
+    Shape* shape;
+    Value inline_fields[INLINE_FIELDS];
+    // Values of the fields past the inline ones.
+    std::vector<Value> overflow_fields;
 public:
-    Instance(std::shared_ptr<Class> klass) : klass(klass) {}
-    Instance();
+    Instance(Class* klass);
     Instance(const Instance&) = delete;
     Instance(Instance&&) = delete;
     ~Instance() = default;
     Instance& operator=(Instance&) = delete;
     Instance& operator=(Instance&&) = delete;
 
-    std::shared_ptr<Class> get_klass() { return klass; }
-    Literal get(std::shared_ptr<Token> name);
-    void set(std::shared_ptr<Token> name, Literal value);
+    Class* get_klass() { return klass; }
+    Shape* get_shape() { return shape; }
+
+    // Access a field by its slot in the shape.
+    Value& slot(uint32_t slot) {
+        if (slot < INLINE_FIELDS)
+            return inline_fields[slot];
+        return overflow_fields[slot - INLINE_FIELDS];
+    }
+
+    // Get the value of a field, returns false if there is no such field.
+    bool get_field(String* name, Value& value) {
+        int64_t field = shape->find(name);
+        if (field < 0)
+            return false;
+
+        value = slot(field);
+        return true;
+    }
+    // Set the value of a field, adding it if needed.
+    void set_field(String* name, Value value);
+    // Add a field by moving to a child of the current shape.
+    void add_field(Shape* child, Value value) {
+        shape = child;
+        if (shape->get_field_count() > INLINE_FIELDS)
+            overflow_fields.push_back(value);
+        else
+            inline_fields[shape->get_field_count() - 1] = value;
+    }
+    size_t payload_size() const { return overflow_fields.capacity() * sizeof(Value); }
+
+    void trace(Heap& heap) override;
 };
 
 #endif // __INSTANCE_H
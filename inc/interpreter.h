@@ -1,94 +1,207 @@
 #ifndef __INTERPRETER_H
 #define __INTERPRETER_H
 
-#include <list>
+#include <cstdint>
+#include <ostream>
 #include <vector>
 #include <unordered_map>
 
 #include "tree.h"
-#include "literal.h"
+#include "value.h"
 #include "environment.h"
+#include "heap.h"
+#include "inline_cache.h"
+#include "closure_compiler.h"
+#include "error_handling.h"
+#include "profiler.h"
+
+class Callable;
+class Instance;
+class Class;
+class Function;
 
 // Interpreter visitor class.
 class Interpreter : public Expr_visitor,
                     public Stmt_visitor,
+                    public Root_set,
                     public std::enable_shared_from_this<Interpreter> {
-    using side_table = std::unordered_map<std::shared_ptr<Expr>, int>;
+
 
     friend class Function;
     friend class Lambda;
+    friend class Native;
+    friend class Closure_compiler;
 
     // Result of the interpreter run. Also holds the intermediate results
     // during the interpreter run.
-    Literal result;
+    Value result;
+    // Set by a return statement, until the function body is left. The
+    // returned value is in result.
+    bool returning = false;
+
+    // Owner of the runtime objects.
+    Heap& heap;
+    // Tokens the AST refers to.
+    const Tokens& tokens;
+    // Arena the AST lives in.
+    Ast& ast;
+    // Reporter of the runtime errors.
+    error_handling::Reporter& errors;
+    // Stream the print statements write to.
+    std::ostream& out;
 
-    std::shared_ptr<Environment> globals = std::make_shared<Environment>();
-    std::shared_ptr<Environment> environment = globals;
+    Environment* globals;
 
-    // Resolved scopes of expressions.
-    side_table locals;
+    // Local variables of the running calls, a frame per call. Variables
+    // are pushed as they are defined and popped when their scope is left.
+    std::vector<Value> stack;
+    // Start of the running call's frame in the stack.
+    size_t frame = 0;
+    // Number of running calls, counting the top-level script like the VM
+    // does.
+    uint32_t call_depth = 1;
+    // Lowest address of the C++ stack a call may start at, 0 if unknown.
+    // Calls recurse on the C++ stack, so below it they fail with a stack
+    // overflow even before reaching FRAMES_MAX.
+    uintptr_t stack_limit = 0;
+    // Upvalues of the running closure, nullptr at the top level.
+    const std::vector<Upvalue*>* upvalues = nullptr;
+    // Upvalues which still point into the stack, ordered by descending
+    // slot.
+    Upvalue* open_upvalues = nullptr;
+    // Number of blocks and function bodies around the running statement,
+    // zero for the top level, whose declarations are globals.
+    uint32_t scope_depth = 0;
+
+    // Values which are only referenced from the C++ stack (partially
+    // evaluated operands, callees and arguments) and must survive a
+    // collection.
+    std::vector<Value> temp_roots;
+
+    // Counters of the property inline caches.
+    Ic_stats ic_stats;
+    // Sampling profiler, nullptr unless profiling.
+    Profiler* profiler = nullptr;
 
     // Evaluate an expression. Just a wrapper around the call to accept method.
-    void evaluate(std::shared_ptr<Expr> expr);
+    void evaluate(Expr_id expr);
     // Execute a statement. Just a wrapper around the call to accept method.
-    void execute(std::shared_ptr<Stmt> stmt);
-    void execute_block(std::list<std::shared_ptr<Stmt>>& statements,
-                       std::shared_ptr<Environment> environment);
-    // Is the literal considered to be TRUE.
-    bool is_truthy();
-    // Add two literals.
-    void add(auto& left);
-    // Are two literals equal.
-    bool is_equal(Literal& left);
+    void execute(Stmt_id stmt);
+    // Call the callee, or invoke the method on the receiver if given. The
+    // frame of the call is on the stack: its slot 0 holds the callee (the
+    // receiver once the method runs) and the arguments follow it. The frame
+    // is popped.
+    Value call(Callable* callee, Instance* receiver, size_t frame,
+               Token_id paren);
+    // Execute the body of a function in the frame, returns the returned
+    // value. The frame is popped.
+    Value execute_body(Id_list statements, size_t frame,
+                       const std::vector<Upvalue*>& upvalues);
+    // Run a function body compiled by the Closure_compiler in the frame,
+    // returns the returned value. The frame is popped.
+    Value execute_body(const Compiled_body& body, size_t frame,
+                       const std::vector<Upvalue*>& upvalues);
+    // Pop the frame of the running call or the variables of a scope,
+    // everything from first on. Only the captured ones have to be closed.
+    void pop_locals(size_t first, bool captured);
+    // Push a local variable, moving the stack if it is full.
+    void push_local(Value value);
+    // Get a local variable, in the frame or through an upvalue.
+    Value& local(Resolution& resolution) {
+        if (resolution.is_upvalue())
+            return *(*upvalues)[resolution.get_slot()]->get_location();
+        return stack[frame + resolution.get_slot()];
+    }
+    // Capture the variables a closure lists, from the running frame and
+    // closure.
+    std::vector<Upvalue*> capture(Id_list captures);
+    // Find or create the upvalue of the stack slot.
+    Upvalue* capture_upvalue(size_t slot);
+    // Close the open upvalues of the slots from first on.
+    void close_upvalues(size_t first);
+    // Is the result considered to be TRUE.
+    bool is_truthy() { return result.is_truthy(); }
+    // Add two values.
+    void add(Value left);
+    // Are two values equal.
+    bool is_equal(Value left) { return left == result; }
     // Get the Callable class (and its children) instance.
-    std::shared_ptr<Callable> get_callable(Literal &callee, std::shared_ptr<Token> parent);
+    Callable* get_callable(Value callee, Token_id parent);
     // Get the Instance class instance.
-    std::shared_ptr<Instance> get_instance(Literal& callee, std::shared_ptr<Token> parent);
+    Instance* get_instance(Value callee, Token_id parent);
+    // Look up a property through the inline cache of the access site. A
+    // field is stored in the result, a method is returned unbound.
+    Function* look_up_property(Instance* instance, Get_expr& expr);
+    // Store a property through the inline cache of the access site.
+    void set_property(Instance* instance, Set_expr& expr, Value value);
     // Get the superclass of a class.
-    std::shared_ptr<Class> get_superclass(Literal& callee, std::shared_ptr<Token> parent);
-    // Look up a variable using the resolved depth.
-    Literal look_up_variable(std::shared_ptr<Token> name, std::shared_ptr<Expr> expr);
+    Class* get_superclass(Value callee, Token_id parent);
+    // Define a variable in the current scope, returns its slot.
+    uint32_t define(Token_id name, Value value);
+    // Set a variable defined in the current scope, once its value is ready.
+    void initialize(uint32_t slot, Value value);
+    // Drop the state of the calls a runtime error unwound.
+    void reset();
+    // Look up a variable where the resolver found it.
+    Value look_up_variable(Token_id name, Resolution& resolution);
 public:
-    Interpreter();
+    Interpreter(Heap& heap, const Tokens& tokens, Ast& ast,
+                error_handling::Reporter& errors, std::ostream& out);
     Interpreter(const Interpreter&) = delete;
     Interpreter(Interpreter&&) = delete;
-    ~Interpreter() = default;
+    ~Interpreter();
     Interpreter& operator=(Interpreter&) = delete;
     Interpreter& operator=(Interpreter&&) = delete;
 
     // Implementation of expression visitor interface.
-    void visit_literal_expr(const std::shared_ptr<Literal_expr> expr) override;
-    void visit_grouping_expr(const std::shared_ptr<Grouping_expr> expr) override;
-    void visit_unary_expr(const std::shared_ptr<Unary_expr> expr) override;
-    void visit_binary_expr(const std::shared_ptr<Binary_expr> expr) override;
-    void visit_variable_expr(const std::shared_ptr<Variable_expr> expr) override;
-    void visit_assign_expr(const std::shared_ptr<Assign_expr> expr) override;
-    void visit_logical_expr(const std::shared_ptr<Logical_expr> expr) override;
-    void visit_call_expr(const std::shared_ptr<Call_expr> expr) override;
-    void visit_lambda_expr(const std::shared_ptr<Lambda_expr> expr) override;
-    void visit_get_expr(const std::shared_ptr<Get_expr> expr) override;
-    void visit_set_expr(const std::shared_ptr<Set_expr> expr) override;
-    void visit_this_expr(const std::shared_ptr<This_expr> expr) override;
-    void visit_super_expr(const std::shared_ptr<Super_expr> expr) override;
+    void visit_literal_expr(Literal_expr& expr) override;
+    void visit_grouping_expr(Grouping_expr& expr) override;
+    void visit_unary_expr(Unary_expr& expr) override;
+    void visit_binary_expr(Binary_expr& expr) override;
+    void visit_variable_expr(Variable_expr& expr) override;
+    void visit_assign_expr(Assign_expr& expr) override;
+    void visit_logical_expr(Logical_expr& expr) override;
+    void visit_call_expr(Call_expr& expr) override;
+    void visit_lambda_expr(Lambda_expr& expr) override;
+    void visit_get_expr(Get_expr& expr) override;
+    void visit_set_expr(Set_expr& expr) override;
+    void visit_this_expr(This_expr& expr) override;
+    void visit_super_expr(Super_expr& expr) override;
 
     // Implementation of statement visitor interface.
-    void visit_expression_stmt(const std::shared_ptr<Expression_stmt> stmt) override;
-    void visit_print_stmt(const std::shared_ptr<Print_stmt> stmt) override;
-    void visit_var_stmt(const std::shared_ptr<Var_stmt> stmt) override;
-    void visit_block_stmt(const std::shared_ptr<Block_stmt> stmt) override;
-    void visit_if_stmt(const std::shared_ptr<If_stmt> stmt) override;
-    void visit_while_stmt(const std::shared_ptr<While_stmt> stmt) override;
-    void visit_function_stmt(const std::shared_ptr<Function_stmt> stmt) override;
-    void visit_return_stmt(const std::shared_ptr<Return_stmt> stmt) override;
-    void visit_class_stmt(const std::shared_ptr<Class_stmt> stmt) override;
-
-    // Resolve an expression.
-    void resolve(std::shared_ptr<Expr> expr, int depth) { locals[expr] = depth; }
+    void visit_expression_stmt(Expression_stmt& stmt) override;
+    void visit_print_stmt(Print_stmt& stmt) override;
+    void visit_var_stmt(Var_stmt& stmt) override;
+    void visit_block_stmt(Block_stmt& stmt) override;
+    void visit_if_stmt(If_stmt& stmt) override;
+    void visit_while_stmt(While_stmt& stmt) override;
+    void visit_function_stmt(Function_stmt& stmt) override;
+    void visit_return_stmt(Return_stmt& stmt) override;
+    void visit_class_stmt(Class_stmt& stmt) override;
 
     // Start the interpreter run.
-    void interpret(std::list<std::shared_ptr<Stmt>>& statements);
+    void interpret(Id_list statements);
+    // Start the run of a script compiled by the Closure_compiler.
+    void interpret(const Compiled_body& script);
     // Get the result of the interpreter run.
-    Literal get_result() { return result; }
+    Value get_result() { return result; }
+    // Get the owner of the runtime objects.
+    Heap& get_heap() { return heap; }
+    // Get the hit and miss counters of the inline caches.
+    const Ic_stats& get_ic_stats() { return ic_stats; }
+    // Profile the run with the given profiler, or not at all if nullptr.
+    // Must be set before the Closure_compiler runs.
+    void set_profiler(Profiler* profiler) { this->profiler = profiler; }
+    Profiler* get_profiler() { return profiler; }
+    // Limit the calls to the C++ stack above the given address.
+    void set_stack_limit(uintptr_t limit) { stack_limit = limit; }
+
+    // Keep a value alive until it is popped.
+    void push_root(Value value) { temp_roots.push_back(value); }
+    void pop_roots(size_t count) { temp_roots.resize(temp_roots.size() - count); }
+    // Mark the globals, the stack, the upvalues, the result register and
+    // the temporary roots.
+    void mark_roots(Heap& heap) override;
 };
 
 #endif // __INTERPRETER_H
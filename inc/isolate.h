@@ -0,0 +1,132 @@
+#ifndef __ISOLATE_H
+#define __ISOLATE_H
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "heap.h"
+#include "token.h"
+#include "tree.h"
+#include "error_handling.h"
+
+class Source_file;
+class Run_stats;
+class Profiler;
+
+// Enum class representing the available execution engines.
+enum class Engine : uint8_t {
+    // Tree-walking interpreter, the reference engine.
+    TREE_WALKER,
+    // Bytecode compiler and stack VM.
+    VM,
+    // Tree of C++ closures compiled from the AST.
+    CLOSURE
+};
+
+// Enum class representing the formats of the phase statistics.
+enum class Stats_format : uint8_t {
+    // Not collected.
+    NONE,
+    // Human-readable table.
+    TEXT,
+    JSON
+};
+
+// Options of a single interpreter run.
+struct Options {
+    Engine engine = Engine::TREE_WALKER;
+    Gc_config gc;
+    // Print the garbage collector statistics after the run.
+    bool gc_stats = false;
+    // Print the inline cache hit and miss counters after the run.
+    bool ic_stats = false;
+    // Fold constants and prune dead branches before running the script.
+    bool optimize = true;
+    // Print the optimizer counters after the optimization.
+    bool fold_stats = false;
+    // Reuse the tokens and AST cached by an earlier run of the same script,
+    // or cache them for the next one.
+    bool cache = false;
+    // Directory of the cache files, empty to keep them next to the scripts.
+    std::string cache_dir;
+    // File the sampled call stacks are written to, empty to not profile.
+    std::string profile;
+    // Interval between two profiler samples, in microseconds.
+    uint32_t profile_interval = 1000;
+    // Number of allocation sites to print after the run, 0 to not track
+    // the allocations.
+    uint32_t allocation_sites = 0;
+    // Print the time, sizes and allocations of every phase after the run.
+    Stats_format stats_format = Stats_format::NONE;
+
+    // Stream the print statements write to.
+    std::ostream* out = &std::cout;
+    // Stream the compile and runtime errors are reported to.
+    std::ostream* errors = &std::cout;
+    // Stream the statistics are printed to.
+    std::ostream* stats = &std::cerr;
+};
+
+// Self-contained interpreter instance, the embedding interface of cpplox.
+//
+// Every piece of mutable state of a run (the heap, the globals, the error
+// state and the output streams) belongs to an isolate, so separate isolates
+// can run scripts on separate threads at the same time. A single isolate
+// must not be used by two threads at once.
+//
+// An isolate runs one script: create it, load the script, run it and
+// destroy it. Errors are reported to the error stream of the options, and
+// are never fatal to the process.
+class Isolate {
+    Options options;
+    error_handling::Reporter errors;
+    // Owns every runtime object created by either engine.
+    Heap heap;
+
+    // Source text of the script. The tokens, and so the AST, refer to it,
+    // so it has to outlive the run. Files are mapped, other sources copied.
+    std::unique_ptr<Source_file> file;
+    std::string text;
+
+    Tokens tokens;
+    Ast ast;
+    // Top level statements of the loaded script.
+    Id_list statements;
+    // Statistics of the phases, nullptr unless requested.
+    std::unique_ptr<Run_stats> run_stats;
+
+    bool loaded = false;
+    bool ran = false;
+
+    // Turn the source text into a resolved AST, or take it from the cache of
+    // the file at path (if not empty). Returns false on errors.
+    bool compile(std::string_view source, const std::string& path);
+    // Print the phase statistics, if requested.
+    void write_run_stats();
+    // Compile the script for the selected engine and run it, calls may use
+    // the C++ stack down to stack_limit. Returns false if it failed to
+    // compile.
+    bool execute(Profiler* profiler, uintptr_t stack_limit);
+public:
+    Isolate(const Options& options = Options());
+    Isolate(const Isolate&) = delete;
+    Isolate(Isolate&&) = delete;
+    ~Isolate();
+    Isolate& operator=(Isolate&) = delete;
+    Isolate& operator=(Isolate&&) = delete;
+
+    // Load the script in a file, returns false on errors.
+    bool load_file(const std::string& path);
+    // Load the script in a string, returns false on errors.
+    bool load_source(std::string source);
+    // Run the loaded script, returns false on errors.
+    bool run();
+
+    // Whether any error was reported, while loading or running.
+    bool had_error() { return errors.has_error(); }
+};
+
+#endif // __ISOLATE_H
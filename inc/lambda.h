@@ -4,30 +4,40 @@
 #include <vector>
 
 #include "callable.h"
+#include "tree.h"
 
-class Lambda_expr;
-class Environment;
+struct Compiled_body;
+class Heap;
 
 // Represents an anonymous function.
 class Lambda : public Callable {
-    std::shared_ptr<Lambda_expr> declaration = nullptr;
-    std::shared_ptr<Environment> closure;
+    // The node is copied, so the lambda doesn't point into the arena.
+    Lambda_expr declaration;
+    // Variables of the enclosing functions which the lambda uses.
+    std::vector<Upvalue*> upvalues;
+    // Body compiled by the Closure_compiler, nullptr when the tree-walker
+    // runs the declaration.
+    const Compiled_body* code = nullptr;
 public:
     // Invoke a call operator on the Callable instance.
-    Literal call(std::shared_ptr<Interpreter> interpreter,
-                 std::vector<Literal>& arguments) override;
+    Value call(std::shared_ptr<Interpreter> interpreter, size_t frame) override;
     // Check the arity of the function.
     uint32_t arity() override;
+    // Run the body compiled by the Closure_compiler on calls.
+    void set_code(const Compiled_body* code) { this->code = code; }
+    size_t payload_size() const { return upvalues.capacity() * sizeof(Upvalue*); }
 
-    Lambda(std::shared_ptr<Lambda_expr> declaration,
-           std::shared_ptr<Environment> closure)
-        : declaration(declaration), closure(closure) {}
-    Lambda() = default;
+    Lambda(const Lambda_expr& declaration,
+           std::vector<Upvalue*> upvalues)
+        : Callable(Obj_type::LAMBDA), declaration(declaration),
+          upvalues(std::move(upvalues)) {}
     Lambda(const Lambda&) = delete;
     Lambda(Lambda&&) = delete;
     ~Lambda() = default;
     Lambda& operator=(Lambda&) = delete;
     Lambda& operator=(Lambda&&) = delete;
+
+    void trace(Heap& heap) override;
 };
 
 #endif // __LAMBDA_H
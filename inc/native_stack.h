@@ -0,0 +1,20 @@
+#ifndef __NATIVE_STACK_H
+#define __NATIVE_STACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Size of the C++ stack the scripts run on. The tree-walking engines
+// recurse on it, so it has to hold FRAMES_MAX calls. Only the pages a run
+// touches are mapped.
+constexpr size_t NATIVE_STACK_SIZE = 256 * 1024 * 1024;
+
+// Run the code on a new thread with a C++ stack of NATIVE_STACK_SIZE bytes,
+// and wait for it to finish. The code gets the lowest stack address it may
+// start a call at, which leaves room to report a stack overflow. Exceptions
+// are passed on to the caller. Returns false if the thread could not be
+// created.
+bool run_on_native_stack(const std::function<void(uintptr_t)>& code);
+
+#endif // __NATIVE_STACK_H
@@ -0,0 +1,217 @@
+#ifndef __OBJECT_H
+#define __OBJECT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "value.h"
+#include "chunk.h"
+
+// Enum class representing all kinds of heap objects.
+enum class Obj_type : uint8_t {
+    // Shared by all three engines.
+    STRING, NATIVE, CLASS, INSTANCE, UPVALUE,
+    // Tree-walker and closure engine objects. Environments only back the
+    // globals, locals live on the interpreter's value stack.
+    ENVIRONMENT, FUNCTION, LAMBDA,
+    // Bytecode VM objects.
+    PROTOTYPE, CLOSURE, BOUND_METHOD
+};
+
+// Number of heap object kinds.
+constexpr size_t OBJ_TYPE_COUNT = static_cast<size_t>(Obj_type::BOUND_METHOD) + 1;
+
+// Name of a kind of heap objects, as shown in statistics.
+const char* obj_type_name(Obj_type type);
+
+class Heap;
+
+// Common header of every heap object.
+// All objects are chained in an intrusive list which is owned by the Heap.
+class Obj {
+    Obj_type type;
+    // Set by the collector when the object is found to be reachable.
+    bool marked = false;
+    // Pinned objects are never collected.
+    bool pinned = false;
+    // Number of bytes accounted to the object by the Heap.
+    uint32_t size = 0;
+    // Next object in the heap's object list.
+    Obj* next = nullptr;
+public:
+    Obj(Obj_type type) : type(type) {}
+    Obj(const Obj&) = delete;
+    Obj(Obj&&) = delete;
+    virtual ~Obj() = default;
+    Obj& operator=(Obj&) = delete;
+    Obj& operator=(Obj&&) = delete;
+
+    // Mark all the objects this object references.
+    virtual void trace(Heap& heap) {}
+    // Bytes the object owns outside of itself, e.g. the characters of a
+    // string. Objects with such a payload hide this; the Heap counts it
+    // along with the object.
+    size_t payload_size() const { return 0; }
+
+    Obj_type get_type() const { return type; }
+    bool is_marked() { return marked; }
+    void set_marked(bool marked) { this->marked = marked; }
+    bool is_pinned() { return pinned; }
+    void set_pinned() { pinned = true; }
+    uint32_t get_size() { return size; }
+    void set_size(uint32_t size) { this->size = size; }
+    Obj* get_next() { return next; }
+    void set_next(Obj* obj) { next = obj; }
+};
+
+// Whether the value is a heap object of the given type.
+inline bool is_obj_type(Value value, Obj_type type) {
+    return value.is_obj() && value.as_obj()->get_type() == type;
+}
+
+// FNV-1a hash of a character sequence.
+inline uint32_t hash_string(std::string_view chars) {
+    uint32_t hash = 2166136261u;
+    for (char c : chars) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Approximate bytes of the nodes and the buckets of an unordered map.
+template <typename Map>
+size_t map_payload_size(const Map& map) {
+    return map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*))
+           + map.bucket_count() * sizeof(void*);
+}
+
+// Immutable string. Strings are interned by the Heap, so two Strings with
+// the same contents are always the same object and can be compared by
+// pointer.
+class String : public Obj {
+    std::string chars;
+    // Hash of the contents, computed once on creation.
+    uint32_t hash;
+public:
+    String(std::string_view chars)
+        : Obj(Obj_type::STRING), chars(chars), hash(hash_string(chars)) {}
+    String(const String&) = delete;
+    String(String&&) = delete;
+    ~String() = default;
+    String& operator=(String&) = delete;
+    String& operator=(String&&) = delete;
+
+    const std::string& get_chars() const { return chars; }
+    uint32_t get_hash() const { return hash; }
+    size_t payload_size() const { return chars.size(); }
+};
+
+// Hasher for maps keyed by interned strings, reuses the cached hash.
+struct String_hash {
+    size_t operator()(const String* string) const { return string->get_hash(); }
+};
+
+// Compiled function body. Closures are created from it at runtime.
+class Prototype : public Obj {
+    uint32_t arity = 0;
+    uint32_t upvalue_count = 0;
+    // Most stack slots the function uses, counting its callee slot and
+    // arguments.
+    uint32_t max_stack = 0;
+    Chunk chunk;
+    // Name of the function, nullptr for lambdas and the top-level script.
+    String* name;
+public:
+    Prototype(String* name) : Obj(Obj_type::PROTOTYPE), name(name) {}
+    Prototype(const Prototype&) = delete;
+    Prototype(Prototype&&) = delete;
+    ~Prototype() = default;
+    Prototype& operator=(Prototype&) = delete;
+    Prototype& operator=(Prototype&&) = delete;
+
+    uint32_t get_arity() { return arity; }
+    void set_arity(uint32_t arity) { this->arity = arity; }
+    uint32_t get_upvalue_count() { return upvalue_count; }
+    void set_upvalue_count(uint32_t count) { upvalue_count = count; }
+    uint32_t get_max_stack() { return max_stack; }
+    void set_max_stack(uint32_t max) { max_stack = max; }
+    Chunk& get_chunk() { return chunk; }
+    String* get_name() { return name; }
+    size_t payload_size() const { return chunk.payload_size(); }
+
+    void trace(Heap& heap) override;
+};
+
+// Variable captured by a closure. While the variable is still on the stack
+// (of the VM, or of the tree-walking engines) the upvalue is "open" and
+// points to the stack slot; once the variable goes out of scope it is moved
+// into the upvalue itself.
+class Upvalue : public Obj {
+    Value* location;
+    Value closed;
+    // Next open upvalue, ordered by descending stack slot.
+    Upvalue* next_open = nullptr;
+public:
+    Upvalue(Value* slot) : Obj(Obj_type::UPVALUE), location(slot) {}
+    Upvalue(const Upvalue&) = delete;
+    Upvalue(Upvalue&&) = delete;
+    ~Upvalue() = default;
+    Upvalue& operator=(Upvalue&) = delete;
+    Upvalue& operator=(Upvalue&&) = delete;
+
+    Value* get_location() { return location; }
+    // Point an open upvalue at the slot's new address, after the stack
+    // holding it moved.
+    void set_location(Value* slot) { location = slot; }
+    Upvalue* get_next_open() { return next_open; }
+    void set_next_open(Upvalue* upvalue) { next_open = upvalue; }
+    // Move the captured variable off the stack.
+    void close() { closed = *location; location = &closed; }
+
+    void trace(Heap& heap) override;
+};
+
+// Prototype together with the variables it captured.
+class Closure : public Obj {
+    Prototype* function;
+    std::vector<Upvalue*> upvalues;
+public:
+    Closure(Prototype* function)
+        : Obj(Obj_type::CLOSURE), function(function),
+          upvalues(function->get_upvalue_count(), nullptr) {}
+    Closure(const Closure&) = delete;
+    Closure(Closure&&) = delete;
+    ~Closure() = default;
+    Closure& operator=(Closure&) = delete;
+    Closure& operator=(Closure&&) = delete;
+
+    Prototype* get_function() { return function; }
+    std::vector<Upvalue*>& get_upvalues() { return upvalues; }
+    size_t payload_size() const { return upvalues.capacity() * sizeof(Upvalue*); }
+
+    void trace(Heap& heap) override;
+};
+
+// Method closure bound to the instance it was accessed on.
+class Bound_method : public Obj {
+    Value receiver;
+    Closure* method;
+public:
+    Bound_method(Value receiver, Closure* method)
+        : Obj(Obj_type::BOUND_METHOD), receiver(receiver), method(method) {}
+    Bound_method(const Bound_method&) = delete;
+    Bound_method(Bound_method&&) = delete;
+    ~Bound_method() = default;
+    Bound_method& operator=(Bound_method&) = delete;
+    Bound_method& operator=(Bound_method&&) = delete;
+
+    Value get_receiver() { return receiver; }
+    Closure* get_method() { return method; }
+
+    void trace(Heap& heap) override;
+};
+
+#endif // __OBJECT_H
@@ -0,0 +1,117 @@
+#ifndef __OPTIMIZER_H
+#define __OPTIMIZER_H
+
+#include <ostream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "tree.h"
+#include "value.h"
+#include "object.h"
+
+class Heap;
+
+// Counters of the rewrites done by the Optimizer.
+struct Fold_stats {
+    // Operations on constants replaced by their value.
+    uint64_t folded = 0;
+    // Uses of constant variables replaced by their value.
+    uint64_t propagated = 0;
+    // If and while statements removed or replaced by a branch.
+    uint64_t pruned = 0;
+
+    // Overloaded ostream operator for printing out the statistics.
+    friend std::ostream& operator<<(std::ostream& os, const Fold_stats& stats);
+};
+
+// Visitor class which rewrites the resolved AST: it folds operations on
+// constants, propagates the literal initializers of variables which are
+// never assigned, and prunes if and while statements with constant
+// conditions.
+class Optimizer : public Expr_visitor,
+                  public Stmt_visitor {
+    // Heap which interns the folded strings.
+    Heap& heap;
+    // Tokens the AST refers to, folded literals get synthetic tokens.
+    Tokens& tokens;
+    // Arena the AST lives in.
+    Ast& ast;
+
+    // Declaration tokens of the local variables which are assigned.
+    std::unordered_set<Token_id> assigned_locals;
+    // Names of the global variables which are assigned.
+    std::unordered_set<String*> assigned_globals;
+    // Number of top level declarations of each global name.
+    std::unordered_map<String*, uint32_t> global_declarations;
+    // Literal initializers of the constant locals, keyed by declaration
+    // token.
+    std::unordered_map<Token_id, Expr_id> local_constants;
+    // Literal initializers of the constant globals, keyed by name.
+    std::unordered_map<String*, Expr_id> global_constants;
+    // Whether the visited statement is at the top level.
+    bool top_level = true;
+
+    // Since visit methods don't return anything, they leave the id of the
+    // rewritten node here. NO_NODE for a removed statement.
+    uint32_t replacement = NO_NODE;
+
+    Fold_stats stats;
+
+    // Rewrite an expression, returns the id which replaces it.
+    Expr_id fold(Expr_id expr);
+    // Rewrite a statement, returns the id which replaces it, or NO_NODE if
+    // it has no effect.
+    Stmt_id prune(Stmt_id stmt);
+    // Rewrite a statement which can't be removed from its parent.
+    Stmt_id prune_child(Stmt_id stmt);
+    // Rewrite a list of statements, dropping the removed ones.
+    Id_list prune(Id_list statements);
+    // Get the value of a literal, returns false if the expression isn't
+    // one.
+    bool is_constant(Expr_id expr, Value& value);
+    // Add a literal with the given value, located at the token.
+    Expr_id make_literal(Value value, Token_id at);
+    // Find the variables which are assigned, and the globals which are
+    // declared more than once.
+    void find_assignments(Id_list statements);
+public:
+    // Overridden visitor methods.
+    void visit_binary_expr(Binary_expr& expr) override;
+    void visit_unary_expr(Unary_expr& expr) override;
+    void visit_grouping_expr(Grouping_expr& expr) override;
+    void visit_literal_expr(Literal_expr& expr) override;
+    void visit_variable_expr(Variable_expr& expr) override;
+    void visit_assign_expr(Assign_expr& expr) override;
+    void visit_logical_expr(Logical_expr& expr) override;
+    void visit_call_expr(Call_expr& expr) override;
+    void visit_lambda_expr(Lambda_expr& expr) override;
+    void visit_get_expr(Get_expr& expr) override;
+    void visit_set_expr(Set_expr& expr) override;
+    void visit_this_expr(This_expr& expr) override;
+    void visit_super_expr(Super_expr& expr) override;
+
+    void visit_expression_stmt(Expression_stmt& stmt) override;
+    void visit_print_stmt(Print_stmt& stmt) override;
+    void visit_var_stmt(Var_stmt& stmt) override;
+    void visit_block_stmt(Block_stmt& stmt) override;
+    void visit_if_stmt(If_stmt& stmt) override;
+    void visit_while_stmt(While_stmt& stmt) override;
+    void visit_function_stmt(Function_stmt& stmt) override;
+    void visit_return_stmt(Return_stmt& stmt) override;
+    void visit_class_stmt(Class_stmt& stmt) override;
+
+    // Rewrite the top level statements, returns the rewritten list.
+    Id_list optimize(Id_list statements);
+    // Get the counters of the rewrites.
+    const Fold_stats& get_stats() { return stats; }
+
+    Optimizer(Heap& heap, Tokens& tokens, Ast& ast)
+        : heap(heap), tokens(tokens), ast(ast) {}
+    Optimizer(const Optimizer&) = delete;
+    Optimizer(Optimizer&&) = delete;
+    ~Optimizer() = default;
+    Optimizer& operator=(Optimizer&) = delete;
+    Optimizer& operator=(Optimizer&&) = delete;
+};
+
+#endif // __OPTIMIZER_H
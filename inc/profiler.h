@@ -0,0 +1,111 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+// Sampling profiler of Lox code.
+//
+// A sampling thread counts ticks at a fixed interval, and the engines poll
+// for them at safe points (statements, or calls, returns and backward jumps
+// in the VM). A poll which finds ticks records the Lox call stack, weighted
+// by the number of ticks, as a folded stack ("<script>:12;fib:3;fib:4 7"),
+// which flame graph tools take as input. The tree-walking and closure
+// engines keep a shadow stack of the calls for this, the VM walks its call
+// frames.
+//
+// A tick is charged to the stack at the next safe point, not to where it
+// happened. The tree-walking and closure engines charge the rest of a
+// statement to the next statement executed, which may be in the caller once
+// the statement returns. The VM charges straight-line code to the next
+// call, return or backward jump of the same function, so the function is
+// right but the line may be a later one.
+//
+// The engines only test a null profiler pointer when profiling is disabled.
+class Profiler {
+public:
+    // Frame of a Lox call stack.
+    struct Frame {
+        // Function name, the strings are pinned or live for the whole call.
+        std::string_view name;
+        // Line being executed in the frame.
+        uint32_t line;
+    };
+
+    // Pushes a frame onto the shadow stack for the duration of a call, if
+    // profiling is enabled.
+    class Scope {
+        Profiler* profiler;
+    public:
+        // The line is the one of the frame until its first statement
+        // runs, which may be never for a class without an initializer.
+        Scope(Profiler* profiler, std::string_view name, uint32_t line = 0)
+            : profiler(profiler) {
+            if (profiler != nullptr)
+                profiler->frames.push_back(Frame{name, line});
+        }
+        Scope(const Scope&) = delete;
+        Scope(Scope&&) = delete;
+        ~Scope() {
+            if (profiler != nullptr)
+                profiler->frames.pop_back();
+        }
+        Scope& operator=(Scope&) = delete;
+        Scope& operator=(Scope&&) = delete;
+    };
+private:
+    std::chrono::microseconds interval;
+
+    // Shadow stack, the top level script at the bottom.
+    std::vector<Frame> frames;
+    // Ticks of the sampling thread since the last recorded sample.
+    std::atomic<uint32_t> ticks{0};
+    // Sample counts of the folded stacks.
+    std::unordered_map<std::string, uint64_t> samples;
+
+    std::thread sampler;
+    // Wakes the sampling thread up to stop.
+    std::mutex mutex;
+    std::condition_variable wake_up;
+    bool stopping = false;
+
+    // Body of the sampling thread.
+    void tick();
+public:
+    Profiler(std::chrono::microseconds interval);
+    Profiler(const Profiler&) = delete;
+    Profiler(Profiler&&) = delete;
+    ~Profiler();
+    Profiler& operator=(Profiler&) = delete;
+    Profiler& operator=(Profiler&&) = delete;
+
+    // Start and stop the sampling thread.
+    void start();
+    void stop();
+
+    // Whether the sampling thread ticked since the last sample.
+    bool is_sample_due() { return ticks.load(std::memory_order_relaxed) != 0; }
+    // Note the line executed in the top frame of the shadow stack, and take
+    // a sample if one is due.
+    void poll(uint32_t line) {
+        frames.back().line = line;
+        if (is_sample_due())
+            record(frames);
+    }
+    // Record a sample of the given call stack.
+    void record(const std::vector<Frame>& stack);
+
+    // Write the folded stacks, one per line.
+    void write(std::ostream& out);
+};
+
+#endif // __PROFILER_H
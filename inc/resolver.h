@@ -3,18 +3,48 @@
 
 #include <stack>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "tree.h"
-
-class Interpreter;
+#include "error_handling.h"
 
 // Visitor class which resolves all of the variables that the AST contains.
+//
+// Local variables live in the stack frame of the function which declares
+// them, in the slots handed out here. A variable which an inner function
+// uses is captured by it: each function between the declaration and the
+// use gets an upvalue for it, from the frame or from the upvalues of the
+// function enclosing it. Only the captured variables are moved off the
+// stack, into their upvalue cells, when their scope is left.
 class Resolver : public Expr_visitor,
-                 public Stmt_visitor,
-                 public std::enable_shared_from_this<Resolver> {
-    using scope = std::unordered_map<std::string, bool>;
-
-    std::shared_ptr<Interpreter> interpreter;
+                 public Stmt_visitor {
+    // Variable declared in a scope.
+    struct Binding {
+        // Whether the variable's initializer has been resolved.
+        bool defined;
+        // Slot of the variable in the frame of its function.
+        uint32_t slot;
+        // Name token of the declaration, NO_TOKEN for "this" and "super".
+        Token_id declaration;
+    };
+    // Scope of a block, function or class.
+    struct Scope {
+        std::unordered_map<std::string_view, Binding> bindings;
+        // Index of the function whose frame holds the bindings.
+        size_t function;
+        // First slot of the scope's bindings.
+        uint32_t first_slot;
+        // Whether a closure captures any of the bindings.
+        bool captured = false;
+    };
+    // Function (or the top level script) being resolved.
+    struct Frame {
+        // Next free slot of the function's stack frame.
+        uint32_t slots = 0;
+        // Encoded captures of the function.
+        std::vector<uint32_t> captures;
+    };
 
     // Describes whether we are resolving something inside a function declaration.
     enum class Function_type {
@@ -33,57 +63,77 @@ class Resolver : public Expr_visitor,
     Class_type current_class = Class_type::NONE;
 
     // Stack of scopes.
-    std::vector<scope> scopes;
+    std::vector<Scope> scopes;
+    // Stack of the functions being resolved, the script is the first one.
+    std::vector<Frame> frames = std::vector<Frame>(1);
+    // Captures of the resolved functions and lambdas. Adding a list to the
+    // arena may move the lists being iterated, so they are only added at
+    // the end.
+    std::vector<std::pair<Function_stmt*, std::vector<uint32_t>>> function_captures;
+    std::vector<std::pair<Lambda_expr*, std::vector<uint32_t>>> lambda_captures;
+
+    // Tokens the AST refers to.
+    const Tokens& tokens;
+    // Arena the AST lives in.
+    Ast& ast;
+    // Reporter of the resolution errors.
+    error_handling::Reporter& errors;
 
     // Resolve a single statement.
-    void resolve(std::shared_ptr<Stmt> stmt);
+    void resolve_stmt(Stmt_id stmt);
     // Resolve a single expression.
-    void resolve(std::shared_ptr<Expr> expr);
-    // Create a new block scope.
-    void begin_scope() { scopes.push_back(scope()); }
-    // Exit a block scope.
-    void end_scope() { scopes.pop_back(); }
+    void resolve_expr(Expr_id expr);
+    // Create a new scope.
+    void begin_scope();
+    // Exit a scope, returns whether any of its bindings is captured.
+    bool end_scope();
+    // Start resolving a function body.
+    void begin_function();
+    // Finish resolving a function body, returns its captures.
+    std::vector<uint32_t> end_function();
+    // Find or add a capture of a function, returns its index.
+    uint32_t add_capture(size_t function, uint32_t index, bool is_local);
     // Declare a binding.
-    void declare(std::shared_ptr<Token> name);
+    void declare(Token_id name);
     // Define a binding.
-    void define(std::shared_ptr<Token> name);
+    void define(Token_id name);
     // Resolve a local variable.
-    void resolve_local(std::shared_ptr<Expr> expr, std::shared_ptr<Token> name);
+    void resolve_local(Resolution& resolution, std::string_view name);
     // Resolve a function.
-    void resolve_function(std::shared_ptr<Function_stmt> function, Function_type type);
+    void resolve_function(Function_stmt& function, Function_type type);
     // Resolve a lambda.
-    void resolve_lambda(std::shared_ptr<Lambda_expr> lambda);
+    void resolve_lambda(Lambda_expr& lambda);
 public:
     // Overridden visitor methods.
-    void visit_block_stmt(std::shared_ptr<Block_stmt> stmt) override;
-    void visit_var_stmt(std::shared_ptr<Var_stmt> stmt) override;
-    void visit_function_stmt(std::shared_ptr<Function_stmt> stmt) override;
-    void visit_expression_stmt(std::shared_ptr<Expression_stmt> stmt) override;
-    void visit_if_stmt(std::shared_ptr<If_stmt> stmt) override;
-    void visit_print_stmt(std::shared_ptr<Print_stmt> stmt) override;
-    void visit_return_stmt(std::shared_ptr<Return_stmt> stmt) override;
-    void visit_while_stmt(std::shared_ptr<While_stmt> stmt) override;
-    void visit_class_stmt(std::shared_ptr<Class_stmt> stmt) override;
+    void visit_block_stmt(Block_stmt& stmt) override;
+    void visit_var_stmt(Var_stmt& stmt) override;
+    void visit_function_stmt(Function_stmt& stmt) override;
+    void visit_expression_stmt(Expression_stmt& stmt) override;
+    void visit_if_stmt(If_stmt& stmt) override;
+    void visit_print_stmt(Print_stmt& stmt) override;
+    void visit_return_stmt(Return_stmt& stmt) override;
+    void visit_while_stmt(While_stmt& stmt) override;
+    void visit_class_stmt(Class_stmt& stmt) override;
 
-    void visit_variable_expr(std::shared_ptr<Variable_expr> expr) override;
-    void visit_assign_expr(std::shared_ptr<Assign_expr> expr) override;
-    void visit_binary_expr(std::shared_ptr<Binary_expr> expr) override;
-    void visit_call_expr(std::shared_ptr<Call_expr> expr) override;
-    void visit_grouping_expr(std::shared_ptr<Grouping_expr> expr) override;
-    void visit_literal_expr(std::shared_ptr<Literal_expr> expr) override;
-    void visit_logical_expr(std::shared_ptr<Logical_expr> expr) override;
-    void visit_unary_expr(std::shared_ptr<Unary_expr> expr) override;
-    void visit_lambda_expr(std::shared_ptr<Lambda_expr> expr) override;
-    void visit_get_expr(std::shared_ptr<Get_expr> expr) override;
-    void visit_set_expr(std::shared_ptr<Set_expr> expr) override;
-    void visit_this_expr(std::shared_ptr<This_expr> expr) override;
-    void visit_super_expr(std::shared_ptr<Super_expr> expr) override;
+    void visit_variable_expr(Variable_expr& expr) override;
+    void visit_assign_expr(Assign_expr& expr) override;
+    void visit_binary_expr(Binary_expr& expr) override;
+    void visit_call_expr(Call_expr& expr) override;
+    void visit_grouping_expr(Grouping_expr& expr) override;
+    void visit_literal_expr(Literal_expr& expr) override;
+    void visit_logical_expr(Logical_expr& expr) override;
+    void visit_unary_expr(Unary_expr& expr) override;
+    void visit_lambda_expr(Lambda_expr& expr) override;
+    void visit_get_expr(Get_expr& expr) override;
+    void visit_set_expr(Set_expr& expr) override;
+    void visit_this_expr(This_expr& expr) override;
+    void visit_super_expr(Super_expr& expr) override;
 
     // Resolve a list of statements.
-    void resolve(std::list<std::shared_ptr<Stmt>>& statements);
+    void resolve(Id_list statements);
 
-    Resolver(std::shared_ptr<Interpreter> interpreter)
-        : interpreter(interpreter) {}
+    Resolver(const Tokens& tokens, Ast& ast, error_handling::Reporter& errors)
+        : tokens(tokens), ast(ast), errors(errors) {}
     Resolver(const Resolver&) = delete;
     Resolver(Resolver&&) = delete;
     ~Resolver() = default;
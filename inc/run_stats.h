@@ -0,0 +1,84 @@
+#ifndef __RUN_STATS_H
+#define __RUN_STATS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "heap.h"
+#include "token.h"
+#include "tree.h"
+
+// Measurements of a single phase of a run.
+struct Phase_stats {
+    std::string name;
+    double wall_seconds = 0.;
+    // CPU time of the running thread.
+    double cpu_seconds = 0.;
+    // Tokens and AST nodes which exist at the end of the phase.
+    size_t tokens = 0;
+    size_t nodes = 0;
+    // Heap objects allocated during the phase, indexed by their Obj_type.
+    std::array<uint64_t, OBJ_TYPE_COUNT> objects{};
+    // Peak resident set size of the process up to the end of the phase.
+    long peak_rss_kib = 0;
+};
+
+// Wall time, CPU time, sizes and allocations of every phase of a run (scan,
+// parse, resolve, ..., run), reported after the run.
+class Run_stats {
+    Heap& heap;
+    const Tokens& tokens;
+    const Ast& ast;
+
+    std::vector<Phase_stats> phases;
+
+    // State at the start of the current phase.
+    std::chrono::steady_clock::time_point wall_start;
+    double cpu_start = 0.;
+    std::array<uint64_t, OBJ_TYPE_COUNT> objects_start{};
+
+    // Sum of all the phases.
+    Phase_stats total();
+public:
+    // RAII guard which measures a phase, does nothing if the statistics
+    // aren't collected.
+    class Phase {
+        Run_stats* stats;
+    public:
+        Phase(Run_stats* stats, std::string name) : stats(stats) {
+            if (stats != nullptr)
+                stats->begin(std::move(name));
+        }
+        Phase(const Phase&) = delete;
+        Phase(Phase&&) = delete;
+        ~Phase() {
+            if (stats != nullptr)
+                stats->end();
+        }
+        Phase& operator=(Phase&) = delete;
+        Phase& operator=(Phase&&) = delete;
+    };
+
+    Run_stats(Heap& heap, const Tokens& tokens, const Ast& ast)
+        : heap(heap), tokens(tokens), ast(ast) {}
+    Run_stats(const Run_stats&) = delete;
+    Run_stats(Run_stats&&) = delete;
+    ~Run_stats() = default;
+    Run_stats& operator=(Run_stats&) = delete;
+    Run_stats& operator=(Run_stats&&) = delete;
+
+    // Start and finish measuring a phase.
+    void begin(std::string name);
+    void end();
+
+    // Print the statistics as a table.
+    void write_text(std::ostream& out);
+    // Print the statistics as a JSON object.
+    void write_json(std::ostream& out);
+};
+
+#endif // __RUN_STATS_H
@@ -1,10 +1,21 @@
 #ifndef __RUNTIME_ERROR_H
 #define __RUNTIME_ERROR_H
 
+#include <stdexcept>
+#include <string>
+#include <memory>
+
+#include "token.h"
+
+// Maximum depth of the call stack, counting the top-level script. Deeper
+// calls fail with a "Stack overflow!" runtime error in every engine.
+constexpr uint32_t FRAMES_MAX = 16384;
+
 class Runtime_error : public std::runtime_error {
-    std::shared_ptr<Token> token;
+    // Token the error is reported at.
+    Token_id token;
 public:
-    Runtime_error(std::string msg, std::shared_ptr<Token> token)
+    Runtime_error(std::string msg, Token_id token)
         : std::runtime_error(msg), token(token) {}
     Runtime_error(const Runtime_error&) = default;
     Runtime_error(Runtime_error&&) = default;
@@ -12,7 +23,7 @@ public:
     Runtime_error& operator=(Runtime_error&) = default;
     Runtime_error& operator=(Runtime_error&&) = default;
 
-    std::shared_ptr<Token> get_token() { return token; }
+    Token_id get_token() { return token; }
 };
 
 #endif
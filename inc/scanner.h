@@ -1,32 +1,37 @@
 #ifndef __SCANNER_H
 #define __SCANNER_H
 
-#include <list>
-#include <iostream>
-#include <fstream>
-#include <sys/stat.h>
+#include <string_view>
 #include <unordered_map>
 #include <memory>
 
 #include "token.h"
+#include "heap.h"
+#include "error_handling.h"
 
+// Scanner which splits the source text into tokens. The lexemes of the
+// tokens are slices of the source text, which is never copied.
 class Scanner {
-    using keywords_map = std::unordered_map<std::string, Token_type>;
+    using keywords_map = std::unordered_map<std::string_view, Token_type>;
 
-    // Name of the source file.
-    std::string source;
+    // Source text.
+    std::string_view source;
     // Stream of valid tokens.
-    std::list<std::shared_ptr<Token>> tokens;
+    Tokens tokens;
 
-    // Current character number.
-    uint32_t current;
+    // First character of the lexeme being scanned.
+    const char* start;
+    // Current character.
+    const char* current;
+    // One past the last character of the source.
+    const char* end;
     // Current source file line being processed.
     uint32_t line;
 
-    // Source file stream.
-    std::ifstream filestream;
-    // Size of the source file (excluding EOF character).
-    uint64_t source_size;
+    // Heap which interns the identifiers and string literals.
+    Heap& heap;
+    // Reporter of the lexical errors.
+    error_handling::Reporter& errors;
 
     // Hash map of the language's keywords.
     static const keywords_map keywords;
@@ -35,13 +40,15 @@ class Scanner {
     void scan_token();
 
     // Whether the scanner has reached the end of the source file.
-    constexpr bool is_at_end() { return current >= source_size; }
-    // Advance the input stream.
-    char advance() { current++; return static_cast<char>(filestream.get()); }
-    // Roll one character back in the input stream.
-    void rollback() { filestream.unget(); current--; }
+    bool is_at_end() { return current >= end; }
+    // Advance to the next character.
+    char advance() { return *current++; }
+    // Look at the current character without consuming it.
+    char peek() { return is_at_end() ? '\0' : *current; }
     // Whether the next character in the input stream matches the expected.
-    bool match(char expected);
+    bool match(char expected) { return !is_at_end() && *current == expected; }
+    // Lexeme scanned since the start of the token.
+    std::string_view lexeme() { return std::string_view(start, current - start); }
 
     // Helper method which recognizes string literals.
     void string_lit();
@@ -49,6 +56,9 @@ class Scanner {
     void num_lit();
     // Helper method which recognizes keywords and identifiers.
     void identifier();
+    // Intern a lexeme. The strings are pinned, since the tokens (and so
+    // the AST) refer to them for the whole run.
+    String* intern(std::string_view lexeme);
 
     bool is_digit(char c) { return c >= '0' && c <= '9'; }
     bool is_alpha(char c) {
@@ -58,23 +68,25 @@ class Scanner {
     }
     bool is_alphanum(char c) { return is_digit(c) || is_alpha(c); }
 
+    // Position of the current lexeme in the source text.
+    uint32_t offset() { return start - source.data(); }
+    uint32_t length() { return current - start; }
+
     // Add new token to the token stream.
-    void add_token(Token_type type, std::string lexeme) {
-        tokens.emplace_back(std::make_shared<Token>(type, lexeme, line));
-    }
-    void add_token(Token_type type, std::string lexeme, double value) {
-        tokens.emplace_back(std::make_shared<Token>(type, lexeme, line, value));
+    void add_token(Token_type type) {
+        tokens.add(type, line, offset(), length());
     }
 public:
-    Scanner(std::string source);
+    Scanner(std::string_view source, Heap& heap,
+            error_handling::Reporter& errors);
     Scanner(const Scanner&) = delete;
     Scanner(Scanner&&) = delete;
-    ~Scanner() { filestream.close(); }
+    ~Scanner() = default;
     Scanner& operator=(Scanner&) = delete;
     Scanner& operator=(Scanner&&) = delete;
 
     // Begin the scanning process.
-    std::list<std::shared_ptr<Token>>&& scan_tokens();
+    Tokens scan_tokens();
 };
 
 #endif // __SCANNER_H
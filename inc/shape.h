@@ -0,0 +1,89 @@
+#ifndef __SHAPE_H
+#define __SHAPE_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "object.h"
+
+// Hidden class describing the layout of instance fields.
+//
+// Shapes form a transition tree rooted in the class: adding a field to an
+// instance moves it to the child shape for that field name, so instances
+// which get the same fields in the same order share a shape and keep the
+// field values in the same slots. A shape only stores the name of its last
+// field, the others are found through its ancestors.
+class Shape {
+    // Above this number of fields, slots are found through a hash map
+    // instead of a scan of the ancestors.
+    static constexpr uint32_t INDEXED_FIELDS = 8;
+
+    // Slots of the fields of a chain of shapes. A child shape adds its
+    // field to the index of its parent, unless another child already did,
+    // so a chain of shapes shares a single index. A name found in it
+    // belongs to the shape only if its slot is below the shape's field
+    // count.
+    struct Index {
+        std::unordered_map<String*, uint32_t, String_hash> slots;
+        // Number of fields of the deepest shape which added its field.
+        uint32_t field_count = 0;
+    };
+
+    // Unique id of the shape. Unlike the address, it is never reused, so
+    // it can be used as a cache key: the counter is wide enough to never
+    // wrap around, even in a process creating shapes for years.
+    uint64_t id;
+    // Shape this one adds a field to, nullptr for the root.
+    Shape* parent;
+    // Root of the transition tree, which keeps the size of the tree.
+    Shape* root;
+    // Name of the last field, in slot field_count - 1. nullptr for the
+    // root.
+    String* name;
+    uint32_t field_count;
+    // Index of the fields, only built for shapes with many fields.
+    std::shared_ptr<Index> index;
+    // Child shapes, keyed by the name of the added field.
+    std::unordered_map<String*, std::unique_ptr<Shape>, String_hash> transitions;
+    // Bytes of all the shapes of the tree, only kept by the root.
+    size_t tree_size = 0;
+public:
+    Shape();
+    Shape(Shape& parent, String* name);
+    Shape(const Shape&) = delete;
+    Shape(Shape&&) = delete;
+    ~Shape();
+    Shape& operator=(Shape&) = delete;
+    Shape& operator=(Shape&&) = delete;
+
+    uint64_t get_id() { return id; }
+    uint32_t get_field_count() { return field_count; }
+    // Bytes of the transition tree, besides the root itself. Only valid
+    // for the root.
+    size_t get_tree_size() const { return tree_size; }
+
+    // Find the slot of a field, -1 if the shape doesn't have it.
+    int64_t find(String* name) {
+        if (index != nullptr) {
+            auto slot = index->slots.find(name);
+            if (slot == index->slots.end() || slot->second >= field_count)
+                return -1;
+            return slot->second;
+        }
+
+        for (Shape* shape = this; shape->parent != nullptr; shape = shape->parent) {
+            if (shape->name == name)
+                return shape->field_count - 1;
+        }
+        return -1;
+    }
+    // Get the shape with the field added, creating it if needed.
+    Shape* add(String* name);
+
+    // Mark the field names of this shape and all of its descendants.
+    void trace(Heap& heap);
+};
+
+#endif // __SHAPE_H
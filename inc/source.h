@@ -0,0 +1,35 @@
+#ifndef __SOURCE_H
+#define __SOURCE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Contents of a source file.
+//
+// Regular files are memory-mapped, so the scanner reads them in place and
+// the tokens refer to the mapping instead of copying their lexemes. Other
+// files (pipes, character devices) are read into a buffer. The contents
+// must outlive every token scanned from them.
+class Source_file {
+    // Start of the mapping, nullptr if the file was read into the buffer.
+    char* mapping = nullptr;
+    size_t mapping_size = 0;
+    // Contents of files which couldn't be mapped.
+    std::string buffer;
+    std::string_view text;
+    bool opened = false;
+public:
+    Source_file(const std::string& path);
+    Source_file(const Source_file&) = delete;
+    Source_file(Source_file&&) = delete;
+    ~Source_file();
+    Source_file& operator=(Source_file&) = delete;
+    Source_file& operator=(Source_file&&) = delete;
+
+    // Whether the file was opened and read successfully.
+    bool is_open() { return opened; }
+    std::string_view get_text() { return text; }
+};
+
+#endif // __SOURCE_H
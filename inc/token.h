@@ -3,7 +3,8 @@
 
 #include <cstdint>
 #include <string>
-#include <ostream>
+#include <string_view>
+#include <vector>
 
 // Enum class representing all token types.
 enum class Token_type : uint8_t {
@@ -24,29 +25,79 @@ enum class Token_type : uint8_t {
     END
 };
 
-class Token {
+class String;
+
+// Index of a token in the token stream.
+using Token_id = uint32_t;
+
+// A token of the source text. Tokens don't own their lexemes, they refer
+// to them by position in the source text.
+struct Token {
     Token_type type;
-    std::string lexeme;
     // Line on which the token appears.
     uint32_t line;
-    // For NUMBER tokens, contains the real number value.
-    double value;
+    // Position of the lexeme in the source text.
+    uint32_t offset;
+    uint32_t length;
+    // For NUMBER tokens, index of the value in the numbers of the stream.
+    // For IDENTIFIER, STRING, THIS and SUPER tokens, index of the interned
+    // lexeme in the strings of the stream.
+    uint32_t value;
+};
+
+// Contiguous stream of tokens produced by the scanner. The parser and the
+// AST refer to the tokens by index.
+class Tokens {
+    friend class Cache_file;
+
+    // Source text the lexemes are sliced from.
+    std::string_view source;
+    std::vector<Token> tokens;
+    // Side arrays with the values of the tokens which have one.
+    std::vector<double> numbers;
+    std::vector<String*> strings;
 public:
-    Token(Token_type type, std::string lexeme, uint32_t line, double value = 0.)
-        : type(type), lexeme(lexeme), line(line), value(value) {}
-    Token(const Token&) = default;
-    Token(Token&&) = default;
-    ~Token() = default;
-    Token& operator=(Token&) = default;
-    Token& operator=(Token&&) = default;
-
-    Token_type get_type() { return type; }
-    const std::string& get_lexeme() const { return lexeme; }
-    uint32_t get_line() { return line; }
-    double get_value() { return value; }
-
-    // Overloaded operator for printing the token.
-    friend std::ostream& operator<<(std::ostream& os, const Token& tok);
+    Tokens(std::string_view source) : source(source) {}
+    Tokens(const Tokens&) = delete;
+    Tokens(Tokens&&) = default;
+    ~Tokens() = default;
+    Tokens& operator=(Tokens&) = delete;
+    Tokens& operator=(Tokens&&) = default;
+
+    // Append a token to the stream, returns its index.
+    Token_id add(Token_type type, uint32_t line, uint32_t offset,
+                 uint32_t length) {
+        tokens.push_back(Token{type, line, offset, length, 0});
+        return tokens.size() - 1;
+    }
+    Token_id add_number(uint32_t line, uint32_t offset, uint32_t length,
+                        double value) {
+        numbers.push_back(value);
+        tokens.push_back(Token{Token_type::NUMBER, line, offset, length,
+                               static_cast<uint32_t>(numbers.size() - 1)});
+        return tokens.size() - 1;
+    }
+    Token_id add_string(Token_type type, uint32_t line, uint32_t offset,
+                        uint32_t length, String* string) {
+        strings.push_back(string);
+        tokens.push_back(Token{type, line, offset, length,
+                               static_cast<uint32_t>(strings.size() - 1)});
+        return tokens.size() - 1;
+    }
+
+    size_t size() const { return tokens.size(); }
+
+    Token_type get_type(Token_id token) const { return tokens[token].type; }
+    uint32_t get_line(Token_id token) const { return tokens[token].line; }
+    std::string_view get_lexeme(Token_id token) const {
+        return source.substr(tokens[token].offset, tokens[token].length);
+    }
+    double get_value(Token_id token) const {
+        return numbers[tokens[token].value];
+    }
+    String* get_string(Token_id token) const {
+        return strings[tokens[token].value];
+    }
 };
 
 #endif //__TOKEN_H
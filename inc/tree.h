@@ -1,642 +1,646 @@
 #ifndef __TREE_H
 #define __TREE_H
 
-#include <memory>
-#include <list>
+#include <algorithm>
+#include <cstdint>
+#include <tuple>
 #include <vector>
 
 #include "token.h"
+#include "inline_cache.h"
+
+// The AST lives in an arena (the Ast class below): the nodes of each kind
+// are stored in a contiguous array, and refer to each other by 32-bit ids.
+// The kind of a node is kept in the top bits of its id, the index in the
+// array of that kind in the rest.
+
+// Id of an expression node.
+using Expr_id = uint32_t;
+// Id of a statement node.
+using Stmt_id = uint32_t;
+
+constexpr uint32_t NODE_KIND_BITS = 4;
+constexpr uint32_t NODE_INDEX_BITS = 32 - NODE_KIND_BITS;
+constexpr uint32_t NODE_INDEX_MASK = (1U << NODE_INDEX_BITS) - 1;
+
+// Id of a missing child (e.g. an if statement without an else branch).
+constexpr uint32_t NO_NODE = UINT32_MAX;
+// Id of a missing token.
+constexpr Token_id NO_TOKEN = UINT32_MAX;
+
+// Kinds of the expression nodes.
+enum class Expr_kind : uint8_t {
+    BINARY, LOGICAL, UNARY, GROUPING, LITERAL, VARIABLE, ASSIGN,
+    CALL, LAMBDA, GET, SET, SUPER, THIS
+};
 
-// Forward declarations.
-class Binary_expr;
-class Logical_expr;
-class Unary_expr;
-class Grouping_expr;
-class Literal_expr;
-class Variable_expr;
-class Assign_expr;
-class Call_expr;
-class Lambda_expr;
-class Get_expr;
-class Set_expr;
-class Super_expr;
-class This_expr;
-
-class Stmt;
-
-// The following classes describe expression nodes of the AST.
-
-// Visitor class for expression nodes.
-class Expr_visitor {
-public:
-    Expr_visitor() = default;
-    Expr_visitor(const Expr_visitor&) = delete;
-    Expr_visitor(Expr_visitor&&) = delete;
-    ~Expr_visitor() = default;
-    Expr_visitor& operator=(Expr_visitor&) = delete;
-    Expr_visitor& operator=(Expr_visitor&&) = delete;
+// Kinds of the statement nodes.
+enum class Stmt_kind : uint8_t {
+    EXPRESSION, PRINT, VAR, BLOCK, IF, WHILE, FUNCTION, RETURN, CLASS
+};
 
-    virtual void visit_binary_expr(const std::shared_ptr<Binary_expr> expr) = 0;
-    virtual void visit_unary_expr(const std::shared_ptr<Unary_expr> expr) = 0;
-    virtual void visit_grouping_expr(const std::shared_ptr<Grouping_expr> expr) = 0;
-    virtual void visit_literal_expr(const std::shared_ptr<Literal_expr> expr) = 0;
-    virtual void visit_variable_expr(const std::shared_ptr<Variable_expr> expr) = 0;
-    virtual void visit_assign_expr(const std::shared_ptr<Assign_expr> expr) = 0;
-    virtual void visit_logical_expr(const std::shared_ptr<Logical_expr> expr) = 0;
-    virtual void visit_call_expr(const std::shared_ptr<Call_expr> expr) = 0;
-    virtual void visit_lambda_expr(const std::shared_ptr<Lambda_expr> expr) = 0;
-    virtual void visit_get_expr(const std::shared_ptr<Get_expr> expr) = 0;
-    virtual void visit_set_expr(const std::shared_ptr<Set_expr> expr) = 0;
-    virtual void visit_this_expr(const std::shared_ptr<This_expr> expr) = 0;
-    virtual void visit_super_expr(const std::shared_ptr<Super_expr> expr) = 0;
-};
-
-// Parent class for expression nodes.
-class Expr {
+inline Expr_kind expr_kind(Expr_id expr) {
+    return static_cast<Expr_kind>(expr >> NODE_INDEX_BITS);
+}
+inline Stmt_kind stmt_kind(Stmt_id stmt) {
+    return static_cast<Stmt_kind>(stmt >> NODE_INDEX_BITS);
+}
+
+// List of node (or token) ids, stored contiguously in the arena.
+class Id_list {
+    uint32_t first = 0;
+    uint32_t count = 0;
 public:
-    Expr() = default;
-    Expr(const Expr&) = default;
-    Expr(Expr&&) = default;
-    virtual ~Expr() = default;
-    Expr& operator=(Expr&) = default;
-    Expr& operator=(Expr&&) = default;
-
-    // Pure virtual accept method of the visitor pattern.
-    // Since virtual methods cannot be generic, this function will not return
-    // anything, instead it will save the return value ins the visitor
-    // object state.
-    virtual void accept(const std::shared_ptr<Expr_visitor> visitor) = 0;
+    Id_list() = default;
+    Id_list(uint32_t first, uint32_t count) : first(first), count(count) {}
 
-    virtual std::shared_ptr<Expr> make_assignment_expr(std::shared_ptr<Expr> left,
-                                                       std::shared_ptr<Expr> right) { return nullptr; }
+    uint32_t get_first() const { return first; }
+    uint32_t size() const { return count; }
+    bool empty() const { return count == 0; }
 };
 
-// Expression node describing binary operations.
-class Binary_expr : public Expr,
-                    public std::enable_shared_from_this<Binary_expr> {
-    std::shared_ptr<Expr> left;
-    std::shared_ptr<Expr> right;
-    std::shared_ptr<Token> op;
+// Range of the ids of an Id_list, for iteration.
+class Id_range {
+    const uint32_t* first;
+    const uint32_t* last;
 public:
-    Binary_expr(std::shared_ptr<Expr> left,
-           std::shared_ptr<Expr> right,
-           std::shared_ptr<Token> op)
-        : Expr(), left(left), right(right), op(op) {}
-    Binary_expr(const Binary_expr&) = default;
-    Binary_expr(Binary_expr&&) = default;
-    virtual ~Binary_expr() = default;
-    Binary_expr& operator=(Binary_expr&) = default;
-    Binary_expr& operator=(Binary_expr&&) = default;
-
-    std::shared_ptr<Expr> get_left() { return left; }
-    std::shared_ptr<Expr> get_right() { return right; }
-    std::shared_ptr<Token> get_op() { return op; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override {
-        visitor->visit_binary_expr(shared_from_this());
-    }
+    Id_range(const uint32_t* first, const uint32_t* last)
+        : first(first), last(last) {}
+
+    const uint32_t* begin() const { return first; }
+    const uint32_t* end() const { return last; }
+    size_t size() const { return last - first; }
+    uint32_t operator[](size_t index) const { return first[index]; }
 };
 
-// Expression node describing a function call.
-class Call_expr : public Expr,
-                  public std::enable_shared_from_this<Call_expr> {
-    std::shared_ptr<Expr> callee;
-    std::shared_ptr<Token> paren;
-    std::list<std::shared_ptr<Expr>> arguments;
-public:
-    Call_expr(std::shared_ptr<Expr> callee,
-              std::shared_ptr<Token> paren,
-              std::list<std::shared_ptr<Expr>>&& arguments)
-        : Expr(), callee(callee), paren(paren), arguments(arguments) {}
-    Call_expr(const Call_expr&) = default;
-    Call_expr(Call_expr&&) = default;
-    virtual ~Call_expr() = default;
-    Call_expr& operator=(Call_expr&) = default;
-    Call_expr& operator=(Call_expr&&) = default;
-
-    std::shared_ptr<Expr> get_callee() { return callee; }
-    std::shared_ptr<Token> get_paren() { return paren; }
-    std::list<std::shared_ptr<Expr>>& get_arguments() { return arguments; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_call_expr(shared_from_this());
-    }
+// How a resolved variable is reached.
+enum class Access : uint8_t {
+    // By name, in the globals.
+    GLOBAL,
+    // In a slot of the running function's stack frame.
+    LOCAL,
+    // Through an upvalue of the running closure, the variable is a local
+    // of an enclosing function.
+    UPVALUE
 };
 
-// Expression node describing a class getter.
-class Get_expr : public Expr,
-                 public std::enable_shared_from_this<Get_expr> {
-    std::shared_ptr<Expr> object;
-    std::shared_ptr<Token> name;
+// Where the Resolver found the variable an expression refers to.
+class Resolution {
+    Access access = Access::GLOBAL;
+    // Slot of the variable in the frame, or index of the upvalue.
+    uint32_t slot = 0;
+    // Name token of the declaration, NO_TOKEN for "this" and "super".
+    Token_id declaration = NO_TOKEN;
 public:
-    Get_expr(std::shared_ptr<Expr> object,
-              std::shared_ptr<Token> name)
-        : Expr(), object(object), name(name) {}
-    Get_expr(const Get_expr&) = default;
-    Get_expr(Get_expr&&) = default;
-    virtual ~Get_expr() = default;
-    Get_expr& operator=(Get_expr&) = default;
-    Get_expr& operator=(Get_expr&&) = default;
-
-    std::shared_ptr<Expr> get_object() { return object; }
-    std::shared_ptr<Token> get_name() { return name; }
-
-    std::shared_ptr<Expr> make_assignment_expr(std::shared_ptr<Expr> left,
-                                               std::shared_ptr<Expr> right) {
-        std::shared_ptr<Set_expr> set =
-                std::make_shared<Set_expr>(std::dynamic_pointer_cast<Get_expr>(left)->get_object(),
-                                           std::dynamic_pointer_cast<Get_expr>(left)->get_name(),
-                                           right);
-        return std::static_pointer_cast<Expr>(set);
+    void resolve(Access access, uint32_t slot, Token_id declaration) {
+        this->access = access;
+        this->slot = slot;
+        this->declaration = declaration;
     }
 
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_get_expr(shared_from_this());
-    }
+    // Whether the variable is a local, of this function or an enclosing one.
+    bool is_local() { return access != Access::GLOBAL; }
+    bool is_upvalue() { return access == Access::UPVALUE; }
+    Access get_access() { return access; }
+    uint32_t get_slot() { return slot; }
+    Token_id get_declaration() { return declaration; }
 };
 
-// Expression node describing a class setter.
-class Set_expr : public Expr,
-                 public std::enable_shared_from_this<Set_expr> {
-    std::shared_ptr<Expr> object;
-    std::shared_ptr<Token> name;
-    std::shared_ptr<Expr> value;
-public:
-    Set_expr(std::shared_ptr<Expr> object,
-             std::shared_ptr<Token> name,
-             std::shared_ptr<Expr> value)
-        : Expr(), object(object), name(name), value(value) {}
-    Set_expr(const Set_expr&) = default;
-    Set_expr(Set_expr&&) = default;
-    virtual ~Set_expr() = default;
-    Set_expr& operator=(Set_expr&) = default;
-    Set_expr& operator=(Set_expr&&) = default;
-
-    std::shared_ptr<Expr> get_object() { return object; }
-    std::shared_ptr<Token> get_name() { return name; }
-    std::shared_ptr<Expr> get_value() { return value; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_set_expr(shared_from_this());
-    }
+// Variables a closure captures when it is created are listed as encoded
+// ids: the index of a local of the enclosing function's frame, or of one of
+// the enclosing closure's upvalues, and which of the two it is.
+inline uint32_t encode_capture(uint32_t index, bool is_local) {
+    return index << 1 | (is_local ? 1 : 0);
+}
+inline bool capture_is_local(uint32_t capture) { return capture & 1; }
+inline uint32_t capture_index(uint32_t capture) { return capture >> 1; }
+
+// Specialised forms an operation node rewrites itself into, once it has
+// seen the types of its operands. Each form is guarded by a cheap type
+// check, and a node whose guard fails falls back to the generic form for
+// good.
+enum class Quick_op : uint8_t {
+    // Not evaluated yet.
+    UNQUICKENED,
+    // Operands which none of the specialised forms covers.
+    GENERIC,
+    // Binary operations on two numbers.
+    NUMBER_ADD, NUMBER_SUBTRACT, NUMBER_MULTIPLY, NUMBER_DIVIDE,
+    NUMBER_GREATER, NUMBER_GREATER_EQUAL, NUMBER_LESS, NUMBER_LESS_EQUAL,
+    // Concatenation of two strings.
+    STRING_ADD,
+    // Equality works on any operands, and needs no guard.
+    EQUAL, NOT_EQUAL,
+    // Unary operations.
+    NUMBER_NEGATE, NOT,
+    // Logical operations with a boolean left operand.
+    BOOL_AND, BOOL_OR
 };
 
-// Expression node describing a class THIS expression.
-class This_expr : public Expr,
-                  public std::enable_shared_from_this<This_expr> {
-    std::shared_ptr<Token> keyword;
-public:
-    This_expr(std::shared_ptr<Token> keyword)
-        : Expr(), keyword(keyword) {}
-    This_expr(const This_expr&) = default;
-    This_expr(This_expr&&) = default;
-    virtual ~This_expr() = default;
-    This_expr& operator=(This_expr&) = default;
-    This_expr& operator=(This_expr&&) = default;
-
-    std::shared_ptr<Token> get_keyword() { return keyword; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_this_expr(shared_from_this());
-    }
-};
+// The following classes describe expression nodes of the AST.
 
-// Expression node describing a class SUPER expression.
-class Super_expr : public Expr,
-                   public std::enable_shared_from_this<Super_expr> {
-    std::shared_ptr<Token> keyword;
-    std::shared_ptr<Token> method;
+// Expression node describing binary operations.
+class Binary_expr {
+    Expr_id left;
+    Expr_id right;
+    Token_id op;
+    Quick_op quick = Quick_op::UNQUICKENED;
 public:
-    Super_expr(std::shared_ptr<Token> keyword, std::shared_ptr<Token> method)
-        : Expr(), keyword(keyword), method(method) {}
-    Super_expr(const Super_expr&) = default;
-    Super_expr(Super_expr&&) = default;
-    virtual ~Super_expr() = default;
-    Super_expr& operator=(Super_expr&) = default;
-    Super_expr& operator=(Super_expr&&) = default;
-
-    std::shared_ptr<Token> get_keyword() { return keyword; }
-    std::shared_ptr<Token> get_method() { return method; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_super_expr(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::BINARY;
+
+    Binary_expr(Expr_id left, Expr_id right, Token_id op)
+        : left(left), right(right), op(op) {}
+
+    Expr_id get_left() { return left; }
+    Expr_id get_right() { return right; }
+    Token_id get_op() { return op; }
+    Quick_op get_quick() { return quick; }
+    void set_left(Expr_id left) { this->left = left; }
+    void set_right(Expr_id right) { this->right = right; }
+    void quicken(Quick_op quick) { this->quick = quick; }
 };
 
 // Expression node describing logical operations.
-class Logical_expr : public Expr,
-                     public std::enable_shared_from_this<Logical_expr> {
-    std::shared_ptr<Expr> left;
-    std::shared_ptr<Expr> right;
-    std::shared_ptr<Token> op;
+class Logical_expr {
+    Expr_id left;
+    Expr_id right;
+    Token_id op;
+    Quick_op quick = Quick_op::UNQUICKENED;
 public:
-    Logical_expr(std::shared_ptr<Expr> left,
-           std::shared_ptr<Expr> right,
-           std::shared_ptr<Token> op)
-        : Expr(), left(left), right(right), op(op) {}
-    Logical_expr(const Logical_expr&) = default;
-    Logical_expr(Logical_expr&&) = default;
-    virtual ~Logical_expr() = default;
-    Logical_expr& operator=(Logical_expr&) = default;
-    Logical_expr& operator=(Logical_expr&&) = default;
-
-    std::shared_ptr<Expr> get_left() { return left; }
-    std::shared_ptr<Expr> get_right() { return right; }
-    std::shared_ptr<Token> get_op() { return op; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_logical_expr(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::LOGICAL;
+
+    Logical_expr(Expr_id left, Expr_id right, Token_id op)
+        : left(left), right(right), op(op) {}
+
+    Expr_id get_left() { return left; }
+    Expr_id get_right() { return right; }
+    Token_id get_op() { return op; }
+    Quick_op get_quick() { return quick; }
+    void set_left(Expr_id left) { this->left = left; }
+    void set_right(Expr_id right) { this->right = right; }
+    void quicken(Quick_op quick) { this->quick = quick; }
 };
 
 // Expression node describing unary operations.
-class Unary_expr : public Expr,
-                   public std::enable_shared_from_this<Unary_expr> {
-    std::shared_ptr<Expr> right;
-    std::shared_ptr<Token> op;
+class Unary_expr {
+    Expr_id right;
+    Token_id op;
+    Quick_op quick = Quick_op::UNQUICKENED;
 public:
-    Unary_expr(std::shared_ptr<Expr> right,
-           std::shared_ptr<Token> op)
-        : Expr(), right(right), op(op) {}
-    Unary_expr(const Unary_expr&) = default;
-    Unary_expr(Unary_expr&&) = default;
-    virtual ~Unary_expr() = default;
-    Unary_expr& operator=(Unary_expr&) = default;
-    Unary_expr& operator=(Unary_expr&&) = default;
-
-    std::shared_ptr<Expr> get_right() { return right; }
-    std::shared_ptr<Token> get_op() { return op; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_unary_expr(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::UNARY;
+
+    Unary_expr(Expr_id right, Token_id op) : right(right), op(op) {}
+
+    Expr_id get_right() { return right; }
+    Token_id get_op() { return op; }
+    Quick_op get_quick() { return quick; }
+    void set_right(Expr_id right) { this->right = right; }
+    void quicken(Quick_op quick) { this->quick = quick; }
 };
 
-// Expression node describing the grouping of expressions (eg. (a + b)).
-class Grouping_expr : public Expr,
-                      public std::enable_shared_from_this<Grouping_expr> {
-    std::shared_ptr<Expr> expr;
+// Expression node describing groupings (parenthesized expressions).
+class Grouping_expr {
+    Expr_id expr;
 public:
-    Grouping_expr(std::shared_ptr<Expr> expr)
-        : Expr(), expr(expr) {}
-    Grouping_expr(const Grouping_expr&) = default;
-    Grouping_expr(Grouping_expr&&) = default;
-    virtual ~Grouping_expr() = default;
-    Grouping_expr& operator=(Grouping_expr&) = default;
-    Grouping_expr& operator=(Grouping_expr&&) = default;
-
-    std::shared_ptr<Expr> get_expr() { return expr; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_grouping_expr(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::GROUPING;
+
+    Grouping_expr(Expr_id expr) : expr(expr) {}
+
+    Expr_id get_expr() { return expr; }
 };
 
-// Expression node describing a literal.
-class Literal_expr : public Expr,
-                     public std::enable_shared_from_this<Literal_expr> {
-    std::shared_ptr<Token> literal;
+// Expression node describing literals.
+class Literal_expr {
+    Token_id literal;
 public:
-    Literal_expr(std::shared_ptr<Token> literal)
-        : Expr(), literal(literal) {}
-    Literal_expr(const Literal_expr&) = default;
-    Literal_expr(Literal_expr&&) = default;
-    virtual ~Literal_expr() = default;
-    Literal_expr& operator=(Literal_expr&) = default;
-    Literal_expr& operator=(Literal_expr&&) = default;
-
-    std::shared_ptr<Token> get_literal() { return literal; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_literal_expr(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::LITERAL;
+
+    Literal_expr(Token_id literal) : literal(literal) {}
+
+    Token_id get_literal() { return literal; }
 };
 
 // Expression node describing a variable.
-class Variable_expr : public Expr,
-                      public std::enable_shared_from_this<Variable_expr> {
-    std::shared_ptr<Token> name;
+class Variable_expr : public Resolution {
+    Token_id name;
 public:
-    Variable_expr(std::shared_ptr<Token> name)
-        : Expr(), name(name) {}
-    Variable_expr(const Variable_expr&) = default;
-    Variable_expr(Variable_expr&&) = default;
-    virtual ~Variable_expr() = default;
-    Variable_expr& operator=(Variable_expr&) = default;
-    Variable_expr& operator=(Variable_expr&&) = default;
-
-    std::shared_ptr<Token> get_name() { return name; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_variable_expr(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::VARIABLE;
 
-    std::shared_ptr<Expr> make_assignment_expr(std::shared_ptr<Expr> left,
-                                               std::shared_ptr<Expr> right) {
-        std::shared_ptr<Assign_expr> assign =
-                std::make_shared<Assign_expr>(std::dynamic_pointer_cast<Variable_expr>(left)->get_name(),
-                                              right);
-        return std::static_pointer_cast<Expr>(assign);
-    }
+    Variable_expr(Token_id name) : name(name) {}
+
+    Token_id get_name() { return name; }
 };
 
 // Expression node describing an assignment.
-class Assign_expr : public Expr,
-                    public std::enable_shared_from_this<Assign_expr> {
-    std::shared_ptr<Token> name;
-    std::shared_ptr<Expr> value;
+class Assign_expr : public Resolution {
+    Token_id name;
+    Expr_id value;
 public:
-    Assign_expr(std::shared_ptr<Token> name, std::shared_ptr<Expr> value)
-        : Expr(), name(name), value(value) {}
-    Assign_expr(const Assign_expr&) = default;
-    Assign_expr(Assign_expr&&) = default;
-    virtual ~Assign_expr() = default;
-    Assign_expr& operator=(Assign_expr&) = default;
-    Assign_expr& operator=(Assign_expr&&) = default;
-
-    std::shared_ptr<Token> get_name() { return name; }
-    std::shared_ptr<Expr> get_value() { return value; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override  {
-        visitor->visit_assign_expr(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::ASSIGN;
+
+    Assign_expr(Token_id name, Expr_id value) : name(name), value(value) {}
+
+    Token_id get_name() { return name; }
+    Expr_id get_value() { return value; }
+    void set_value(Expr_id value) { this->value = value; }
+};
+
+// Expression node describing a function call.
+class Call_expr {
+    Expr_id callee;
+    Token_id paren;
+    Id_list arguments;
+public:
+    static constexpr Expr_kind kind = Expr_kind::CALL;
+
+    Call_expr(Expr_id callee, Token_id paren, Id_list arguments)
+        : callee(callee), paren(paren), arguments(arguments) {}
+
+    Expr_id get_callee() { return callee; }
+    Token_id get_paren() { return paren; }
+    Id_list get_arguments() { return arguments; }
+    // Whether the callee is a property access, such calls invoke methods
+    // without binding them first.
+    bool is_invoke() { return expr_kind(callee) == Expr_kind::GET; }
+    void set_callee(Expr_id callee) { this->callee = callee; }
 };
 
 // Expression node describing a lambda expression.
-class Lambda_expr : public Expr,
-                    public std::enable_shared_from_this<Lambda_expr> {
-    std::vector<std::shared_ptr<Token>> params;
-    std::list<std::shared_ptr<Stmt>> body;
+class Lambda_expr {
+    // The 'fun' keyword.
+    Token_id keyword;
+    // Token ids of the parameters.
+    Id_list params;
+    Id_list body;
+    // Encoded captures, filled in by the resolver.
+    Id_list captures;
 public:
-    Lambda_expr(std::vector<std::shared_ptr<Token>>&& params,
-           std::list<std::shared_ptr<Stmt>>&& body)
-        : Expr(), params(params), body(body) {}
-    Lambda_expr(const Lambda_expr&) = default;
-    Lambda_expr(Lambda_expr&&) = default;
-    virtual ~Lambda_expr() = default;
-    Lambda_expr& operator=(Lambda_expr&) = default;
-    Lambda_expr& operator=(Lambda_expr&&) = default;
-
-    std::vector<std::shared_ptr<Token>>& get_params() { return params; }
-    std::list<std::shared_ptr<Stmt>>& get_body() { return body; }
-
-    void accept(const std::shared_ptr<Expr_visitor> visitor) override {
-        visitor->visit_lambda_expr(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::LAMBDA;
+
+    Lambda_expr(Token_id keyword, Id_list params, Id_list body)
+        : keyword(keyword), params(params), body(body) {}
+
+    Token_id get_keyword() { return keyword; }
+    Id_list get_params() { return params; }
+    Id_list get_body() { return body; }
+    void set_body(Id_list body) { this->body = body; }
+    Id_list get_captures() { return captures; }
+    void set_captures(Id_list captures) { this->captures = captures; }
 };
 
-// The following classes describe statement nodes of the AST.
+// Expression node describing a class getter.
+class Get_expr {
+    Expr_id object;
+    Token_id name;
+    // Fields and methods found at this site.
+    Inline_cache cache;
+public:
+    static constexpr Expr_kind kind = Expr_kind::GET;
 
-// Forward declarations.
-class Expression_stmt;
-class Print_stmt;
-class Var_stmt;
-class Block_stmt;
-class If_stmt;
-class While_stmt;
-class Function_stmt;
-class Return_stmt;
-class Class_stmt;
+    Get_expr(Expr_id object, Token_id name) : object(object), name(name) {}
 
-// Visitor class for statement nodes.
-class Stmt_visitor {
+    Expr_id get_object() { return object; }
+    Token_id get_name() { return name; }
+    Inline_cache& get_cache() { return cache; }
+    void set_object(Expr_id object) { this->object = object; }
+};
+
+// Expression node describing a class setter.
+class Set_expr {
+    Expr_id object;
+    Token_id name;
+    Expr_id value;
+    // Fields and shape transitions found at this site.
+    Inline_cache cache;
 public:
-    Stmt_visitor() = default;
-    Stmt_visitor(const Stmt_visitor&) = delete;
-    Stmt_visitor(Stmt_visitor&&) = delete;
-    ~Stmt_visitor() = default;
-    Stmt_visitor& operator=(Stmt_visitor&) = delete;
-    Stmt_visitor& operator=(Stmt_visitor&&) = delete;
+    static constexpr Expr_kind kind = Expr_kind::SET;
+
+    Set_expr(Expr_id object, Token_id name, Expr_id value)
+        : object(object), name(name), value(value) {}
 
-    virtual void visit_expression_stmt(const std::shared_ptr<Expression_stmt> stmt) = 0;
-    virtual void visit_print_stmt(const std::shared_ptr<Print_stmt> stmt) = 0;
-    virtual void visit_var_stmt(const std::shared_ptr<Var_stmt> stmt) = 0;
-    virtual void visit_block_stmt(const std::shared_ptr<Block_stmt> stmt) = 0;
-    virtual void visit_if_stmt(const std::shared_ptr<If_stmt> stmt) = 0;
-    virtual void visit_while_stmt(const std::shared_ptr<While_stmt> stmt) = 0;
-    virtual void visit_function_stmt(const std::shared_ptr<Function_stmt> stmt) = 0;
-    virtual void visit_return_stmt(const std::shared_ptr<Return_stmt> stmt) = 0;
-    virtual void visit_class_stmt(const std::shared_ptr<Class_stmt> stmt) = 0;
+    Expr_id get_object() { return object; }
+    Token_id get_name() { return name; }
+    Expr_id get_value() { return value; }
+    Inline_cache& get_cache() { return cache; }
+    void set_object(Expr_id object) { this->object = object; }
+    void set_value(Expr_id value) { this->value = value; }
 };
 
-// Parent class for statement nodes
-class Stmt {
+// Expression node describing a class SUPER expression.
+class Super_expr : public Resolution {
+    Token_id keyword;
+    Token_id method;
+    // Where "this" is found, the method is bound to it.
+    Resolution receiver;
 public:
-    Stmt() = default;
-    Stmt(const Stmt&) = default;
-    Stmt(Stmt&&) = default;
-    virtual ~Stmt() = default;
-    Stmt& operator=(Stmt&) = default;
-    Stmt& operator=(Stmt&&) = default;
-
-    // Pure virtual accept method of the visitor pattern.
-    virtual void accept(const std::shared_ptr<Stmt_visitor> visitor) = 0;
-};
-
-// Expression node describing a function declaration.
-class Function_stmt : public Stmt,
-                      public std::enable_shared_from_this<Function_stmt> {
-    std::shared_ptr<Token> name;
-    std::vector<std::shared_ptr<Token>> params;
-    std::list<std::shared_ptr<Stmt>> body;
+    static constexpr Expr_kind kind = Expr_kind::SUPER;
+
+    Super_expr(Token_id keyword, Token_id method)
+        : keyword(keyword), method(method) {}
+
+    Token_id get_keyword() { return keyword; }
+    Token_id get_method() { return method; }
+    Resolution& get_receiver() { return receiver; }
+};
+
+// Expression node describing a class THIS expression.
+class This_expr : public Resolution {
+    Token_id keyword;
 public:
-    Function_stmt(std::shared_ptr<Token> name,
-           std::vector<std::shared_ptr<Token>>&& params,
-           std::list<std::shared_ptr<Stmt>>&& body)
-        : Stmt(), name(name), params(params), body(body) {}
-    Function_stmt(const Function_stmt&) = default;
-    Function_stmt(Function_stmt&&) = default;
-    virtual ~Function_stmt() = default;
-    Function_stmt& operator=(Function_stmt&) = default;
-    Function_stmt& operator=(Function_stmt&&) = default;
-
-    std::shared_ptr<Token> get_name() { return name; }
-    std::vector<std::shared_ptr<Token>>& get_params() { return params; }
-    std::list<std::shared_ptr<Stmt>>& get_body() { return body; }
-
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override {
-        visitor->visit_function_stmt(shared_from_this());
-    }
+    static constexpr Expr_kind kind = Expr_kind::THIS;
+
+    This_expr(Token_id keyword) : keyword(keyword) {}
+
+    Token_id get_keyword() { return keyword; }
 };
 
+// Visitor class for expression nodes.
+class Expr_visitor {
+public:
+    Expr_visitor() = default;
+    Expr_visitor(const Expr_visitor&) = delete;
+    Expr_visitor(Expr_visitor&&) = delete;
+    ~Expr_visitor() = default;
+    Expr_visitor& operator=(Expr_visitor&) = delete;
+    Expr_visitor& operator=(Expr_visitor&&) = delete;
+
+    // Since virtual methods cannot be generic, the visit methods don't
+    // return anything, instead they save the return value in the visitor
+    // object state.
+    virtual void visit_binary_expr(Binary_expr& expr) = 0;
+    virtual void visit_unary_expr(Unary_expr& expr) = 0;
+    virtual void visit_grouping_expr(Grouping_expr& expr) = 0;
+    virtual void visit_literal_expr(Literal_expr& expr) = 0;
+    virtual void visit_variable_expr(Variable_expr& expr) = 0;
+    virtual void visit_assign_expr(Assign_expr& expr) = 0;
+    virtual void visit_logical_expr(Logical_expr& expr) = 0;
+    virtual void visit_call_expr(Call_expr& expr) = 0;
+    virtual void visit_lambda_expr(Lambda_expr& expr) = 0;
+    virtual void visit_get_expr(Get_expr& expr) = 0;
+    virtual void visit_set_expr(Set_expr& expr) = 0;
+    virtual void visit_this_expr(This_expr& expr) = 0;
+    virtual void visit_super_expr(Super_expr& expr) = 0;
+};
+
+// The following classes describe statement nodes of the AST.
+
 // Statement node describing expression statements.
-class Expression_stmt : public Stmt,
-                        public std::enable_shared_from_this<Expression_stmt> {
-    std::shared_ptr<Expr> expr;
+class Expression_stmt {
+    Expr_id expr;
 public:
-    Expression_stmt(std::shared_ptr<Expr> expr) : Stmt(), expr(expr) {}
-    Expression_stmt(const Expression_stmt&) = default;
-    Expression_stmt(Expression_stmt&&) = default;
-    virtual ~Expression_stmt() = default;
-    Expression_stmt& operator=(Expression_stmt&) = default;
-    Expression_stmt& operator=(Expression_stmt&&) = default;
+    static constexpr Stmt_kind kind = Stmt_kind::EXPRESSION;
 
-    std::shared_ptr<Expr> get_expr() { return expr; }
+    Expression_stmt(Expr_id expr) : expr(expr) {}
 
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override  {
-        visitor->visit_expression_stmt(shared_from_this());
-    }
+    Expr_id get_expr() { return expr; }
+    void set_expr(Expr_id expr) { this->expr = expr; }
 };
 
 // Statement node describing the print statement.
-class Print_stmt : public Stmt,
-                   public std::enable_shared_from_this<Print_stmt> {
-    std::shared_ptr<Expr> expr;
+class Print_stmt {
+    Expr_id expr;
 public:
-    Print_stmt(std::shared_ptr<Expr> expr) : Stmt(), expr(expr) {}
-    Print_stmt(const Print_stmt&) = default;
-    Print_stmt(Print_stmt&&) = default;
-    virtual ~Print_stmt() = default;
-    Print_stmt& operator=(Print_stmt&) = default;
-    Print_stmt& operator=(Print_stmt&&) = default;
+    static constexpr Stmt_kind kind = Stmt_kind::PRINT;
 
-    std::shared_ptr<Expr> get_expr() { return expr; }
+    Print_stmt(Expr_id expr) : expr(expr) {}
 
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override  {
-        visitor->visit_print_stmt(shared_from_this());
-    }
+    Expr_id get_expr() { return expr; }
+    void set_expr(Expr_id expr) { this->expr = expr; }
 };
 
 // Statement node describing the variable declaration statement.
-class Var_stmt : public Stmt,
-                 public std::enable_shared_from_this<Var_stmt> {
-    std::shared_ptr<Token> name;
-    std::shared_ptr<Expr> initializer;
+class Var_stmt {
+    Token_id name;
+    // NO_NODE if the variable has no initializer.
+    Expr_id initializer;
 public:
-    Var_stmt(std::shared_ptr<Token> name,
-             std::shared_ptr<Expr> initializer = nullptr)
-        : Stmt(), name(name), initializer(initializer) {}
-    Var_stmt(const Var_stmt&) = default;
-    Var_stmt(Var_stmt&&) = default;
-    virtual ~Var_stmt() = default;
-    Var_stmt& operator=(Var_stmt&) = default;
-    Var_stmt& operator=(Var_stmt&&) = default;
-
-    std::shared_ptr<Expr> get_initializer() { return initializer; }
-    std::shared_ptr<Token> get_name() { return name; }
-
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override  {
-        visitor->visit_var_stmt(shared_from_this());
-    }
+    static constexpr Stmt_kind kind = Stmt_kind::VAR;
+
+    Var_stmt(Token_id name, Expr_id initializer = NO_NODE)
+        : name(name), initializer(initializer) {}
+
+    Expr_id get_initializer() { return initializer; }
+    Token_id get_name() { return name; }
+    void set_initializer(Expr_id initializer) { this->initializer = initializer; }
 };
 
 // Statement node describing a block of statements.
-class Block_stmt : public Stmt,
-                   public std::enable_shared_from_this<Block_stmt> {
-    std::list<std::shared_ptr<Stmt>> statements;
+class Block_stmt {
+    Id_list statements;
+    // Set by the resolver if a closure captures any of the block's
+    // variables, whose upvalues are then closed when the block is left.
+    bool captured = false;
 public:
-    Block_stmt(std::list<std::shared_ptr<Stmt>>&& statements)
-        : statements(statements) {}
-    Block_stmt(const Block_stmt&) = default;
-    Block_stmt(Block_stmt&&) = default;
-    virtual ~Block_stmt() = default;
-    Block_stmt& operator=(Block_stmt&) = default;
-    Block_stmt& operator=(Block_stmt&&) = default;
-
-    std::list<std::shared_ptr<Stmt>>& get_statements() { return statements; }
-
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override  {
-        visitor->visit_block_stmt(shared_from_this());
-    }
+    static constexpr Stmt_kind kind = Stmt_kind::BLOCK;
+
+    Block_stmt(Id_list statements) : statements(statements) {}
+
+    Id_list get_statements() { return statements; }
+    void set_statements(Id_list statements) { this->statements = statements; }
+    bool get_captured() { return captured; }
+    void set_captured(bool captured) { this->captured = captured; }
 };
 
 // Statement node describing an 'if' statement.
-class If_stmt : public Stmt,
-                public std::enable_shared_from_this<If_stmt> {
-    std::shared_ptr<Expr> condition;
-    std::shared_ptr<Stmt> then_branch;
-    std::shared_ptr<Stmt> else_branch;
+class If_stmt {
+    Expr_id condition;
+    Stmt_id then_branch;
+    // NO_NODE if there is no else branch.
+    Stmt_id else_branch;
 public:
-    If_stmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> then_branch,
-            std::shared_ptr<Stmt> else_branch)
+    static constexpr Stmt_kind kind = Stmt_kind::IF;
+
+    If_stmt(Expr_id condition, Stmt_id then_branch, Stmt_id else_branch)
         : condition(condition), then_branch(then_branch),
           else_branch(else_branch) {}
-    If_stmt(const If_stmt&) = default;
-    If_stmt(If_stmt&&) = default;
-    virtual ~If_stmt() = default;
-    If_stmt& operator=(If_stmt&) = default;
-    If_stmt& operator=(If_stmt&&) = default;
-
-    std::shared_ptr<Expr> get_condition() { return condition; }
-    std::shared_ptr<Stmt> get_then_branch() { return then_branch; }
-    std::shared_ptr<Stmt> get_else_branch() { return else_branch; }
-
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override  {
-        visitor->visit_if_stmt(shared_from_this());
-    }
+
+    Expr_id get_condition() { return condition; }
+    Stmt_id get_then_branch() { return then_branch; }
+    Stmt_id get_else_branch() { return else_branch; }
+    void set_condition(Expr_id condition) { this->condition = condition; }
+    void set_then_branch(Stmt_id then_branch) { this->then_branch = then_branch; }
+    void set_else_branch(Stmt_id else_branch) { this->else_branch = else_branch; }
 };
 
 // Statement node describing a while loop.
-class While_stmt : public Stmt,
-                   public std::enable_shared_from_this<While_stmt> {
-    std::shared_ptr<Expr> condition;
-    std::shared_ptr<Stmt> body;
+class While_stmt {
+    Expr_id condition;
+    Stmt_id body;
 public:
-    While_stmt(std::shared_ptr<Expr> condition,
-            std::shared_ptr<Stmt> body)
-        : condition(condition), body(body) {}
-    While_stmt(const While_stmt&) = default;
-    While_stmt(While_stmt&&) = default;
-    virtual ~While_stmt() = default;
-    While_stmt& operator=(While_stmt&) = default;
-    While_stmt& operator=(While_stmt&&) = default;
+    static constexpr Stmt_kind kind = Stmt_kind::WHILE;
 
-    std::shared_ptr<Expr> get_condition() { return condition; }
-    std::shared_ptr<Stmt> get_body() { return body; }
+    While_stmt(Expr_id condition, Stmt_id body)
+        : condition(condition), body(body) {}
 
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override  {
-        visitor->visit_while_stmt(shared_from_this());
-    }
+    Expr_id get_condition() { return condition; }
+    Stmt_id get_body() { return body; }
+    void set_condition(Expr_id condition) { this->condition = condition; }
+    void set_body(Stmt_id body) { this->body = body; }
 };
 
+// Statement node describing a function declaration.
+class Function_stmt {
+    Token_id name;
+    // Token ids of the parameters.
+    Id_list params;
+    Id_list body;
+    // Encoded captures, filled in by the resolver.
+    Id_list captures;
+public:
+    static constexpr Stmt_kind kind = Stmt_kind::FUNCTION;
+
+    Function_stmt(Token_id name, Id_list params, Id_list body)
+        : name(name), params(params), body(body) {}
+
+    Token_id get_name() { return name; }
+    Id_list get_params() { return params; }
+    Id_list get_body() { return body; }
+    void set_body(Id_list body) { this->body = body; }
+    Id_list get_captures() { return captures; }
+    void set_captures(Id_list captures) { this->captures = captures; }
+};
 
 // Statement node describing the return statement.
-class Return_stmt : public Stmt,
-                    public std::enable_shared_from_this<Return_stmt> {
-    std::shared_ptr<Token> keyword;
-    std::shared_ptr<Expr> value;
+class Return_stmt {
+    Token_id keyword;
+    // NO_NODE if no value is returned.
+    Expr_id value;
 public:
-    Return_stmt(std::shared_ptr<Token> keyword,
-             std::shared_ptr<Expr> value)
-        : Stmt(), keyword(keyword), value(value) {}
-    Return_stmt(const Return_stmt&) = default;
-    Return_stmt(Return_stmt&&) = default;
-    virtual ~Return_stmt() = default;
-    Return_stmt& operator=(Return_stmt&) = default;
-    Return_stmt& operator=(Return_stmt&&) = default;
-
-    std::shared_ptr<Expr> get_value() { return value; }
-    std::shared_ptr<Token> get_keyword() { return keyword; }
-
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override  {
-        visitor->visit_return_stmt(shared_from_this());
-    }
+    static constexpr Stmt_kind kind = Stmt_kind::RETURN;
+
+    Return_stmt(Token_id keyword, Expr_id value)
+        : keyword(keyword), value(value) {}
+
+    Expr_id get_value() { return value; }
+    Token_id get_keyword() { return keyword; }
+    void set_value(Expr_id value) { this->value = value; }
 };
 
 // Statement node describing a class declaration.
-class Class_stmt : public Stmt,
-                   public std::enable_shared_from_this<Class_stmt> {
-    std::shared_ptr<Token> name;
-    std::shared_ptr<Variable_expr> superclass;
-    std::list<std::shared_ptr<Function_stmt>> methods;
+class Class_stmt {
+    Token_id name;
+    // Variable expression naming the superclass, NO_NODE if there is none.
+    Expr_id superclass;
+    // Function statements of the methods.
+    Id_list methods;
+public:
+    static constexpr Stmt_kind kind = Stmt_kind::CLASS;
+
+    Class_stmt(Token_id name, Expr_id superclass, Id_list methods)
+        : name(name), superclass(superclass), methods(methods) {}
+
+    Token_id get_name() { return name; }
+    Expr_id get_superclass() { return superclass; }
+    Id_list get_methods() { return methods; }
+};
+
+// Visitor class for statement nodes.
+class Stmt_visitor {
 public:
-    Class_stmt(std::shared_ptr<Token> name,
-               std::shared_ptr<Variable_expr> superclass,
-               std::list<std::shared_ptr<Function_stmt>>&& methods)
-        : Stmt(), name(name), superclass(superclass), methods(methods) {}
-    Class_stmt(const Class_stmt&) = default;
-    Class_stmt(Class_stmt&&) = default;
-    virtual ~Class_stmt() = default;
-    Class_stmt& operator=(Class_stmt&) = default;
-    Class_stmt& operator=(Class_stmt&&) = default;
-
-    std::shared_ptr<Token> get_name() { return name; }
-    std::shared_ptr<Variable_expr> get_superclass() { return superclass; }
-    std::list<std::shared_ptr<Function_stmt>>& get_methods() { return methods; }
-
-    void accept(const std::shared_ptr<Stmt_visitor> visitor) override  {
-        visitor->visit_class_stmt(shared_from_this());
+    Stmt_visitor() = default;
+    Stmt_visitor(const Stmt_visitor&) = delete;
+    Stmt_visitor(Stmt_visitor&&) = delete;
+    ~Stmt_visitor() = default;
+    Stmt_visitor& operator=(Stmt_visitor&) = delete;
+    Stmt_visitor& operator=(Stmt_visitor&&) = delete;
+
+    virtual void visit_expression_stmt(Expression_stmt& stmt) = 0;
+    virtual void visit_print_stmt(Print_stmt& stmt) = 0;
+    virtual void visit_var_stmt(Var_stmt& stmt) = 0;
+    virtual void visit_block_stmt(Block_stmt& stmt) = 0;
+    virtual void visit_if_stmt(If_stmt& stmt) = 0;
+    virtual void visit_while_stmt(While_stmt& stmt) = 0;
+    virtual void visit_function_stmt(Function_stmt& stmt) = 0;
+    virtual void visit_return_stmt(Return_stmt& stmt) = 0;
+    virtual void visit_class_stmt(Class_stmt& stmt) = 0;
+};
+
+// Arena which owns all the nodes of the AST.
+class Ast {
+    friend class Cache_file;
+
+    std::tuple<std::vector<Binary_expr>,
+               std::vector<Logical_expr>,
+               std::vector<Unary_expr>,
+               std::vector<Grouping_expr>,
+               std::vector<Literal_expr>,
+               std::vector<Variable_expr>,
+               std::vector<Assign_expr>,
+               std::vector<Call_expr>,
+               std::vector<Lambda_expr>,
+               std::vector<Get_expr>,
+               std::vector<Set_expr>,
+               std::vector<Super_expr>,
+               std::vector<This_expr>,
+               std::vector<Expression_stmt>,
+               std::vector<Print_stmt>,
+               std::vector<Var_stmt>,
+               std::vector<Block_stmt>,
+               std::vector<If_stmt>,
+               std::vector<While_stmt>,
+               std::vector<Function_stmt>,
+               std::vector<Return_stmt>,
+               std::vector<Class_stmt>> nodes;
+    // Storage of the Id_lists.
+    std::vector<uint32_t> lists;
+
+    template <typename T>
+    std::vector<T>& array() { return std::get<std::vector<T>>(nodes); }
+public:
+    Ast() = default;
+    Ast(const Ast&) = delete;
+    Ast(Ast&&) = delete;
+    ~Ast() = default;
+    Ast& operator=(Ast&) = delete;
+    Ast& operator=(Ast&&) = delete;
+
+    // Add a node to the arena, returns its id.
+    template <typename T>
+    uint32_t add(const T& node) {
+        std::vector<T>& nodes = array<T>();
+        nodes.push_back(node);
+        return static_cast<uint32_t>(T::kind) << NODE_INDEX_BITS
+               | static_cast<uint32_t>(nodes.size() - 1);
+    }
+    // Get a node by its id. The node must be of the given type.
+    template <typename T>
+    T& get(uint32_t id) { return array<T>()[id & NODE_INDEX_MASK]; }
+
+    // Store a list of ids in the arena.
+    Id_list add_list(const std::vector<uint32_t>& ids) {
+        Id_list list(lists.size(), ids.size());
+        lists.insert(lists.end(), ids.begin(), ids.end());
+        return list;
+    }
+    Id_range get_list(Id_list list) {
+        const uint32_t* first = lists.data() + list.get_first();
+        return Id_range(first, first + list.size());
+    }
+    // Overwrite the ids of a list with at most as many ids, returns the
+    // list of the new ids.
+    Id_list set_list(Id_list list, const std::vector<uint32_t>& ids) {
+        std::copy(ids.begin(), ids.end(), lists.begin() + list.get_first());
+        return Id_list(list.get_first(), ids.size());
+    }
+    // Number of nodes of all kinds.
+    size_t node_count() const {
+        return std::apply([](const auto&... arrays) {
+            return (arrays.size() + ...);
+        }, nodes);
     }
+    // All the nodes of a kind, in the order they were added.
+    template <typename T>
+    std::vector<T>& get_nodes() { return array<T>(); }
+
+    // First token of a node, NO_TOKEN if it has none.
+    Token_id first_token_expr(Expr_id expr);
+    Token_id first_token_stmt(Stmt_id stmt);
+    // Line a statement starts on.
+    uint32_t line_of(const Tokens& tokens, Stmt_id stmt);
+
+    // Call the visitor method for the kind of the node.
+    void accept_expr(Expr_id expr, Expr_visitor& visitor);
+    void accept_stmt(Stmt_id stmt, Stmt_visitor& visitor);
 };
 
 #endif // __TREE_H
@@ -0,0 +1,69 @@
+#ifndef __VALUE_H
+#define __VALUE_H
+
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+
+class Obj;
+
+// Value manipulated by both execution engines, NaN-boxed into 64 bits.
+//
+// Any double which is not a quiet NaN is stored as is. The remaining
+// values live in the payload of quiet NaNs: nil, true and false use
+// small tags in the low bits, and a heap object pointer (which fits into
+// 48 bits) is stored with the sign bit set. Everything which doesn't fit
+// (strings, functions, classes...) lives on the heap behind an Obj.
+//
+// A Value is trivially copyable, so copying it never allocates.
+class Value {
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+
+    static constexpr uint64_t TAG_NIL = 1;
+    static constexpr uint64_t TAG_FALSE = 2;
+    static constexpr uint64_t TAG_TRUE = 3;
+
+    static constexpr uint64_t NIL_BITS = QNAN | TAG_NIL;
+    static constexpr uint64_t FALSE_BITS = QNAN | TAG_FALSE;
+    static constexpr uint64_t TRUE_BITS = QNAN | TAG_TRUE;
+
+    uint64_t bits;
+public:
+    Value() : bits(NIL_BITS) {}
+    Value(bool boolean) : bits(boolean ? TRUE_BITS : FALSE_BITS) {}
+    Value(double number) { std::memcpy(&bits, &number, sizeof(bits)); }
+    Value(Obj* obj)
+        : bits(SIGN_BIT | QNAN | static_cast<uint64_t>(reinterpret_cast<uintptr_t>(obj))) {}
+    // Catches pointers to incomplete object types, which would otherwise
+    // silently convert to bool.
+    Value(const void*) = delete;
+
+    bool is_nil() const { return bits == NIL_BITS; }
+    bool is_bool() const { return (bits | 1) == TRUE_BITS; }
+    bool is_number() const { return (bits & QNAN) != QNAN; }
+    bool is_obj() const { return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT); }
+
+    bool as_bool() const { return bits == TRUE_BITS; }
+    double as_number() const {
+        double number;
+        std::memcpy(&number, &bits, sizeof(number));
+        return number;
+    }
+    Obj* as_obj() const {
+        return reinterpret_cast<Obj*>(static_cast<uintptr_t>(bits & ~(SIGN_BIT | QNAN)));
+    }
+
+    // Is the value considered to be TRUE.
+    bool is_truthy() const { return bits != NIL_BITS && bits != FALSE_BITS; }
+
+    // Are two values equal.
+    friend bool operator==(const Value& left, const Value& right);
+
+    // Overloaded ostream operator for printing out the value.
+    friend std::ostream& operator<<(std::ostream& os, const Value& value);
+};
+
+static_assert(sizeof(Value) == sizeof(uint64_t), "Value must be NaN-boxed");
+
+#endif // __VALUE_H
@@ -0,0 +1,103 @@
+#ifndef __VM_H
+#define __VM_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "value.h"
+#include "object.h"
+#include "callable.h"
+#include "heap.h"
+#include "error_handling.h"
+#include "runtime_error.h"
+#include "profiler.h"
+
+class Class;
+
+// Stack based virtual machine which executes the bytecode produced by the
+// Compiler.
+class Vm : public Root_set {
+    // Maximum number of values on the value stack.
+    static constexpr uint32_t STACK_MAX = FRAMES_MAX * 256;
+
+    // Activation record of a function call.
+    struct Call_frame {
+        Closure* closure;
+        // Next instruction to execute. Only updated when the frame is left.
+        uint8_t* ip;
+        // First stack slot the function can use.
+        Value* slots;
+    };
+
+    // Owner of the runtime objects.
+    Heap& heap;
+    // Tokens the runtime errors are reported at.
+    const Tokens& tokens;
+    // Reporter of the runtime errors.
+    error_handling::Reporter& errors;
+    // Stream the print instructions write to.
+    std::ostream& out;
+
+    // Value stack.
+    Value* stack;
+    Value* stack_top;
+
+    // Call stack.
+    std::vector<Call_frame> frames;
+    uint32_t frame_count = 0;
+
+    // Global variables.
+    std::unordered_map<String*, Value, String_hash> globals;
+    // Upvalues which still point into the value stack.
+    Upvalue* open_upvalues = nullptr;
+    // Sampling profiler, nullptr unless profiling.
+    Profiler* profiler = nullptr;
+    // Call stack handed to the profiler, reused between samples.
+    std::vector<Profiler::Frame> profiled_frames;
+
+    void push(Value value) { *stack_top++ = value; }
+    Value pop() { return *--stack_top; }
+    Value peek(int distance) { return stack_top[-1 - distance]; }
+
+    // Define a native function in the global scope.
+    void define_native(std::string name, Native::native_fn function,
+                       uint32_t arity);
+    // Push a new call frame for the closure.
+    void call(Closure* closure, int arg_count);
+    // Invoke a call operator on any callable value.
+    void call_value(Value callee, int arg_count);
+    // Replace the instance on top of the stack with its method bound to it.
+    bool bind_method(Class* klass, String* name);
+    // Get the upvalue for the stack slot, creating it if needed.
+    Upvalue* capture_upvalue(Value* local);
+    // Close all the open upvalues which point at or above the stack slot.
+    void close_upvalues(Value* last);
+    // Record a profiler sample of the call frames.
+    void sample_frames();
+    // Attribute the following allocations to the line of the current
+    // instruction. The ip of the current frame has to be stored.
+    void track_site();
+    // Throw a runtime error attributed to the current instruction.
+    [[noreturn]] void runtime_error(std::string msg);
+    // Execute instructions until the top-level script returns.
+    void run();
+public:
+    Vm(Heap& heap, const Tokens& tokens, error_handling::Reporter& errors,
+       std::ostream& out);
+    Vm(const Vm&) = delete;
+    Vm(Vm&&) = delete;
+    ~Vm();
+    Vm& operator=(Vm&) = delete;
+    Vm& operator=(Vm&&) = delete;
+
+    // Start the VM run.
+    void interpret(Prototype* script);
+    // Profile the run with the given profiler, or not at all if nullptr.
+    void set_profiler(Profiler* profiler) { this->profiler = profiler; }
+    // Mark the stack, the call frames, the open upvalues and the globals.
+    void mark_roots(Heap& heap) override;
+};
+
+#endif // __VM_H
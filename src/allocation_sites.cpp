@@ -0,0 +1,41 @@
+#include <algorithm>
+#include <iomanip>
+#include <utility>
+#include <vector>
+
+#include "allocation_sites.h"
+
+// Print the top sites by count, and the top sites by bytes.
+void Allocation_sites::write(std::ostream& out, size_t top) {
+    out << "top allocation sites by count:\n";
+    write_top(out, top, false);
+    out << "top allocation sites by bytes:\n";
+    write_top(out, top, true);
+}
+
+// Print the sites with the highest count or bytes, ties broken by line.
+void Allocation_sites::write_top(std::ostream& out, size_t top, bool by_bytes) {
+    std::vector<std::pair<uint64_t, Site>> sorted(sites.begin(), sites.end());
+    auto key = [by_bytes](const Site& site) {
+        return by_bytes ? site.bytes : site.count;
+    };
+    std::sort(sorted.begin(), sorted.end(), [&key](const auto& a, const auto& b) {
+        if (key(a.second) != key(b.second))
+            return key(a.second) > key(b.second);
+        return a.first < b.first;
+    });
+    if (sorted.size() > top)
+        sorted.resize(top);
+
+    out << std::setw(8) << "line" << ' ' << std::left << std::setw(14) << "kind"
+        << std::right << ' ' << std::setw(12) << "count"
+        << ' ' << std::setw(14) << "bytes" << '\n';
+    for (const auto& [id, site] : sorted) {
+        size_t kind = id & 0xff;
+        const char* name = kind == STACK
+                           ? "value stack" : obj_type_name(static_cast<Obj_type>(kind));
+        out << std::setw(8) << (id >> 8) << ' ' << std::left << std::setw(14) << name
+            << std::right << ' ' << std::setw(12) << site.count
+            << ' ' << std::setw(14) << site.bytes << '\n';
+    }
+}
@@ -1,48 +1,49 @@
 #include <cassert>
 #include <sstream>
-#include <memory>
 
 #include "ast_printer.h"
 
-void Ast_printer::visit_binary_expr(const std::shared_ptr<Binary_expr> expr) {
+void Ast_printer::visit_binary_expr(Binary_expr& expr) {
     // Print the operation.
-    result += "(" + expr->get_op()->get_lexeme();
+    result += "(";
+    result += tokens.get_lexeme(expr.get_op());
 
     // Print the left operand.
     result += " ";
-    expr->get_left()->accept(shared_from_this());
+    ast.accept_expr(expr.get_left(), *this);
 
     // Print the right operand.
     result += " ";
-    expr->get_right()->accept(shared_from_this());
+    ast.accept_expr(expr.get_right(), *this);
 
     result += ")";
 }
 
-void Ast_printer::visit_unary_expr(const std::shared_ptr<Unary_expr> expr) {
+void Ast_printer::visit_unary_expr(Unary_expr& expr) {
     // Print the operation.
-    result += "(" + expr->get_op()->get_lexeme();
+    result += "(";
+    result += tokens.get_lexeme(expr.get_op());
 
     // Print the operand.
     result += " ";
-    expr->get_right()->accept(shared_from_this());
+    ast.accept_expr(expr.get_right(), *this);
 
     result += ")";
 }
 
-void Ast_printer::visit_grouping_expr(const std::shared_ptr<Grouping_expr> expr) {
+void Ast_printer::visit_grouping_expr(Grouping_expr& expr) {
     // Print the operation.
     result += "(group";
 
     // Print the operand.
     result += " ";
-    expr->get_expr()->accept(shared_from_this());
+    ast.accept_expr(expr.get_expr(), *this);
 
     result += ")";
 }
 
-void Ast_printer::visit_literal_expr(const std::shared_ptr<Literal_expr> expr) {
-    Token_type token_type = expr->get_literal()->get_type();
+void Ast_printer::visit_literal_expr(Literal_expr& expr) {
+    Token_type token_type = tokens.get_type(expr.get_literal());
     assert(token_type == Token_type::NIL
            || token_type == Token_type::STRING
            || token_type == Token_type::NUMBER);
@@ -51,6 +52,6 @@ void Ast_printer::visit_literal_expr(const std::shared_ptr<Literal_expr> expr) {
         result += "nil";
     else if (token_type == Token_type::STRING
              || token_type == Token_type::NUMBER) {
-        result += expr->get_literal()->get_lexeme();
+        result += tokens.get_lexeme(expr.get_literal());
     }
 }
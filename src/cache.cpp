@@ -0,0 +1,531 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "cache.h"
+#include "heap.h"
+#include "object.h"
+
+// Identifies cache files. Written in native byte order, so a file from a
+// machine of the other endianness doesn't match.
+static constexpr uint64_t CACHE_MAGIC = 0x63786f6c70706321;
+
+// Fixed part at the start of a cache file.
+struct Cache_header {
+    uint64_t magic;
+    uint32_t version;
+    // Hash of the sizes of the tokens and the nodes.
+    uint32_t layout;
+    uint64_t source_hash;
+    uint64_t source_size;
+    uint32_t optimized;
+    // Top level statements of the script.
+    uint32_t first_statement;
+    uint32_t statement_count;
+    uint32_t padding;
+};
+
+// FNV-1a, fed a word at a time. The bytes may come in pieces of any size,
+// the hash is the same as of all of them at once.
+class Hasher {
+    uint64_t hash = 0xcbf29ce484222325;
+    // Bytes of an incomplete word.
+    char pending[sizeof(uint64_t)];
+    size_t pending_size = 0;
+
+    void add_word(const char* bytes) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3;
+    }
+public:
+    void add(const char* bytes, size_t size) {
+        size_t offset = 0;
+        if (pending_size > 0) {
+            offset = std::min(size, sizeof(pending) - pending_size);
+            std::memcpy(pending + pending_size, bytes, offset);
+            pending_size += offset;
+            if (pending_size < sizeof(pending))
+                return;
+            add_word(pending);
+            pending_size = 0;
+        }
+        for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+            add_word(bytes + offset);
+        std::memcpy(pending, bytes + offset, size - offset);
+        pending_size = size - offset;
+    }
+
+    uint64_t finish() {
+        for (size_t offset = 0; offset < pending_size; offset++)
+            hash = (hash ^ static_cast<uint8_t>(pending[offset])) * 0x100000001b3;
+        pending_size = 0;
+        return hash;
+    }
+};
+
+static uint64_t hash_bytes(const char* bytes, size_t size) {
+    Hasher hasher;
+    hasher.add(bytes, size);
+    return hasher.finish();
+}
+
+// Hash of the sizes of the token and node types, so that a change to any of
+// them invalidates the existing files.
+template <typename... Arrays>
+static uint32_t layout_hash(const std::tuple<Arrays...>&) {
+    uint64_t sizes[] = {sizeof(Token), sizeof(Id_list),
+                        sizeof(typename Arrays::value_type)...};
+    return static_cast<uint32_t>(hash_bytes(reinterpret_cast<const char*>(sizes),
+                                            sizeof(sizes)));
+}
+
+// Alignment of the arrays in the file, enough for any of the cached types.
+static constexpr size_t ARRAY_ALIGNMENT = 8;
+static_assert(sizeof(Cache_header) % ARRAY_ALIGNMENT == 0,
+              "The first array must be aligned!");
+
+// Writes the values to a file through the stdio buffer, remembers whether
+// any write failed. Everything after the header is hashed, for the checksum
+// which ends the file.
+class Cache_writer {
+    FILE* file;
+    size_t offset = 0;
+    bool failed = false;
+    Hasher checksum;
+public:
+    Cache_writer(FILE* file) : file(file) {}
+
+    void put_bytes(const void* bytes, size_t size) {
+        if (size > 0 && fwrite(bytes, 1, size, file) != size)
+            failed = true;
+        if (offset >= sizeof(Cache_header))
+            checksum.add(static_cast<const char*>(bytes), size);
+        offset += size;
+    }
+
+    void put_checksum() {
+        uint64_t value = checksum.finish();
+        put_bytes(&value, sizeof(value));
+    }
+
+    template <typename T>
+    void put(const T& value) { put_bytes(&value, sizeof(T)); }
+
+    // Write an array, preceded by its length. The array is padded, so that
+    // the next one is aligned and can be read in place.
+    template <typename T>
+    void put_array(const std::vector<T>& array) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "Cached arrays are copied bytewise!");
+        static_assert(ARRAY_ALIGNMENT % alignof(T) == 0,
+                      "Cached arrays must be aligned in the file!");
+        put<uint64_t>(array.size());
+        put_bytes(array.data(), array.size() * sizeof(T));
+
+        static const char padding[ARRAY_ALIGNMENT] = {};
+        put_bytes(padding, (ARRAY_ALIGNMENT - offset % ARRAY_ALIGNMENT)
+                           % ARRAY_ALIGNMENT);
+    }
+
+    bool has_failed() { return failed; }
+};
+
+// Reads the values back from a mapped file, failing on a truncated one.
+class Cache_reader {
+    const char* current;
+    const char* end;
+public:
+    Cache_reader(const char* start, size_t size)
+        : current(start), end(start + size) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (static_cast<size_t>(end - current) < sizeof(T))
+            return false;
+        std::memcpy(&value, current, sizeof(T));
+        current += sizeof(T);
+        return true;
+    }
+
+    // The arrays start aligned, since the mapping is page-aligned and the
+    // writer pads them.
+    template <typename T>
+    bool get_array(std::vector<T>& array) {
+        uint64_t size;
+        if (!get(size) || static_cast<size_t>(end - current) / sizeof(T) < size)
+            return false;
+        const T* first = reinterpret_cast<const T*>(current);
+        array.assign(first, first + size);
+
+        size_t padded = (size * sizeof(T) + ARRAY_ALIGNMENT - 1)
+                        / ARRAY_ALIGNMENT * ARRAY_ALIGNMENT;
+        current += std::min(padded, static_cast<size_t>(end - current));
+        return true;
+    }
+
+    bool get_chars(std::string_view& chars) {
+        uint32_t size;
+        if (!get(size) || static_cast<size_t>(end - current) < size)
+            return false;
+        chars = std::string_view(current, size);
+        current += size;
+        return true;
+    }
+
+    bool is_at_end() { return current == end; }
+};
+
+// Checks every id of a loaded file against the sizes of the arrays it
+// indexes. A damaged file whose header still matches must be a miss, not
+// out of bounds reads in the engines.
+template <typename Nodes>
+class Cache_checker {
+    Nodes& nodes;
+    const std::vector<uint32_t>& lists;
+    const std::vector<Token>& token_array;
+    // Number of nodes of every expression and statement kind, zero for the
+    // unused kinds.
+    size_t expr_counts[1U << NODE_KIND_BITS] = {};
+    size_t stmt_counts[1U << NODE_KIND_BITS] = {};
+
+    template <typename T>
+    void count(const std::vector<T>& array) {
+        if constexpr (std::is_same<std::decay_t<decltype(T::kind)>, Expr_kind>::value)
+            expr_counts[static_cast<size_t>(T::kind)] = array.size();
+        else
+            stmt_counts[static_cast<size_t>(T::kind)] = array.size();
+    }
+
+    bool token(Token_id id) { return id < token_array.size(); }
+    // The engines switch over the types of the operators and literals, and
+    // look the names up as interned strings.
+    template <typename... Types>
+    bool token(Token_id id, Types... types) {
+        return token(id) && ((token_array[id].type == types) || ...);
+    }
+    bool name(Token_id id) { return token(id, Token_type::IDENTIFIER); }
+    bool expr(Expr_id id) {
+        return (id & NODE_INDEX_MASK) < expr_counts[id >> NODE_INDEX_BITS];
+    }
+    bool stmt(Stmt_id id) {
+        return (id & NODE_INDEX_MASK) < stmt_counts[id >> NODE_INDEX_BITS];
+    }
+    bool optional_expr(Expr_id id) { return id == NO_NODE || expr(id); }
+    bool optional_stmt(Stmt_id id) { return id == NO_NODE || stmt(id); }
+
+    bool list(Id_list list) {
+        return static_cast<uint64_t>(list.get_first()) + list.size()
+               <= lists.size();
+    }
+    template <typename Check>
+    bool list_of(Id_list list, Check check) {
+        if (!this->list(list))
+            return false;
+        auto first = lists.begin() + list.get_first();
+        return std::all_of(first, first + list.size(), check);
+    }
+    bool names(Id_list ids) {
+        return list_of(ids, [this](uint32_t id) { return name(id); });
+    }
+    bool exprs(Id_list ids) {
+        return list_of(ids, [this](uint32_t id) { return expr(id); });
+    }
+    bool stmts(Id_list ids) {
+        return list_of(ids, [this](uint32_t id) { return stmt(id); });
+    }
+    bool resolution(Resolution& resolution) {
+        return resolution.get_access() <= Access::UPVALUE
+               && (resolution.get_declaration() == NO_TOKEN
+                   || token(resolution.get_declaration()));
+    }
+
+    // The nodes are cached unquickened and with empty inline caches.
+    bool node(Binary_expr& node) {
+        return expr(node.get_left()) && expr(node.get_right())
+               && token(node.get_op(), Token_type::BANG_EQUAL,
+                        Token_type::EQUAL_EQUAL, Token_type::GREATER,
+                        Token_type::GREATER_EQUAL, Token_type::LESS,
+                        Token_type::LESS_EQUAL, Token_type::PLUS,
+                        Token_type::MINUS, Token_type::STAR, Token_type::SLASH)
+               && node.get_quick() == Quick_op::UNQUICKENED;
+    }
+    bool node(Logical_expr& node) {
+        return expr(node.get_left()) && expr(node.get_right())
+               && token(node.get_op(), Token_type::AND, Token_type::OR)
+               && node.get_quick() == Quick_op::UNQUICKENED;
+    }
+    bool node(Unary_expr& node) {
+        return expr(node.get_right())
+               && token(node.get_op(), Token_type::MINUS, Token_type::BANG)
+               && node.get_quick() == Quick_op::UNQUICKENED;
+    }
+    bool node(Grouping_expr& node) { return expr(node.get_expr()); }
+    bool node(Literal_expr& node) {
+        return token(node.get_literal(), Token_type::NIL, Token_type::TRUE,
+                     Token_type::FALSE, Token_type::NUMBER, Token_type::STRING);
+    }
+    bool node(Variable_expr& node) {
+        return name(node.get_name()) && resolution(node);
+    }
+    bool node(Assign_expr& node) {
+        return name(node.get_name()) && expr(node.get_value())
+               && resolution(node);
+    }
+    bool node(Call_expr& node) {
+        return expr(node.get_callee()) && token(node.get_paren())
+               && exprs(node.get_arguments());
+    }
+    bool node(Lambda_expr& node) {
+        return token(node.get_keyword()) && names(node.get_params())
+               && stmts(node.get_body()) && list(node.get_captures());
+    }
+    bool node(Get_expr& node) {
+        return expr(node.get_object()) && name(node.get_name())
+               && node.get_cache().is_empty();
+    }
+    bool node(Set_expr& node) {
+        return expr(node.get_object()) && name(node.get_name())
+               && expr(node.get_value()) && node.get_cache().is_empty();
+    }
+    bool node(Super_expr& node) {
+        return token(node.get_keyword(), Token_type::SUPER)
+               && name(node.get_method())
+               && resolution(node) && resolution(node.get_receiver());
+    }
+    bool node(This_expr& node) {
+        return token(node.get_keyword(), Token_type::THIS) && resolution(node);
+    }
+    bool node(Expression_stmt& node) { return expr(node.get_expr()); }
+    bool node(Print_stmt& node) { return expr(node.get_expr()); }
+    bool node(Var_stmt& node) {
+        return name(node.get_name()) && optional_expr(node.get_initializer());
+    }
+    bool node(Block_stmt& node) { return stmts(node.get_statements()); }
+    bool node(If_stmt& node) {
+        return expr(node.get_condition()) && stmt(node.get_then_branch())
+               && optional_stmt(node.get_else_branch());
+    }
+    bool node(While_stmt& node) {
+        return expr(node.get_condition()) && stmt(node.get_body());
+    }
+    bool node(Function_stmt& node) {
+        return name(node.get_name()) && names(node.get_params())
+               && stmts(node.get_body()) && list(node.get_captures());
+    }
+    bool node(Return_stmt& node) {
+        return token(node.get_keyword()) && optional_expr(node.get_value());
+    }
+    // The engines take the superclass for a variable and the methods for
+    // functions without checking.
+    bool node(Class_stmt& node) {
+        return name(node.get_name())
+               && (node.get_superclass() == NO_NODE
+                   || (expr(node.get_superclass())
+                       && expr_kind(node.get_superclass()) == Expr_kind::VARIABLE))
+               && list_of(node.get_methods(), [this](uint32_t id) {
+                      return stmt(id) && stmt_kind(id) == Stmt_kind::FUNCTION;
+                  });
+    }
+public:
+    Cache_checker(Nodes& nodes, const std::vector<uint32_t>& lists,
+                  const std::vector<Token>& tokens)
+        : nodes(nodes), lists(lists), token_array(tokens) {
+        std::apply([this](const auto&... arrays) {
+            (count(arrays), ...);
+        }, nodes);
+    }
+
+    // Whether all the nodes and the top level statements are in range.
+    bool check(Id_list statements) {
+        return stmts(statements)
+               && std::apply([this](auto&... arrays) {
+                      return (std::all_of(arrays.begin(), arrays.end(),
+                                          [this](auto& node) {
+                                              return this->node(node);
+                                          }) && ...);
+                  }, nodes);
+    }
+};
+
+// Whether the lexemes and values of the tokens are in range.
+static bool check_tokens(const std::vector<Token>& tokens, size_t source_size,
+                         size_t number_count, size_t string_count) {
+    return std::all_of(tokens.begin(), tokens.end(), [&](const Token& token) {
+        if (token.type > Token_type::END
+            || static_cast<uint64_t>(token.offset) + token.length > source_size)
+            return false;
+
+        switch (token.type) {
+        case Token_type::NUMBER:
+            return token.value < number_count;
+        case Token_type::IDENTIFIER:
+        case Token_type::STRING:
+        case Token_type::THIS:
+        case Token_type::SUPER:
+            return token.value < string_count;
+        default:
+            return true;
+        }
+    });
+}
+
+// Files are stored next to the source, or in the given directory.
+Cache_file::Cache_file(const std::string& source_path, std::string_view source,
+                       const std::string& directory, bool optimized)
+    : source(source),
+      source_hash(hash_bytes(source.data(), source.size())),
+      optimized(optimized) {
+    // Optimized and unoptimized runs keep separate files, rather than
+    // overwriting each other's on every run.
+    const char* suffix = optimized ? ".o.loxc" : ".n.loxc";
+    if (!directory.empty()) {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx",
+                 static_cast<unsigned long long>(source_hash));
+        path = directory + "/" + name + suffix;
+    } else if (source_path.size() > 4
+               && source_path.compare(source_path.size() - 4, 4, ".lox") == 0)
+        path = source_path.substr(0, source_path.size() - 4) + suffix;
+    else
+        path = source_path + suffix;
+}
+
+// Load the cached tokens and AST, returns false on a miss.
+bool Cache_file::load(Heap& heap, Tokens& tokens, Ast& ast, Id_list& statements) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat stat_buf;
+    if (fstat(fd, &stat_buf) < 0 || stat_buf.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void* address = mmap(nullptr, stat_buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED)
+        return false;
+    madvise(address, stat_buf.st_size, MADV_SEQUENTIAL);
+
+    // A damaged file is a miss, it is only read once its checksum matches.
+    const char* bytes = static_cast<const char*>(address);
+    size_t size = stat_buf.st_size;
+    uint64_t checksum = 0;
+    if (size >= sizeof(Cache_header) + sizeof(checksum)) {
+        size -= sizeof(checksum);
+        std::memcpy(&checksum, bytes + size, sizeof(checksum));
+    }
+    if (checksum != hash_bytes(bytes + sizeof(Cache_header),
+                               size - std::min(size, sizeof(Cache_header)))) {
+        munmap(address, stat_buf.st_size);
+        return false;
+    }
+
+    Cache_reader reader(bytes, size);
+    Tokens loaded(source);
+    decltype(ast.nodes) nodes;
+    std::vector<uint32_t> lists;
+
+    Cache_header header = {};
+    bool hit = reader.get(header)
+               && header.magic == CACHE_MAGIC
+               && header.version == CACHE_VERSION
+               && header.layout == layout_hash(nodes)
+               && header.source_hash == source_hash
+               && header.source_size == source.size()
+               && header.optimized == optimized
+               && reader.get_array(loaded.tokens)
+               && reader.get_array(loaded.numbers)
+               && std::apply([&](auto&... arrays) {
+                      return (reader.get_array(arrays) && ...);
+                  }, nodes)
+               && reader.get_array(lists);
+
+    // The strings are only interned once the whole file has been checked,
+    // so that a rejected file leaves nothing behind in the heap. Until then
+    // they are views of the mapping.
+    uint64_t string_count;
+    std::vector<std::string_view> strings;
+    hit = hit && reader.get(string_count);
+    for (uint64_t string = 0; hit && string < string_count; string++) {
+        std::string_view chars;
+        hit = reader.get_chars(chars);
+        if (hit)
+            strings.push_back(chars);
+    }
+
+    Id_list loaded_statements(header.first_statement, header.statement_count);
+    hit = hit
+          && reader.is_at_end()
+          && check_tokens(loaded.tokens, source.size(), loaded.numbers.size(),
+                          strings.size())
+          && Cache_checker<decltype(nodes)>(nodes, lists, loaded.tokens)
+                 .check(loaded_statements);
+    if (!hit) {
+        munmap(address, stat_buf.st_size);
+        return false;
+    }
+
+    loaded.strings.reserve(strings.size());
+    for (std::string_view chars : strings) {
+        String* interned = heap.intern(chars);
+        heap.pin(interned);
+        loaded.strings.push_back(interned);
+    }
+    munmap(address, stat_buf.st_size);
+
+    tokens = std::move(loaded);
+    ast.nodes = std::move(nodes);
+    ast.lists = std::move(lists);
+    statements = loaded_statements;
+    return true;
+}
+
+// Write the tokens and AST of the script.
+void Cache_file::store(const Tokens& tokens, Ast& ast, Id_list statements) {
+    // Runs of the same script may race to write the file, so it is written
+    // under a private name and renamed over the old one in a single step.
+    std::string temporary = path + ".tmp" + std::to_string(getpid());
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (file == nullptr)
+        return;
+
+    Cache_writer writer(file);
+    Cache_header header = {};
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.layout = layout_hash(ast.nodes);
+    header.source_hash = source_hash;
+    header.source_size = source.size();
+    header.optimized = optimized;
+    header.first_statement = statements.get_first();
+    header.statement_count = statements.size();
+    writer.put(header);
+
+    writer.put_array(tokens.tokens);
+    writer.put_array(tokens.numbers);
+    std::apply([&](auto&... arrays) {
+        (writer.put_array(arrays), ...);
+    }, ast.nodes);
+    writer.put_array(ast.lists);
+
+    writer.put<uint64_t>(tokens.strings.size());
+    for (String* string : tokens.strings) {
+        const std::string& chars = string->get_chars();
+        writer.put<uint32_t>(chars.size());
+        writer.put_bytes(chars.data(), chars.size());
+    }
+    writer.put_checksum();
+
+    if (fclose(file) != 0 || writer.has_failed()
+        || rename(temporary.c_str(), path.c_str()) != 0)
+        unlink(temporary.c_str());
+}
@@ -0,0 +1,17 @@
+#include <chrono>
+
+#include "callable.h"
+#include "interpreter.h"
+
+// Invoke a call operator on the native function, the arguments are read in
+// place from the frame.
+Value Native::call(std::shared_ptr<Interpreter> interpreter, size_t frame) {
+    std::vector<Value>& stack = interpreter->stack;
+    return function(stack.size() - frame - 1, stack.data() + frame + 1);
+}
+
+// Native clock() function, returns the number of seconds since the epoch.
+Value clock_native(int arg_count, Value* args) {
+    return Value(static_cast<double>(std::chrono::duration_cast<std::chrono::seconds>(
+                                     std::chrono::system_clock::now().time_since_epoch()).count()));
+}
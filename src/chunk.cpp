@@ -0,0 +1,28 @@
+#include <algorithm>
+
+#include "chunk.h"
+
+// Append a byte produced by the given source token.
+void Chunk::write(uint8_t byte, Token_id token) {
+    if (tokens.empty() || tokens.back().second != token)
+        tokens.emplace_back(code.size(), token);
+    code.push_back(byte);
+}
+
+// Add a value to the constant pool and return its index.
+size_t Chunk::add_constant(Value value) {
+    constants.push_back(value);
+    return constants.size() - 1;
+}
+
+// Get the source token of the instruction at the given offset.
+Token_id Chunk::token_at(size_t offset) const {
+    auto run = std::upper_bound(tokens.begin(), tokens.end(), offset,
+                                [](size_t offset, auto& run) {
+                                    return offset < run.first;
+                                });
+    if (run == tokens.begin())
+        return 0;
+
+    return (--run)->second;
+}
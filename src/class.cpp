@@ -1,33 +1,48 @@
 #include "class.h"
 #include "instance.h"
+#include "function.h"
+#include "interpreter.h"
+#include "heap.h"
 
-Literal Class::call(std::shared_ptr<Interpreter> interpreter,
-                    std::vector<Literal> &arguments) {
-    Literal ret;
-    auto instance = std::make_shared<Instance>(shared_from_this());
+Value Class::call(std::shared_ptr<Interpreter> interpreter, size_t frame) {
+    Profiler::Scope profile(interpreter->get_profiler(), name, line);
 
-    std::shared_ptr<Function> initializer = find_method("init");
+    Heap& heap = interpreter->get_heap();
+    Instance* instance = heap.allocate<Instance>(this);
+
+    // The initializer runs in the frame of the call, with the instance in
+    // place of the class.
     if (initializer != nullptr)
-        initializer->bind(instance)->call(interpreter, arguments);
+        static_cast<Function*>(initializer)->invoke(interpreter, instance, frame);
 
-    ret.value = instance;
-    return ret;
+    return Value(instance);
 }
 
 uint32_t Class::arity() {
-    std::shared_ptr<Function> initializer = find_method("init");
     if (initializer == nullptr)
         return 0;
 
-    return initializer->arity();
+    return static_cast<Function*>(initializer)->arity();
 }
 
-std::shared_ptr<Function> Class::find_method(std::string name) {
-    if (methods.find(name) != methods.end())
-        return methods[name];
+Obj* Class::find_method(String* name) {
+    auto method = methods.find(name);
+    if (method != methods.end())
+        return method->second.as_obj();
 
     if (superclass != nullptr)
         return superclass->find_method(name);
 
     return nullptr;
 }
+
+// Mark the field names of the shapes, the superclass and the methods.
+void Class::trace(Heap& heap) {
+    root_shape.trace(heap);
+    heap.mark_object(superclass);
+    heap.mark_object(initializer);
+    for (auto& method : methods) {
+        heap.mark_object(method.first);
+        heap.mark_value(method.second);
+    }
+}
@@ -0,0 +1,686 @@
+#include <cassert>
+#include <ostream>
+#include <string>
+
+#include "closure_compiler.h"
+#include "interpreter.h"
+#include "class.h"
+#include "instance.h"
+#include "function.h"
+#include "lambda.h"
+
+Closure_compiler::Closure_compiler(Interpreter& interpreter,
+                                   const Tokens& tokens, Ast& ast)
+    : interpreter(interpreter), heap(interpreter.get_heap()), tokens(tokens),
+      ast(ast) {}
+
+// Compile a single expression.
+Expr_code Closure_compiler::compile_expr(Expr_id expr) {
+    ast.accept_expr(expr, *this);
+    return std::move(expr_code);
+}
+
+// Compile a single statement.
+Stmt_code Closure_compiler::compile_stmt(Stmt_id stmt) {
+    ast.accept_stmt(stmt, *this);
+
+    // Statements only poll the profiler and track the line when the script
+    // is compiled for profiling or allocation tracking.
+    Profiler* profiler = interpreter.profiler;
+    Allocation_sites* sites = interpreter.heap.get_allocation_sites();
+    if (profiler == nullptr && sites == nullptr)
+        return std::move(stmt_code);
+
+    uint32_t line = ast.line_of(tokens, stmt);
+    return [profiler, sites, line, code = std::move(stmt_code)]() {
+        if (profiler != nullptr)
+            profiler->poll(line);
+        if (sites != nullptr)
+            sites->set_line(line);
+        return code();
+    };
+}
+
+// Compile a list of statements into a single closure which runs them in
+// order, and stops at a return.
+Stmt_code Closure_compiler::compile_statements(Id_list statements) {
+    std::vector<Stmt_code> code;
+    for (Stmt_id stmt : ast.get_list(statements))
+        code.push_back(compile_stmt(stmt));
+
+    Heap* heap = &this->heap;
+    return [heap, code = std::move(code)]() {
+        for (const Stmt_code& stmt : code) {
+            // Statement boundaries are the collector's safe points.
+            heap->maybe_collect();
+            if (stmt())
+                return true;
+        }
+        return false;
+    };
+}
+
+// Compile a function or lambda body.
+const Compiled_body* Closure_compiler::compile_body(Id_list body) {
+    scope_depth++;
+    Stmt_code code = compile_statements(body);
+    scope_depth--;
+
+    bodies.push_back(Compiled_body{std::move(code)});
+    return &bodies.back();
+}
+
+// Compile a definition of a variable in the current scope.
+Stmt_code Closure_compiler::compile_define(Token_id name, Expr_code value) {
+    Interpreter* in = &interpreter;
+    if (scope_depth == 0) {
+        String* global = tokens.get_string(name);
+        return [in, global, value = std::move(value)]() {
+            in->globals->define_global(global, value());
+            in->heap.resize(in->globals);
+            return false;
+        };
+    }
+
+    return [in, value = std::move(value)]() {
+        in->push_local(value());
+        return false;
+    };
+}
+
+// Compile a read of a resolved variable. The slot of a global never changes
+// once it is defined, so it is looked up by name only until the first
+// successful read.
+Expr_code Closure_compiler::compile_variable(Resolution& resolution,
+                                             Token_id name) {
+    Interpreter* in = &interpreter;
+    uint32_t slot = resolution.get_slot();
+
+    switch (resolution.get_access()) {
+    case Access::LOCAL:
+        return [in, slot]() { return in->stack[in->frame + slot]; };
+    case Access::UPVALUE:
+        return [in, slot]() {
+            return *(*in->upvalues)[slot]->get_location();
+        };
+    default:
+        break;
+    }
+
+    String* global = tokens.get_string(name);
+    return [in, global, name, slot = int64_t(-1)]() mutable {
+        if (slot < 0) {
+            Value value = in->globals->get_global(global, name);
+            slot = in->globals->find_global(global);
+            return value;
+        }
+        return in->globals->get_at(0, slot);
+    };
+}
+
+// Compile a binary operation. Operands which are locals of the frame are
+// read directly from their slots.
+template <typename Apply>
+Expr_code Closure_compiler::compile_binary(Binary_expr& expr, Apply apply) {
+    Interpreter* in = &interpreter;
+    Expr_id left_id = expr.get_left();
+    Expr_id right_id = expr.get_right();
+
+    if (expr_kind(left_id) == Expr_kind::VARIABLE
+        && expr_kind(right_id) == Expr_kind::VARIABLE) {
+        Variable_expr& left = ast.get<Variable_expr>(left_id);
+        Variable_expr& right = ast.get<Variable_expr>(right_id);
+        if (left.get_access() == Access::LOCAL
+            && right.get_access() == Access::LOCAL) {
+            uint32_t left_slot = left.get_slot();
+            uint32_t right_slot = right.get_slot();
+            return [in, apply, left_slot, right_slot]() {
+                return apply(in->stack[in->frame + left_slot],
+                             in->stack[in->frame + right_slot]);
+            };
+        }
+    }
+
+    Expr_code left = compile_expr(left_id);
+    Expr_code right = compile_expr(right_id);
+
+    // Literals and variables don't allocate, so the left operand doesn't
+    // have to be rooted while they are evaluated.
+    if (expr_kind(right_id) == Expr_kind::LITERAL
+        || expr_kind(right_id) == Expr_kind::VARIABLE)
+        return [apply, left = std::move(left), right = std::move(right)]() {
+            Value left_value = left();
+            return apply(left_value, right());
+        };
+
+    return [in, apply, left = std::move(left), right = std::move(right)]() {
+        Value left_value = left();
+        in->push_root(left_value);
+        Value right_value = right();
+        in->pop_roots(1);
+        return apply(left_value, right_value);
+    };
+}
+
+// Overridden visitor methods.
+
+void Closure_compiler::visit_binary_expr(Binary_expr& expr) {
+    Token_id op = expr.get_op();
+
+    // Comparisons and arithmetic other than addition need two numbers.
+#define NUMBER_OP(result)                                                   \
+    compile_binary(expr, [op](Value left, Value right) {                    \
+        if (!left.is_number() || !right.is_number())                        \
+            throw Runtime_error("Operands must be numbers!", op);           \
+        double a = left.as_number();                                        \
+        double b = right.as_number();                                       \
+        return Value(result);                                               \
+    })
+
+    switch (tokens.get_type(op)) {
+    case Token_type::BANG_EQUAL:
+        expr_code = compile_binary(expr, [](Value left, Value right) {
+            return Value(!(left == right));
+        });
+        break;
+    case Token_type::EQUAL_EQUAL:
+        expr_code = compile_binary(expr, [](Value left, Value right) {
+            return Value(left == right);
+        });
+        break;
+    case Token_type::PLUS: {
+        Heap* heap = &this->heap;
+        expr_code = compile_binary(expr, [heap, op](Value left, Value right) {
+            if (left.is_number() && right.is_number())
+                return Value(left.as_number() + right.as_number());
+            if (is_obj_type(left, Obj_type::STRING)
+                && is_obj_type(right, Obj_type::STRING))
+                return Value(heap->intern(static_cast<String*>(left.as_obj())->get_chars()
+                                          + static_cast<String*>(right.as_obj())->get_chars()));
+            throw Runtime_error("Operands must be two numbers or two "
+                                "strings!", op);
+        });
+        break;
+    }
+    case Token_type::GREATER:
+        expr_code = NUMBER_OP(a > b);
+        break;
+    case Token_type::GREATER_EQUAL:
+        expr_code = NUMBER_OP(a >= b);
+        break;
+    case Token_type::LESS:
+        expr_code = NUMBER_OP(a < b);
+        break;
+    case Token_type::LESS_EQUAL:
+        expr_code = NUMBER_OP(a <= b);
+        break;
+    case Token_type::MINUS:
+        expr_code = NUMBER_OP(a - b);
+        break;
+    case Token_type::SLASH:
+        expr_code = NUMBER_OP(a / b);
+        break;
+    case Token_type::STAR:
+        expr_code = NUMBER_OP(a * b);
+        break;
+    // Unreachable.
+    default:
+        assert(false);
+        break;
+    }
+
+#undef NUMBER_OP
+}
+
+void Closure_compiler::visit_unary_expr(Unary_expr& expr) {
+    Token_id op = expr.get_op();
+    Expr_code right = compile_expr(expr.get_right());
+
+    if (tokens.get_type(op) == Token_type::MINUS) {
+        expr_code = [op, right = std::move(right)]() {
+            Value value = right();
+            if (!value.is_number())
+                throw Runtime_error("Operand must be a number!", op);
+            return Value(-value.as_number());
+        };
+    } else {
+        assert(tokens.get_type(op) == Token_type::BANG);
+        expr_code = [right = std::move(right)]() {
+            return Value(!right().is_truthy());
+        };
+    }
+}
+
+void Closure_compiler::visit_grouping_expr(Grouping_expr& expr) {
+    // A grouping doesn't need a closure of its own.
+    expr_code = compile_expr(expr.get_expr());
+}
+
+void Closure_compiler::visit_literal_expr(Literal_expr& expr) {
+    Token_id token = expr.get_literal();
+    Value value;
+
+    switch (tokens.get_type(token)) {
+    case Token_type::NUMBER:
+        value = Value(tokens.get_value(token));
+        break;
+    case Token_type::STRING:
+        // Pinned by the scanner, so the constant stays valid.
+        value = Value(tokens.get_string(token));
+        break;
+    case Token_type::TRUE:
+        value = Value(true);
+        break;
+    case Token_type::FALSE:
+        value = Value(false);
+        break;
+    default:
+        assert(tokens.get_type(token) == Token_type::NIL);
+        break;
+    }
+
+    expr_code = [value]() { return value; };
+}
+
+void Closure_compiler::visit_variable_expr(Variable_expr& expr) {
+    expr_code = compile_variable(expr, expr.get_name());
+}
+
+void Closure_compiler::visit_assign_expr(Assign_expr& expr) {
+    Interpreter* in = &interpreter;
+    Expr_code value = compile_expr(expr.get_value());
+
+    uint32_t slot = expr.get_slot();
+    if (expr.get_access() == Access::LOCAL) {
+        expr_code = [in, slot, value = std::move(value)]() {
+            Value assigned = value();
+            in->stack[in->frame + slot] = assigned;
+            return assigned;
+        };
+        return;
+    }
+    if (expr.get_access() == Access::UPVALUE) {
+        expr_code = [in, slot, value = std::move(value)]() {
+            Value assigned = value();
+            *(*in->upvalues)[slot]->get_location() = assigned;
+            return assigned;
+        };
+        return;
+    }
+
+    Token_id token = expr.get_name();
+    String* name = tokens.get_string(token);
+    expr_code = [in, name, token, slot = int64_t(-1),
+                 value = std::move(value)]() mutable {
+        Value assigned = value();
+        if (slot < 0) {
+            in->globals->assign_global(name, token, assigned);
+            slot = in->globals->find_global(name);
+        } else
+            in->globals->assign_at(0, slot, assigned);
+        return assigned;
+    };
+}
+
+void Closure_compiler::visit_logical_expr(Logical_expr& expr) {
+    Expr_code left = compile_expr(expr.get_left());
+    Expr_code right = compile_expr(expr.get_right());
+
+    if (tokens.get_type(expr.get_op()) == Token_type::OR)
+        expr_code = [left = std::move(left), right = std::move(right)]() {
+            Value value = left();
+            return value.is_truthy() ? value : right();
+        };
+    else
+        expr_code = [left = std::move(left), right = std::move(right)]() {
+            Value value = left();
+            return !value.is_truthy() ? value : right();
+        };
+}
+
+void Closure_compiler::visit_call_expr(Call_expr& expr) {
+    Interpreter* in = &interpreter;
+    Token_id paren = expr.get_paren();
+
+    std::vector<Expr_code> arguments;
+    for (Expr_id argument : ast.get_list(expr.get_arguments()))
+        arguments.push_back(compile_expr(argument));
+
+    // Push the callee's slot and evaluate the arguments straight into the
+    // frame of the call after it, returns where the frame starts.
+    auto push_frame = [in](Value callee, const std::vector<Expr_code>& code) {
+        size_t frame = in->stack.size();
+        in->push_local(callee);
+        for (const Expr_code& argument : code)
+            in->push_local(argument());
+        return frame;
+    };
+
+    if (!expr.is_invoke()) {
+        Expr_code callee = compile_expr(expr.get_callee());
+        expr_code = [in, paren, push_frame,
+                     callee = std::move(callee),
+                     arguments = std::move(arguments)]() {
+            Value value = callee();
+            Callable* function = in->get_callable(value, paren);
+            size_t frame = push_frame(value, arguments);
+            return in->call(function, nullptr, frame, paren);
+        };
+        return;
+    }
+
+    // A method called through a property access is invoked on the instance
+    // directly, without allocating a bound method.
+    Get_expr& property = ast.get<Get_expr>(expr.get_callee());
+    Expr_code object = compile_expr(property.get_object());
+    expr_code = [in, paren, push_frame, &property,
+                 object = std::move(object),
+                 arguments = std::move(arguments)]() {
+        Value value = object();
+        if (!is_obj_type(value, Obj_type::INSTANCE))
+            throw Runtime_error("Only instances have properties!",
+                                property.get_name());
+
+        Instance* receiver = static_cast<Instance*>(value.as_obj());
+        Function* method = in->look_up_property(receiver, property);
+        Callable* function = method;
+        if (method == nullptr) {
+            // A field, its value was left in the result register.
+            value = in->result;
+            function = in->get_callable(value, paren);
+            receiver = nullptr;
+        }
+
+        size_t frame = push_frame(value, arguments);
+        return in->call(function, receiver, frame, paren);
+    };
+}
+
+void Closure_compiler::visit_lambda_expr(Lambda_expr& expr) {
+    Interpreter* in = &interpreter;
+    const Compiled_body* body = compile_body(expr.get_body());
+    Lambda_expr declaration = expr;
+    Id_list captures = expr.get_captures();
+
+    expr_code = [in, body, declaration, captures]() {
+        Lambda* lambda = in->heap.allocate<Lambda>(declaration,
+                                                   in->capture(captures));
+        lambda->set_code(body);
+        return Value(lambda);
+    };
+}
+
+void Closure_compiler::visit_get_expr(Get_expr& expr) {
+    Interpreter* in = &interpreter;
+    Expr_code object = compile_expr(expr.get_object());
+
+    expr_code = [in, &expr, object = std::move(object)]() {
+        Value value = object();
+        if (!is_obj_type(value, Obj_type::INSTANCE))
+            throw Runtime_error("Only instances have properties!",
+                                expr.get_name());
+
+        Instance* instance = static_cast<Instance*>(value.as_obj());
+        Function* method = in->look_up_property(instance, expr);
+        if (method != nullptr)
+            return Value(method->bind(in->heap, instance));
+        return in->result;
+    };
+}
+
+void Closure_compiler::visit_set_expr(Set_expr& expr) {
+    Interpreter* in = &interpreter;
+    Expr_code object = compile_expr(expr.get_object());
+    Expr_code value = compile_expr(expr.get_value());
+
+    expr_code = [in, &expr, object = std::move(object),
+                 value = std::move(value)]() {
+        Value instance = object();
+        Instance* target = in->get_instance(instance, expr.get_name());
+        in->push_root(instance);
+        Value assigned = value();
+        in->pop_roots(1);
+
+        in->set_property(target, expr, assigned);
+        return assigned;
+    };
+}
+
+void Closure_compiler::visit_this_expr(This_expr& expr) {
+    expr_code = compile_variable(expr, expr.get_keyword());
+}
+
+void Closure_compiler::visit_super_expr(Super_expr& expr) {
+    Interpreter* in = &interpreter;
+    Expr_code superclass = compile_variable(expr, expr.get_keyword());
+    Expr_code receiver = compile_variable(expr.get_receiver(),
+                                          expr.get_keyword());
+    Token_id method = expr.get_method();
+    String* name = tokens.get_string(method);
+
+    expr_code = [in, method, name, superclass = std::move(superclass),
+                 receiver = std::move(receiver)]() {
+        Class* klass = static_cast<Class*>(superclass().as_obj());
+        Instance* object = static_cast<Instance*>(receiver().as_obj());
+
+        Obj* found = klass->find_method(name);
+        if (found == nullptr)
+            throw Runtime_error("Undefined property '" + name->get_chars()
+                                + "'!", method);
+
+        return Value(static_cast<Function*>(found)->bind(in->heap, object));
+    };
+}
+
+void Closure_compiler::visit_expression_stmt(Expression_stmt& stmt) {
+    Expr_code expr = compile_expr(stmt.get_expr());
+    stmt_code = [expr = std::move(expr)]() {
+        expr();
+        return false;
+    };
+}
+
+void Closure_compiler::visit_print_stmt(Print_stmt& stmt) {
+    Expr_code expr = compile_expr(stmt.get_expr());
+    std::ostream& out = interpreter.out;
+    stmt_code = [&out, expr = std::move(expr)]() {
+        out << expr() << std::endl;
+        return false;
+    };
+}
+
+void Closure_compiler::visit_var_stmt(Var_stmt& stmt) {
+    Expr_code value;
+    if (stmt.get_initializer() != NO_NODE)
+        value = compile_expr(stmt.get_initializer());
+    else
+        value = []() { return Value(); };
+
+    stmt_code = compile_define(stmt.get_name(), std::move(value));
+}
+
+void Closure_compiler::visit_block_stmt(Block_stmt& stmt) {
+    Interpreter* in = &interpreter;
+
+    scope_depth++;
+    Stmt_code statements = compile_statements(stmt.get_statements());
+    scope_depth--;
+
+    // The variables of the block are popped when it's left.
+    bool captured = stmt.get_captured();
+    stmt_code = [in, captured, statements = std::move(statements)]() {
+        size_t first = in->stack.size();
+        bool returned = statements();
+        in->pop_locals(first, captured);
+        return returned;
+    };
+}
+
+void Closure_compiler::visit_if_stmt(If_stmt& stmt) {
+    Expr_code condition = compile_expr(stmt.get_condition());
+    Stmt_code then_branch = compile_stmt(stmt.get_then_branch());
+
+    if (stmt.get_else_branch() == NO_NODE) {
+        stmt_code = [condition = std::move(condition),
+                     then_branch = std::move(then_branch)]() {
+            if (condition().is_truthy())
+                return then_branch();
+            return false;
+        };
+        return;
+    }
+
+    Stmt_code else_branch = compile_stmt(stmt.get_else_branch());
+    stmt_code = [condition = std::move(condition),
+                 then_branch = std::move(then_branch),
+                 else_branch = std::move(else_branch)]() {
+        if (condition().is_truthy())
+            return then_branch();
+        return else_branch();
+    };
+}
+
+void Closure_compiler::visit_while_stmt(While_stmt& stmt) {
+    Heap* heap = &this->heap;
+    Expr_code condition = compile_expr(stmt.get_condition());
+    Stmt_code body = compile_stmt(stmt.get_body());
+
+    stmt_code = [heap, condition = std::move(condition),
+                 body = std::move(body)]() {
+        while (condition().is_truthy()) {
+            // The loop body is a safe point even if it isn't a block.
+            heap->maybe_collect();
+            if (body())
+                return true;
+        }
+        return false;
+    };
+}
+
+void Closure_compiler::visit_function_stmt(Function_stmt& stmt) {
+    Interpreter* in = &interpreter;
+    String* name = tokens.get_string(stmt.get_name());
+    const Compiled_body* body = compile_body(stmt.get_body());
+    Function_stmt declaration = stmt;
+
+    Id_list captures = stmt.get_captures();
+
+    auto create = [in, name, body, declaration, captures]() {
+        Function* function = in->heap.allocate<Function>(
+                declaration, name, in->capture(captures), false);
+        function->set_code(body);
+        return Value(function);
+    };
+    if (scope_depth == 0) {
+        stmt_code = compile_define(stmt.get_name(), std::move(create));
+        return;
+    }
+
+    // A local function may capture itself, so its slot is defined before
+    // the function is created.
+    stmt_code = [in, create = std::move(create)]() {
+        size_t slot = in->stack.size();
+        in->push_local(Value());
+        Value function = create();
+        in->stack[slot] = function;
+        return false;
+    };
+}
+
+void Closure_compiler::visit_return_stmt(Return_stmt& stmt) {
+    Interpreter* in = &interpreter;
+
+    if (stmt.get_value() == NO_NODE) {
+        stmt_code = [in]() {
+            in->result = Value();
+            return true;
+        };
+        return;
+    }
+
+    Expr_code value = compile_expr(stmt.get_value());
+    stmt_code = [in, value = std::move(value)]() {
+        in->result = value();
+        return true;
+    };
+}
+
+void Closure_compiler::visit_class_stmt(Class_stmt& stmt) {
+    Interpreter* in = &interpreter;
+
+    // Methods of the class, compiled once.
+    struct Method {
+        Function_stmt declaration;
+        String* name;
+        const Compiled_body* body;
+        Id_list captures;
+    };
+    std::vector<Method> methods;
+    for (Stmt_id id : ast.get_list(stmt.get_methods())) {
+        Function_stmt& method = ast.get<Function_stmt>(id);
+        methods.push_back(Method{method, tokens.get_string(method.get_name()),
+                                 compile_body(method.get_body()),
+                                 method.get_captures()});
+    }
+
+    Expr_code superclass;
+    Token_id superclass_name = 0;
+    if (stmt.get_superclass() != NO_NODE) {
+        superclass = compile_expr(stmt.get_superclass());
+        superclass_name = ast.get<Variable_expr>(stmt.get_superclass()).get_name();
+    }
+
+    String* name = tokens.get_string(stmt.get_name());
+    uint32_t line = tokens.get_line(stmt.get_name());
+    bool is_global = scope_depth == 0;
+
+    stmt_code = [in, name, line, methods, superclass_name, is_global,
+                 superclass = std::move(superclass)]() {
+        Class* parent = nullptr;
+        if (superclass)
+            parent = in->get_superclass(superclass(), superclass_name);
+
+        // The class is defined as nil first, and assigned once its methods
+        // are created.
+        size_t slot = is_global ? in->globals->define_global(name, Value())
+                                : in->stack.size();
+        if (is_global)
+            in->heap.resize(in->globals);
+        else
+            in->push_local(Value());
+
+        // The superclass is a local which the methods capture as "super".
+        size_t super_slot = in->stack.size();
+        if (parent != nullptr)
+            in->push_local(Value(parent));
+
+        Class::method_map functions;
+        for (const Method& method : methods) {
+            Function* function = in->heap.allocate<Function>(
+                    method.declaration, method.name,
+                    in->capture(method.captures),
+                    method.name == in->heap.get_init_string());
+            function->set_code(method.body);
+            functions[method.name] = Value(function);
+        }
+
+        Class* klass = in->heap.allocate<Class>(name->get_chars(), line,
+                                                parent, functions);
+        klass->set_initializer(klass->find_method(in->heap.get_init_string()));
+
+        if (parent != nullptr)
+            in->pop_locals(super_slot, true);
+
+        if (is_global)
+            in->globals->assign_at(0, slot, Value(klass));
+        else
+            in->stack[slot] = Value(klass);
+        return false;
+    };
+}
+
+// Compile the top level statements of the script.
+const Compiled_body& Closure_compiler::compile_script(Id_list statements) {
+    bodies.push_back(Compiled_body{compile_statements(statements)});
+    return bodies.back();
+}
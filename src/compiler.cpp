@@ -0,0 +1,679 @@
+#include <cstring>
+#include <cassert>
+
+#include "compiler.h"
+#include "heap.h"
+#include "error_handling.h"
+
+// Compile a single statement.
+void Compiler::compile_stmt(Stmt_id stmt) {
+    ast.accept_stmt(stmt, *this);
+}
+
+// Compile a single expression.
+void Compiler::compile_expr(Expr_id expr) {
+    ast.accept_expr(expr, *this);
+}
+
+// Compile a list of statements.
+void Compiler::compile(Id_list statements) {
+    for (Stmt_id stmt : ast.get_list(statements))
+        compile_stmt(stmt);
+}
+
+// Report an error at the given token and throw an exception.
+Compiler::Compile_error Compiler::error(Token_id token, std::string msg) {
+    errors.error(tokens, token, msg);
+    return Compile_error();
+}
+
+// Change of the stack depth caused by an instruction. CALL also pops its
+// arguments, which the call site accounts for.
+static int stack_effect(Op_code op) {
+    switch (op) {
+    case Op_code::CONSTANT:
+    case Op_code::NIL:
+    case Op_code::TRUE:
+    case Op_code::FALSE:
+    case Op_code::GET_LOCAL:
+    case Op_code::GET_GLOBAL:
+    case Op_code::GET_UPVALUE:
+    case Op_code::CLOSURE:
+    case Op_code::CLASS:
+        return 1;
+    case Op_code::POP:
+    case Op_code::DEFINE_GLOBAL:
+    case Op_code::SET_PROPERTY:
+    case Op_code::GET_SUPER:
+    case Op_code::EQUAL:
+    case Op_code::GREATER:
+    case Op_code::GREATER_EQUAL:
+    case Op_code::LESS:
+    case Op_code::LESS_EQUAL:
+    case Op_code::ADD:
+    case Op_code::SUBTRACT:
+    case Op_code::MULTIPLY:
+    case Op_code::DIVIDE:
+    case Op_code::PRINT:
+    case Op_code::CLOSE_UPVALUE:
+    case Op_code::RETURN:
+    case Op_code::INHERIT:
+    case Op_code::METHOD:
+        return -1;
+    default:
+        return 0;
+    }
+}
+
+// Account for the values an instruction pushes (or pops).
+void Compiler::adjust_stack(int effect) {
+    current->stack_depth += effect;
+    if (current->stack_depth > current->max_stack)
+        current->max_stack = current->stack_depth;
+}
+
+void Compiler::emit_op(Op_code op) {
+    emit_byte(static_cast<uint8_t>(op));
+    adjust_stack(stack_effect(op));
+}
+
+void Compiler::emit_short(uint16_t value) {
+    emit_byte(static_cast<uint8_t>(value >> 8));
+    emit_byte(static_cast<uint8_t>(value & 0xff));
+}
+
+void Compiler::emit_op(Op_code op, uint8_t operand) {
+    emit_op(op);
+    emit_byte(operand);
+}
+
+void Compiler::emit_op_short(Op_code op, uint16_t operand) {
+    emit_op(op);
+    emit_short(operand);
+}
+
+// Emit the LONG prefixes carrying the high bits of the next operand, most
+// significant byte first.
+void Compiler::emit_long(uint32_t high) {
+    if (high == 0)
+        return;
+
+    emit_long(high >> 8);
+    emit_op(Op_code::LONG, static_cast<uint8_t>(high & 0xff));
+}
+
+// Emit an instruction taking a constant index, prefixed by LONG if the
+// index does not fit in its u16 operand.
+void Compiler::emit_op_constant(Op_code op, uint32_t constant) {
+    emit_long(constant >> 16);
+    emit_op_short(op, static_cast<uint16_t>(constant & 0xffff));
+}
+
+// Emit an instruction taking a stack slot or upvalue index, prefixed by
+// LONG if the index does not fit in its u8 operand.
+void Compiler::emit_op_slot(Op_code op, uint32_t slot) {
+    emit_long(slot >> 8);
+    emit_op(op, static_cast<uint8_t>(slot & 0xff));
+}
+
+// Emit a forward jump and return the offset of its operand. The length of
+// the jump isn't known yet, so with long jumps the two LONG prefixes of a
+// 32-bit offset are always emitted.
+size_t Compiler::emit_jump(Op_code op) {
+    if (long_jumps) {
+        emit_op(Op_code::LONG, 0xff);
+        emit_op(Op_code::LONG, 0xff);
+    }
+    emit_op_short(op, 0xffff);
+    return chunk().get_code().size() - 2;
+}
+
+// Point the forward jump at the current end of the chunk.
+void Compiler::patch_jump(size_t offset) {
+    size_t jump = chunk().get_code().size() - offset - 2;
+    std::vector<uint8_t>& code = chunk().get_code();
+    if (long_jumps) {
+        if (jump > UINT32_MAX)
+            throw error(chunk().token_at(offset), "Too much code to jump over!");
+        code[offset - 4] = static_cast<uint8_t>(jump >> 24);
+        code[offset - 2] = static_cast<uint8_t>((jump >> 16) & 0xff);
+    } else if (jump > UINT16_MAX)
+        throw Jump_overflow();
+
+    code[offset] = static_cast<uint8_t>((jump >> 8) & 0xff);
+    code[offset + 1] = static_cast<uint8_t>(jump & 0xff);
+}
+
+// Emit a backward jump to the loop start. The offset counts the LONG
+// prefixes too: each makes the jump two bytes longer and its offset eight
+// bits wider.
+void Compiler::emit_loop(size_t loop_start) {
+    size_t offset = chunk().get_code().size() - loop_start + 3;
+    for (size_t prefixes = 0; offset >> (16 + 8 * prefixes) != 0; prefixes++)
+        offset += 2;
+    if (offset > UINT32_MAX)
+        throw error(chunk().token_at(loop_start), "Loop body too large!");
+
+    emit_long(static_cast<uint32_t>(offset >> 16));
+    emit_op_short(Op_code::LOOP, static_cast<uint16_t>(offset & 0xffff));
+}
+
+// Emit the implicit return at the end of a function body.
+void Compiler::emit_return() {
+    if (current->type == Function_type::INITIALIZER)
+        emit_op(Op_code::GET_LOCAL, 0);
+    else
+        emit_op(Op_code::NIL);
+
+    emit_op(Op_code::RETURN);
+}
+
+// Add a value to the constant pool of the current chunk.
+uint32_t Compiler::make_constant(Value value, Token_id token) {
+    size_t constant = chunk().add_constant(value);
+    if (constant > MAX_CONSTANTS)
+        throw error(token, "Too many constants in one chunk!");
+
+    return static_cast<uint32_t>(constant);
+}
+
+uint32_t Compiler::number_constant(double number, Token_id token) {
+    // Key on the bit pattern, so that 0 and -0 stay distinct.
+    uint64_t bits;
+    std::memcpy(&bits, &number, sizeof(bits));
+
+    auto constant = current->number_constants.find(bits);
+    if (constant != current->number_constants.end())
+        return constant->second;
+
+    uint32_t index = make_constant(Value(number), token);
+    current->number_constants[bits] = index;
+    return index;
+}
+
+uint32_t Compiler::string_constant(std::string_view chars, Token_id token) {
+    String* string = heap.intern(chars);
+
+    auto constant = current->string_constants.find(string);
+    if (constant != current->string_constants.end())
+        return constant->second;
+
+    uint32_t index = make_constant(Value(string), token);
+    current->string_constants[string] = index;
+    return index;
+}
+
+void Compiler::end_scope() {
+    current->scope_depth--;
+
+    std::vector<Local>& locals = current->locals;
+    while (!locals.empty() && locals.back().depth > current->scope_depth) {
+        if (locals.back().is_captured)
+            emit_op(Op_code::CLOSE_UPVALUE);
+        else
+            emit_op(Op_code::POP);
+        locals.pop_back();
+    }
+}
+
+// Declare a local variable in the current scope.
+void Compiler::add_local(std::string_view name, Token_id token) {
+    if (current->locals.size() > MAX_LOCALS)
+        throw error(token, "Too many local variables in function!");
+
+    current->locals.push_back(Local{name, current->scope_depth, false});
+}
+
+// Find the stack slot of a local variable, or -1.
+int Compiler::resolve_local(Function_state* state, std::string_view name) {
+    for (int i = state->locals.size() - 1; i >= 0; i--) {
+        if (state->locals[i].name == name)
+            return i;
+    }
+
+    return -1;
+}
+
+// Find the upvalue index of a captured variable, or -1.
+int Compiler::resolve_upvalue(Function_state* state, std::string_view name,
+                              Token_id token) {
+    if (state->enclosing == nullptr)
+        return -1;
+
+    int local = resolve_local(state->enclosing, name);
+    if (local != -1) {
+        state->enclosing->locals[local].is_captured = true;
+        return add_upvalue(state, static_cast<uint16_t>(local), true, token);
+    }
+
+    int upvalue = resolve_upvalue(state->enclosing, name, token);
+    if (upvalue != -1)
+        return add_upvalue(state, static_cast<uint16_t>(upvalue), false, token);
+
+    return -1;
+}
+
+int Compiler::add_upvalue(Function_state* state, uint16_t index, bool is_local,
+                          Token_id token) {
+    for (size_t i = 0; i < state->upvalues.size(); i++) {
+        if (state->upvalues[i].index == index
+            && state->upvalues[i].is_local == is_local)
+            return i;
+    }
+
+    if (state->upvalues.size() > MAX_LOCALS)
+        throw error(token, "Too many closure variables in function!");
+
+    state->upvalues.push_back(Upvalue_ref{index, is_local});
+    return state->upvalues.size() - 1;
+}
+
+// Emit a read of the named variable.
+void Compiler::get_variable(std::string_view name, Token_id token) {
+    int arg = resolve_local(current, name);
+    if (arg != -1) {
+        emit_op_slot(Op_code::GET_LOCAL, arg);
+        return;
+    }
+
+    arg = resolve_upvalue(current, name, token);
+    if (arg != -1) {
+        emit_op_slot(Op_code::GET_UPVALUE, arg);
+        return;
+    }
+
+    emit_op_constant(Op_code::GET_GLOBAL, string_constant(name, token));
+}
+
+// Emit a write of the value on top of the stack to the named variable.
+void Compiler::set_variable(std::string_view name, Token_id token) {
+    int arg = resolve_local(current, name);
+    if (arg != -1) {
+        emit_op_slot(Op_code::SET_LOCAL, arg);
+        return;
+    }
+
+    arg = resolve_upvalue(current, name, token);
+    if (arg != -1) {
+        emit_op_slot(Op_code::SET_UPVALUE, arg);
+        return;
+    }
+
+    emit_op_constant(Op_code::SET_GLOBAL, string_constant(name, token));
+}
+
+// Bind the value on top of the stack to a freshly declared variable.
+void Compiler::define_variable(std::string_view name, Token_id token) {
+    if (current->scope_depth > 0) {
+        // The value already sits in the new local's stack slot.
+        add_local(name, token);
+        return;
+    }
+
+    emit_op_constant(Op_code::DEFINE_GLOBAL, string_constant(name, token));
+}
+
+// Compile a function body and emit the closure creating it.
+void Compiler::function(String* name,
+                        Token_id where,
+                        Id_list params,
+                        Id_list body,
+                        Function_type type) {
+    Function_state state;
+    state.enclosing = current;
+    state.function = heap.allocate<Prototype>(name);
+    state.type = type;
+    current = &state;
+
+    // Slot zero holds the receiver in methods and the callee otherwise.
+    if (type == Function_type::METHOD || type == Function_type::INITIALIZER)
+        add_local("this", where);
+    else
+        add_local("", where);
+
+    begin_scope();
+    for (Token_id param : ast.get_list(params)) {
+        token = param;
+        add_local(tokens.get_lexeme(param), param);
+    }
+    state.function->set_arity(params.size());
+    // The callee (or receiver) and the arguments are already on the stack.
+    state.stack_depth = state.max_stack = state.locals.size();
+
+    compile(body);
+    emit_return();
+    state.function->set_max_stack(state.max_stack);
+    heap.resize(state.function);
+
+    current = state.enclosing;
+
+    Prototype* function = state.function;
+    function->set_upvalue_count(state.upvalues.size());
+
+    token = where;
+    emit_op_constant(Op_code::CLOSURE, make_constant(Value(function), where));
+    for (auto& upvalue : state.upvalues) {
+        emit_byte(upvalue.is_local ? 1 : 0);
+        emit_short(upvalue.index);
+    }
+}
+
+// Overridden visitor methods.
+
+void Compiler::visit_binary_expr(Binary_expr& expr) {
+    compile_expr(expr.get_left());
+    compile_expr(expr.get_right());
+
+    token = expr.get_op();
+    switch (tokens.get_type(expr.get_op())) {
+    case Token_type::BANG_EQUAL:
+        emit_op(Op_code::EQUAL);
+        emit_op(Op_code::NOT);
+        break;
+    case Token_type::EQUAL_EQUAL: emit_op(Op_code::EQUAL); break;
+    case Token_type::GREATER: emit_op(Op_code::GREATER); break;
+    case Token_type::GREATER_EQUAL: emit_op(Op_code::GREATER_EQUAL); break;
+    case Token_type::LESS: emit_op(Op_code::LESS); break;
+    case Token_type::LESS_EQUAL: emit_op(Op_code::LESS_EQUAL); break;
+    case Token_type::PLUS: emit_op(Op_code::ADD); break;
+    case Token_type::MINUS: emit_op(Op_code::SUBTRACT); break;
+    case Token_type::STAR: emit_op(Op_code::MULTIPLY); break;
+    case Token_type::SLASH: emit_op(Op_code::DIVIDE); break;
+    // Unreachable.
+    default:
+        assert(false);
+        break;
+    }
+}
+
+void Compiler::visit_unary_expr(Unary_expr& expr) {
+    compile_expr(expr.get_right());
+
+    token = expr.get_op();
+    if (tokens.get_type(expr.get_op()) == Token_type::MINUS)
+        emit_op(Op_code::NEGATE);
+    else
+        emit_op(Op_code::NOT);
+}
+
+void Compiler::visit_grouping_expr(Grouping_expr& expr) {
+    compile_expr(expr.get_expr());
+}
+
+void Compiler::visit_literal_expr(Literal_expr& expr) {
+    token = expr.get_literal();
+    switch (tokens.get_type(token)) {
+    case Token_type::NIL: emit_op(Op_code::NIL); break;
+    case Token_type::TRUE: emit_op(Op_code::TRUE); break;
+    case Token_type::FALSE: emit_op(Op_code::FALSE); break;
+    case Token_type::NUMBER:
+        emit_op_constant(Op_code::CONSTANT,
+                         number_constant(tokens.get_value(token), token));
+        break;
+    case Token_type::STRING:
+        emit_op_constant(Op_code::CONSTANT,
+                         string_constant(tokens.get_string(token)->get_chars(), token));
+        break;
+    // Unreachable.
+    default:
+        assert(false);
+        break;
+    }
+}
+
+void Compiler::visit_variable_expr(Variable_expr& expr) {
+    token = expr.get_name();
+    get_variable(tokens.get_lexeme(token), token);
+}
+
+void Compiler::visit_assign_expr(Assign_expr& expr) {
+    compile_expr(expr.get_value());
+
+    token = expr.get_name();
+    set_variable(tokens.get_lexeme(token), token);
+}
+
+void Compiler::visit_logical_expr(Logical_expr& expr) {
+    compile_expr(expr.get_left());
+
+    token = expr.get_op();
+    if (tokens.get_type(expr.get_op()) == Token_type::OR) {
+        size_t else_jump = emit_jump(Op_code::JUMP_IF_FALSE);
+        size_t end_jump = emit_jump(Op_code::JUMP);
+        patch_jump(else_jump);
+        emit_op(Op_code::POP);
+        compile_expr(expr.get_right());
+        patch_jump(end_jump);
+    } else {
+        size_t end_jump = emit_jump(Op_code::JUMP_IF_FALSE);
+        emit_op(Op_code::POP);
+        compile_expr(expr.get_right());
+        patch_jump(end_jump);
+    }
+}
+
+void Compiler::visit_call_expr(Call_expr& expr) {
+    compile_expr(expr.get_callee());
+    for (Expr_id argument : ast.get_list(expr.get_arguments()))
+        compile_expr(argument);
+
+    token = expr.get_paren();
+    emit_op(Op_code::CALL, static_cast<uint8_t>(expr.get_arguments().size()));
+    adjust_stack(-static_cast<int>(expr.get_arguments().size()));
+}
+
+void Compiler::visit_lambda_expr(Lambda_expr& expr) {
+    function(nullptr, expr.get_keyword(), expr.get_params(), expr.get_body(),
+             Function_type::LAMBDA);
+}
+
+void Compiler::visit_get_expr(Get_expr& expr) {
+    compile_expr(expr.get_object());
+
+    token = expr.get_name();
+    emit_op_constant(Op_code::GET_PROPERTY,
+                     string_constant(tokens.get_lexeme(token), token));
+}
+
+void Compiler::visit_set_expr(Set_expr& expr) {
+    compile_expr(expr.get_object());
+    compile_expr(expr.get_value());
+
+    token = expr.get_name();
+    emit_op_constant(Op_code::SET_PROPERTY,
+                     string_constant(tokens.get_lexeme(token), token));
+}
+
+void Compiler::visit_this_expr(This_expr& expr) {
+    token = expr.get_keyword();
+    get_variable("this", token);
+}
+
+void Compiler::visit_super_expr(Super_expr& expr) {
+    token = expr.get_keyword();
+    // Outside of a class "super" can only be an undefined global. Read just
+    // that, so that the error names it like the other engines do, not the
+    // receiver.
+    if (current_class == nullptr) {
+        get_variable("super", token);
+        return;
+    }
+
+    get_variable("this", token);
+    get_variable("super", token);
+
+    token = expr.get_method();
+    emit_op_constant(Op_code::GET_SUPER,
+                     string_constant(tokens.get_lexeme(token), token));
+}
+
+void Compiler::visit_expression_stmt(Expression_stmt& stmt) {
+    compile_expr(stmt.get_expr());
+    emit_op(Op_code::POP);
+}
+
+void Compiler::visit_print_stmt(Print_stmt& stmt) {
+    compile_expr(stmt.get_expr());
+    emit_op(Op_code::PRINT);
+}
+
+void Compiler::visit_var_stmt(Var_stmt& stmt) {
+    if (stmt.get_initializer() != NO_NODE)
+        compile_expr(stmt.get_initializer());
+    else
+        emit_op(Op_code::NIL);
+
+    token = stmt.get_name();
+    define_variable(tokens.get_lexeme(token), token);
+}
+
+void Compiler::visit_block_stmt(Block_stmt& stmt) {
+    begin_scope();
+    compile(stmt.get_statements());
+    end_scope();
+}
+
+void Compiler::visit_if_stmt(If_stmt& stmt) {
+    compile_expr(stmt.get_condition());
+
+    size_t then_jump = emit_jump(Op_code::JUMP_IF_FALSE);
+    // The else branch starts with the condition still on the stack.
+    uint32_t depth = current->stack_depth;
+    emit_op(Op_code::POP);
+    compile_stmt(stmt.get_then_branch());
+
+    size_t else_jump = emit_jump(Op_code::JUMP);
+    patch_jump(then_jump);
+    current->stack_depth = depth;
+    emit_op(Op_code::POP);
+    if (stmt.get_else_branch() != NO_NODE)
+        compile_stmt(stmt.get_else_branch());
+    patch_jump(else_jump);
+}
+
+void Compiler::visit_while_stmt(While_stmt& stmt) {
+    size_t loop_start = chunk().get_code().size();
+    compile_expr(stmt.get_condition());
+
+    size_t exit_jump = emit_jump(Op_code::JUMP_IF_FALSE);
+    // The loop exits with the condition still on the stack.
+    uint32_t depth = current->stack_depth;
+    emit_op(Op_code::POP);
+    compile_stmt(stmt.get_body());
+    emit_loop(loop_start);
+
+    patch_jump(exit_jump);
+    current->stack_depth = depth;
+    emit_op(Op_code::POP);
+}
+
+void Compiler::visit_function_stmt(Function_stmt& stmt) {
+    token = stmt.get_name();
+    // A local function is visible in its own body, so declare it first.
+    if (current->scope_depth > 0)
+        add_local(tokens.get_lexeme(stmt.get_name()), stmt.get_name());
+
+    function(tokens.get_string(stmt.get_name()), stmt.get_name(),
+             stmt.get_params(), stmt.get_body(), Function_type::FUNCTION);
+
+    token = stmt.get_name();
+    if (current->scope_depth == 0)
+        define_variable(tokens.get_lexeme(stmt.get_name()), stmt.get_name());
+}
+
+void Compiler::visit_return_stmt(Return_stmt& stmt) {
+    if (stmt.get_value() != NO_NODE && current->type != Function_type::INITIALIZER)
+        compile_expr(stmt.get_value());
+    else if (current->type == Function_type::INITIALIZER)
+        emit_op(Op_code::GET_LOCAL, 0);
+    else
+        emit_op(Op_code::NIL);
+
+    token = stmt.get_keyword();
+    emit_op(Op_code::RETURN);
+}
+
+void Compiler::visit_class_stmt(Class_stmt& stmt) {
+    std::string_view name = tokens.get_lexeme(stmt.get_name());
+
+    token = stmt.get_name();
+    emit_op_constant(Op_code::CLASS, string_constant(name, token));
+    define_variable(name, token);
+
+    Class_state class_state{current_class, false};
+    current_class = &class_state;
+
+    if (stmt.get_superclass() != NO_NODE) {
+        compile_expr(stmt.get_superclass());
+
+        // The superclass is kept in a local, so that methods can capture
+        // it for super calls.
+        begin_scope();
+        add_local("super", stmt.get_name());
+
+        token = stmt.get_name();
+        get_variable(name, token);
+        token = ast.get<Variable_expr>(stmt.get_superclass()).get_name();
+        emit_op(Op_code::INHERIT);
+        class_state.has_superclass = true;
+    }
+
+    token = stmt.get_name();
+    get_variable(name, token);
+    for (Stmt_id id : ast.get_list(stmt.get_methods())) {
+        Function_stmt& method = ast.get<Function_stmt>(id);
+        Function_type type = tokens.get_lexeme(method.get_name()) == "init"
+                             ? Function_type::INITIALIZER
+                             : Function_type::METHOD;
+        function(tokens.get_string(method.get_name()), method.get_name(),
+                 method.get_params(), method.get_body(), type);
+
+        token = method.get_name();
+        emit_op_constant(Op_code::METHOD,
+                         string_constant(tokens.get_lexeme(token), token));
+    }
+    emit_op(Op_code::POP);
+
+    if (class_state.has_superclass)
+        end_scope();
+
+    current_class = class_state.enclosing;
+}
+
+// Compile the program into a new top-level script function.
+Prototype* Compiler::script(Id_list statements) {
+    Function_state state;
+    state.enclosing = nullptr;
+    state.function = heap.allocate<Prototype>(nullptr);
+    state.type = Function_type::SCRIPT;
+    current = &state;
+    current_class = nullptr;
+
+    try {
+        add_local("", 0);
+        state.stack_depth = state.max_stack = 1;
+        compile(statements);
+        emit_return();
+        state.function->set_max_stack(state.max_stack);
+        heap.resize(state.function);
+    } catch (Compile_error&) {
+        current = nullptr;
+        return nullptr;
+    }
+
+    current = nullptr;
+    return state.function;
+}
+
+// Compile the program into the top-level script function. Forward jumps
+// are emitted before the length of the code they skip is known, so a
+// script with a jump too long for the u16 operand is compiled again with
+// every forward jump extended by LONG prefixes.
+Prototype* Compiler::compile_script(Id_list statements) {
+    try {
+        return script(statements);
+    } catch (Jump_overflow&) {
+        long_jumps = true;
+        return script(statements);
+    }
+}
@@ -1,52 +1,52 @@
 #include "environment.h"
+#include "heap.h"
+
+// Define (or redefine) a global variable, returns its slot.
+uint32_t Environment::define_global(String* name, Value value) {
+    auto slot = global_slots.find(name);
+    if (slot != global_slots.end()) {
+        values[slot->second] = value;
+        return slot->second;
+    }
 
-// Get the value of an existing variable.
-Literal Environment::get(std::shared_ptr<Token> name) {
-    if (values.count(name->get_lexeme()) > 0)
-        return values.at(name->get_lexeme());
-
-    if (enclosing != nullptr)
-        return enclosing->get(name);
-
-    throw Runtime_error("Undefined variable " + name->get_lexeme() + "!",
-                        name);
+    global_slots[name] = values.size();
+    return define(value);
 }
 
-// Assign to an existing variable.
-void Environment::assign(std::shared_ptr<Token> name, Literal value) {
-    if (values.count(name->get_lexeme()) > 0) {
-        values[name->get_lexeme()] = value;
-        return;
-    }
-
-    if (enclosing != nullptr) {
-        enclosing->assign(name, value);
-        return;
-    }
+// Get the value of an existing global variable.
+Value Environment::get_global(String* name, Token_id token) {
+    auto slot = global_slots.find(name);
+    if (slot != global_slots.end())
+        return values[slot->second];
 
-    throw Runtime_error("Undefined variable " + name->get_lexeme() + "!",
-                        name);
+    throw Runtime_error("Undefined variable " + name->get_chars() + "!", token);
 }
 
-// Get the value of an existing variable, at the desired depth in the
-// environment stack.
-Literal Environment::get_at(int distance, std::string name) {
-    return ancestor(distance)->values[name];
+// Find the slot of a global variable, -1 if it isn't defined.
+int64_t Environment::find_global(String* name) {
+    auto slot = global_slots.find(name);
+    if (slot != global_slots.end())
+        return slot->second;
+
+    return -1;
 }
 
-// Get the environment at the desired depth.
-std::shared_ptr<Environment> Environment::ancestor(int distance) {
-    std::shared_ptr<Environment> environment = shared_from_this();
-    for (int i = 0; i < distance; i++) {
-        environment = environment->enclosing;
+// Assign to an existing global variable.
+void Environment::assign_global(String* name, Token_id token, Value value) {
+    auto slot = global_slots.find(name);
+    if (slot != global_slots.end()) {
+        values[slot->second] = value;
+        return;
     }
 
-    return environment;
+    throw Runtime_error("Undefined variable " + name->get_chars() + "!", token);
 }
 
-// Set the value of an existing variable, at the desired depth in the
-// environment stack.
-void Environment::assign_at(int distance, std::shared_ptr<Token> name,
-                            Literal value) {
-    ancestor(distance)->values[name->get_lexeme()] = value;
+// Mark the enclosing environment, the global names and the defined values.
+void Environment::trace(Heap& heap) {
+    heap.mark_object(enclosing);
+    for (auto& slot : global_slots)
+        heap.mark_object(slot.first);
+    for (auto value : values)
+        heap.mark_value(value);
 }
@@ -1,25 +1,22 @@
-#include <iostream>
-
 #include "error_handling.h"
 
 namespace error_handling {
 
-bool had_error = false;
-
-void error(uint32_t line, std::string msg) {
+void Reporter::error(uint32_t line, std::string msg) {
     report(line, "", msg);
 }
 
-void error(std::shared_ptr<Token> tok, std::string msg) {
-    if (tok->get_type() == Token_type::END)
-        report(tok->get_line(), "at end", msg);
+void Reporter::error(const Tokens& tokens, Token_id tok, std::string msg) {
+    if (tokens.get_type(tok) == Token_type::END)
+        report(tokens.get_line(tok), "at end", msg);
     else
-        report(tok->get_line(), " at '" + tok->get_lexeme() + "'", msg);
+        report(tokens.get_line(tok),
+               " at '" + std::string(tokens.get_lexeme(tok)) + "'", msg);
 }
 
-void report(uint32_t line, std::string where, std::string msg) {
-    std::cout << "[line " << line << "] Error" << where << ": "
-              << msg << std::endl;
+void Reporter::report(uint32_t line, std::string where, std::string msg) {
+    out << "[line " << line << "] Error" << where << ": "
+        << msg << std::endl;
     had_error = true;
 }
 
@@ -1,46 +1,67 @@
 #include "function.h"
-#include "environment.h"
 #include "interpreter.h"
-#include "return.h"
+#include "heap.h"
+#include "instance.h"
 
 // Invoke a call operator on the function
-Literal Function::call(std::shared_ptr<Interpreter> interpreter,
-                       std::vector<Literal>& arguments) {
-    std::shared_ptr<Environment> environment
-            = std::make_shared<Environment>(closure);
-    for (unsigned int i = 0; i < declaration->get_params().size(); i++) {
-        environment->define(((declaration->get_params()).at(i)->get_lexeme()),
-                            arguments.at(i));
+Value Function::call(std::shared_ptr<Interpreter> interpreter, size_t frame) {
+    if (receiver != nullptr) {
+        // The receiver takes the slot which held this bound method, which
+        // must stay alive while its body runs.
+        interpreter->push_root(Value(this));
+        Value value = invoke(interpreter, receiver, frame);
+        interpreter->pop_roots(1);
+        return value;
     }
 
-    try {
-        interpreter->execute_block(declaration->get_body(), environment);
-    } catch (Return return_value) {
-        if (is_initializer)
-            return closure->get_at(0, "this");
+    Profiler::Scope profile(interpreter->get_profiler(), name->get_chars());
 
-        return return_value.get_value();
-    }
+    // The parameters are the arguments after the callee's slot, in order.
+    if (code != nullptr)
+        return interpreter->execute_body(*code, frame + 1, upvalues);
+    return interpreter->execute_body(declaration.get_body(), frame + 1,
+                                     upvalues);
+}
+
+// Call the method on an instance, without binding it first.
+Value Function::invoke(std::shared_ptr<Interpreter> interpreter,
+                       Instance* instance, size_t frame) {
+    Profiler::Scope profile(interpreter->get_profiler(), name->get_chars());
+
+    // "this" replaces the callee in slot 0 of the method's frame, the
+    // parameters follow it.
+    interpreter->stack[frame] = Value(instance);
+
+    Value value = code != nullptr
+                  ? interpreter->execute_body(*code, frame, upvalues)
+                  : interpreter->execute_body(declaration.get_body(), frame,
+                                              upvalues);
 
-    Literal ret;
     if (is_initializer)
-        ret = closure->get_at(0, "this");
-    else
-        ret.value = nullptr;
-    return ret;
+        return Value(instance);
+    return value;
 }
 
 // Check the arity of the function.
-uint32_t Function::arity() { return (declaration->get_params()).size(); }
+uint32_t Function::arity() { return (declaration.get_params()).size(); }
 
-// Bind a class instance to the class method invocation.
-std::shared_ptr<Function> Function::bind(std::shared_ptr<Instance> instance) {
-    std::shared_ptr<Environment> environment
-            = std::make_shared<Environment>(closure);
+// Get the name of the function.
+const std::string& Function::get_name() {
+    return name->get_chars();
+}
 
-    Literal inst;
-    inst.value = instance;
-    environment->define("this", inst);
+// Bind a class instance to the class method invocation.
+Function* Function::bind(Heap& heap, Instance* instance) {
+    Function* method = heap.allocate<Function>(declaration, name, upvalues,
+                                               is_initializer, instance);
+    method->set_code(code);
+    return method;
+}
 
-    return std::make_shared<Function>(declaration, environment, is_initializer);
+// Mark the name, the captured variables and the bound instance.
+void Function::trace(Heap& heap) {
+    heap.mark_object(name);
+    for (Upvalue* upvalue : upvalues)
+        heap.mark_object(upvalue);
+    heap.mark_object(receiver);
 }
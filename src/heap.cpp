@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <chrono>
+
+#include "heap.h"
+
+// Heap constructor. Interns the names used by the engines.
+Heap::Heap(Gc_config config)
+    : config(config), next_gc(config.initial_threshold) {
+    init_string = intern("init");
+    this_string = intern("this");
+    super_string = intern("super");
+    pin(init_string);
+    pin(this_string);
+    pin(super_string);
+}
+
+// Heap destructor. Frees all of the heap objects.
+Heap::~Heap() {
+    Obj* obj = objects;
+    while (obj != nullptr) {
+        Obj* next = obj->get_next();
+        delete obj;
+        obj = next;
+    }
+}
+
+// Get the unique String with the given contents, creating it if needed.
+String* Heap::intern(std::string_view chars) {
+    auto interned = strings.find(chars);
+    if (interned != strings.end())
+        return interned->second;
+
+    String* string = allocate<String>(chars);
+    // Key on the String's own copy of the characters.
+    strings.emplace(string->get_chars(), string);
+    return string;
+}
+
+// Unregister a source of roots.
+void Heap::remove_roots(Root_set* roots) {
+    root_sets.erase(std::remove(root_sets.begin(), root_sets.end(), roots),
+                    root_sets.end());
+}
+
+// Mark an object as reachable.
+void Heap::mark_object(Obj* obj) {
+    if (obj == nullptr || obj->is_marked())
+        return;
+
+    obj->set_marked(true);
+    gray_stack.push_back(obj);
+}
+
+// Mark the objects referenced by the root sets.
+void Heap::mark_roots() {
+    for (auto roots : root_sets)
+        roots->mark_roots(*this);
+}
+
+// Mark everything reachable from the gray objects.
+void Heap::trace_references() {
+    while (!gray_stack.empty()) {
+        Obj* obj = gray_stack.back();
+        gray_stack.pop_back();
+        obj->trace(*this);
+    }
+}
+
+// Drop the strings which are about to be freed from the intern table.
+void Heap::remove_white_strings() {
+    for (auto string = strings.begin(); string != strings.end();) {
+        if (!string->second->is_marked() && !string->second->is_pinned())
+            string = strings.erase(string);
+        else
+            string++;
+    }
+}
+
+// Free the unmarked objects and clear the marks of the rest.
+void Heap::sweep() {
+    Obj* previous = nullptr;
+    Obj* obj = objects;
+    while (obj != nullptr) {
+        if (obj->is_marked() || obj->is_pinned()) {
+            obj->set_marked(false);
+            previous = obj;
+            obj = obj->get_next();
+            continue;
+        }
+
+        Obj* unreached = obj;
+        obj = obj->get_next();
+        if (previous != nullptr)
+            previous->set_next(obj);
+        else
+            objects = obj;
+
+        bytes_allocated -= unreached->get_size();
+        stats.objects_freed++;
+        stats.bytes_freed += unreached->get_size();
+        delete unreached;
+    }
+}
+
+// Free all the objects which are not reachable from the roots.
+void Heap::collect() {
+    auto start = std::chrono::steady_clock::now();
+
+    mark_roots();
+    trace_references();
+    remove_white_strings();
+    sweep();
+
+    next_gc = std::max(static_cast<size_t>(bytes_allocated * config.growth_factor),
+                       config.initial_threshold);
+
+    std::chrono::duration<double> pause = std::chrono::steady_clock::now() - start;
+    stats.collections++;
+    stats.pause_seconds += pause.count();
+    stats.max_pause_seconds = std::max(stats.max_pause_seconds, pause.count());
+}
+
+// Overloaded ostream operator for printing out the statistics.
+std::ostream& operator<<(std::ostream& os, const Gc_stats& stats) {
+    return os << "gc collections: " << stats.collections << "\n"
+              << "gc objects allocated: " << stats.objects_allocated << "\n"
+              << "gc bytes allocated: " << stats.bytes_allocated << "\n"
+              << "gc objects freed: " << stats.objects_freed << "\n"
+              << "gc bytes freed: " << stats.bytes_freed << "\n"
+              << "gc peak bytes: " << stats.peak_bytes << "\n"
+              << "gc pause total: " << stats.pause_seconds * 1000. << " ms\n"
+              << "gc pause max: " << stats.max_pause_seconds * 1000. << " ms";
+}
@@ -0,0 +1,9 @@
+#include "inline_cache.h"
+
+// Overloaded ostream operator for printing out the statistics.
+std::ostream& operator<<(std::ostream& os, const Ic_stats& stats) {
+    return os << "ic get hits: " << stats.get_hits << "\n"
+              << "ic get misses: " << stats.get_misses << "\n"
+              << "ic set hits: " << stats.set_hits << "\n"
+              << "ic set misses: " << stats.set_misses;
+}
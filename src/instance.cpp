@@ -1,23 +1,26 @@
 #include "instance.h"
-#include "token.h"
 #include "class.h"
-#include "runtime_error.h"
+#include "heap.h"
 
-Literal Instance::get(std::shared_ptr<Token> name) {
-    if (fields.find(name->get_lexeme()) != fields.end())
-        return fields[name->get_lexeme()];
+// Instance constructor. New instances start with the class' empty shape.
+Instance::Instance(Class* klass)
+    : Obj(Obj_type::INSTANCE), klass(klass), shape(klass->get_root_shape()) {}
 
-    std::shared_ptr<Function> method = klass->find_method(name->get_lexeme());
-    if (method != nullptr) {
-        Literal ret;
-        ret.value = method->bind(shared_from_this());
-        return ret;
+// Set the value of a field, adding it if needed.
+void Instance::set_field(String* name, Value value) {
+    int64_t field = shape->find(name);
+    if (field >= 0) {
+        slot(field) = value;
+        return;
     }
 
-    throw Runtime_error("Undefined property '" + name->get_lexeme() + "'.",
-                        name);
+    add_field(shape->add(name), value);
 }
 
-void Instance::set(std::shared_ptr<Token> name, Literal value) {
-    fields[name->get_lexeme()] = value;
+// Mark the class and the field values. The field names are marked by the
+// class, which owns the shapes.
+void Instance::trace(Heap& heap) {
+    heap.mark_object(klass);
+    for (uint32_t field = 0; field < shape->get_field_count(); field++)
+        heap.mark_value(slot(field));
 }
@@ -1,8 +1,7 @@
 #include <cassert>
-#include <type_traits>
-#include <iostream>
+#include <cstdint>
+#include <ostream>
 #include <string>
-#include <chrono>
 
 #include "class.h"
 #include "instance.h"
@@ -10,194 +9,450 @@
 #include "runtime_error.h"
 #include "error_handling.h"
 #include "function.h"
-#include "return.h"
 #include "lambda.h"
 
-Interpreter::Interpreter() : result(), locals() {
-    class Clock_function : public Callable {
-        Literal call(std::shared_ptr<Interpreter> interpreter,
-                     std::vector<Literal> &arguments) override {
-            Literal ret;
-            ret.value = static_cast<double>(std::chrono::duration_cast<std::chrono::seconds>(
-                                            std::chrono::system_clock::now().time_since_epoch()).count());
+Interpreter::Interpreter(Heap& heap, const Tokens& tokens, Ast& ast,
+                         error_handling::Reporter& errors, std::ostream& out)
+    : result(), heap(heap), tokens(tokens), ast(ast), errors(errors), out(out) {
+    globals = heap.allocate<Environment>();
+    stack.reserve(256);
+    heap.add_roots(this);
 
-            return ret;
-        }
+    String* clock = heap.intern("clock");
+    heap.pin(clock);
+    globals->define_global(clock, Value(heap.allocate<Native>(clock_native, 0)));
+    heap.resize(globals);
+}
 
-        uint32_t arity() override {
-            return 0;
-        }
-    };
+Interpreter::~Interpreter() {
+    heap.remove_roots(this);
+}
 
-    Literal clock;
-    clock.value = std::make_shared<Clock_function>();
-    globals->define("clock", clock);
+// Mark the globals, the stack, the upvalues, the result register and the
+// temporary roots.
+void Interpreter::mark_roots(Heap& heap) {
+    heap.mark_object(globals);
+    for (auto value : stack)
+        heap.mark_value(value);
+    if (upvalues != nullptr) {
+        for (Upvalue* upvalue : *upvalues)
+            heap.mark_object(upvalue);
+    }
+    for (Upvalue* upvalue = open_upvalues; upvalue != nullptr;
+         upvalue = upvalue->get_next_open())
+        heap.mark_object(upvalue);
+    heap.mark_value(result);
+    for (auto value : temp_roots)
+        heap.mark_value(value);
 }
 
 // Evaluate an expression. Just a wrapper around the call to accept method.
-void Interpreter::evaluate(std::shared_ptr<Expr> expr) {
-    expr->accept(shared_from_this());
+void Interpreter::evaluate(Expr_id expr) {
+    ast.accept_expr(expr, *this);
 }
 
 // Execute a statement. Just a wrapper around the call to accept method.
-void Interpreter::execute(std::shared_ptr<Stmt> stmt) {
-    stmt->accept(shared_from_this());
-}
+void Interpreter::execute(Stmt_id stmt) {
+    // Statement boundaries are the collector's and the profiler's safe
+    // points, and where the allocations are attributed to a new line.
+    heap.maybe_collect();
+    if (profiler != nullptr)
+        profiler->poll(ast.line_of(tokens, stmt));
+    if (heap.get_allocation_sites() != nullptr)
+        heap.get_allocation_sites()->set_line(ast.line_of(tokens, stmt));
+    ast.accept_stmt(stmt, *this);
+}
+
+// Call the callee, or invoke the method on the receiver if given, with the
+// arguments pushed to its frame. The frame is popped.
+Value Interpreter::call(Callable* callee, Instance* receiver, size_t frame,
+                        Token_id paren) {
+    size_t arg_count = stack.size() - frame - 1;
+    if (arg_count != callee->arity())
+        throw Runtime_error("Expected " + std::to_string(callee->arity())
+                            + " arguments, but got "
+                            + std::to_string(arg_count) + "!", paren);
+    char here;
+    if (call_depth == FRAMES_MAX
+        || reinterpret_cast<uintptr_t>(&here) < stack_limit)
+        throw Runtime_error("Stack overflow!", paren);
+
+    call_depth++;
+    Value value = receiver != nullptr
+                  ? static_cast<Function*>(callee)->invoke(shared_from_this(),
+                                                           receiver, frame)
+                  : callee->call(shared_from_this(), frame);
+    call_depth--;
+    pop_locals(frame, false);
+    return value;
+}
+
+// Execute the body of a function in the frame, returns the returned value.
+Value Interpreter::execute_body(Id_list statements, size_t frame,
+                                const std::vector<Upvalue*>& upvalues) {
+    size_t previous_frame = this->frame;
+    const std::vector<Upvalue*>* previous_upvalues = this->upvalues;
+    uint32_t previous_depth = scope_depth;
+    this->frame = frame;
+    this->upvalues = &upvalues;
+    scope_depth = 1;
+
+    for (Stmt_id statement : ast.get_list(statements)) {
+        execute(statement);
+        if (returning)
+            break;
+    }
 
-// Execute statements which compose a block.
-void Interpreter::execute_block(std::list<std::shared_ptr<Stmt>>& statements,
-                                std::shared_ptr<Environment> environment) {
-    std::shared_ptr<Environment> previous = this->environment;
-    try {
-        this->environment = environment;
-        for (auto statement : statements)
-            execute(statement);
-        this->environment = previous;
-    } catch (Return return_value) {
-        this->environment = previous;
-        throw return_value;
+    pop_locals(frame, true);
+    this->frame = previous_frame;
+    this->upvalues = previous_upvalues;
+    scope_depth = previous_depth;
+
+    if (!returning)
+        return Value();
+
+    returning = false;
+    return result;
+}
+
+// Run a function body compiled by the Closure_compiler in the frame, returns
+// the returned value.
+Value Interpreter::execute_body(const Compiled_body& body, size_t frame,
+                                const std::vector<Upvalue*>& upvalues) {
+    size_t previous_frame = this->frame;
+    const std::vector<Upvalue*>* previous_upvalues = this->upvalues;
+    this->frame = frame;
+    this->upvalues = &upvalues;
+
+    bool returned = body.code();
+
+    pop_locals(frame, true);
+    this->frame = previous_frame;
+    this->upvalues = previous_upvalues;
+    return returned ? result : Value();
+}
+
+// Pop everything from first on. The captured variables are moved into
+// their upvalues first.
+void Interpreter::pop_locals(size_t first, bool captured) {
+    if (captured)
+        close_upvalues(first);
+    stack.resize(first);
+}
+
+// Push a local variable. A full stack is moved to a larger one, and the
+// open upvalues follow it.
+void Interpreter::push_local(Value value) {
+    if (stack.size() == stack.capacity()) {
+        std::vector<Value> grown;
+        grown.reserve(2 * stack.capacity());
+        if (heap.get_allocation_sites() != nullptr)
+            heap.get_allocation_sites()->record(Allocation_sites::STACK,
+                                                grown.capacity() * sizeof(Value));
+        grown.assign(stack.begin(), stack.end());
+        for (Upvalue* upvalue = open_upvalues; upvalue != nullptr;
+             upvalue = upvalue->get_next_open())
+            upvalue->set_location(grown.data()
+                                  + (upvalue->get_location() - stack.data()));
+        stack.swap(grown);
     }
+    stack.push_back(value);
 }
 
-// Is the literal considered to be TRUE.
-bool Interpreter::is_truthy() {
-    bool ret = std::visit([](auto& arg) {
-        using T = std::decay_t<decltype(arg)>;
-        if constexpr(std::is_same_v<T, bool>)
-            return arg;
-        else if constexpr(std::is_same_v<T, std::nullptr_t>)
-            return false;
+// Capture the variables a closure lists, from the running frame and
+// closure.
+std::vector<Upvalue*> Interpreter::capture(Id_list captures) {
+    std::vector<Upvalue*> captured;
+    captured.reserve(captures.size());
+    for (uint32_t capture : ast.get_list(captures)) {
+        if (capture_is_local(capture))
+            captured.push_back(capture_upvalue(frame + capture_index(capture)));
         else
-            return true;
-    }, result.value);
-
-    return ret;
-}
-
-// Add two literals.
-void Interpreter::add(auto& left) {
-    std::visit([&result = result](auto& left, auto& right) {
-        using T = std::decay_t<decltype(left)>;
-        using U = std::decay_t<decltype(right)>;
-        if constexpr(std::is_same_v<T, U> && (std::is_same_v<T, std::string>
-                                              || std::is_same_v<T, double>))
-            result.value = left + right;
-        else throw std::runtime_error("Operands must be two numbers or two "
-                                      "strings!");
-    }, left, result.value);
-}
-
-// Are two literals equal.
-bool Interpreter::is_equal(Literal& left) {
-    bool ret = std::visit([](auto& left, auto& right) {
-        using T = std::decay_t<decltype(left)>;
-        using U = std::decay_t<decltype(right)>;
-        if constexpr(std::is_same_v<T, U>)
-            return left == right;
-        else
-            return false;
-    }, left.value, result.value);
+            captured.push_back((*upvalues)[capture_index(capture)]);
+    }
+    return captured;
+}
+
+// Find the open upvalue of the stack slot, or create one. Closures which
+// capture the same variable share its upvalue.
+Upvalue* Interpreter::capture_upvalue(size_t slot) {
+    Value* local = stack.data() + slot;
+    Upvalue* prev = nullptr;
+    Upvalue* upvalue = open_upvalues;
+    while (upvalue != nullptr && upvalue->get_location() > local) {
+        prev = upvalue;
+        upvalue = upvalue->get_next_open();
+    }
+
+    if (upvalue != nullptr && upvalue->get_location() == local)
+        return upvalue;
+
+    Upvalue* created = heap.allocate<Upvalue>(local);
+    created->set_next_open(upvalue);
+    if (prev == nullptr)
+        open_upvalues = created;
+    else
+        prev->set_next_open(created);
+
+    return created;
+}
+
+// Close all the open upvalues of the slots from first on.
+void Interpreter::close_upvalues(size_t first) {
+    Value* last = stack.data() + first;
+    while (open_upvalues != nullptr && open_upvalues->get_location() >= last) {
+        Upvalue* upvalue = open_upvalues;
+        upvalue->close();
+        open_upvalues = upvalue->get_next_open();
+    }
+}
 
-    return ret;
+// Add two values.
+void Interpreter::add(Value left) {
+    if (is_obj_type(left, Obj_type::STRING)
+        && is_obj_type(result, Obj_type::STRING))
+        result = Value(heap.intern(static_cast<String*>(left.as_obj())->get_chars()
+                                   + static_cast<String*>(result.as_obj())->get_chars()));
+    else if (left.is_number() && result.is_number())
+        result = Value(left.as_number() + result.as_number());
+    else
+        throw std::runtime_error("Operands must be two numbers or two "
+                                 "strings!");
 }
 
 // Get the Callable class (and its children) instance.
-std::shared_ptr<Callable> Interpreter::get_callable(Literal& callee,
-                                                    std::shared_ptr<Token> parent) {
-    return std::visit([&parent](auto& callee_value) {
-        using T = std::decay_t<decltype(callee_value)>;
-        if constexpr(std::is_same_v<T, std::shared_ptr<Callable>>)
-            return callee_value;
-        else if constexpr(std::is_same_v<T, std::shared_ptr<Function>>
-                          || std::is_same_v<T, std::shared_ptr<Lambda>>
-                          || std::is_same_v<T, std::shared_ptr<Class>>)
-            return std::dynamic_pointer_cast<Callable>(callee_value);
-        else {
-            throw Runtime_error("Can call only functions and classes!",
-                                parent);
-            return std::dynamic_pointer_cast<Callable>(std::make_shared<Function>());
-        }
-    }, callee.value);
+Callable* Interpreter::get_callable(Value callee, Token_id parent) {
+    if (!is_callable(callee))
+        throw Runtime_error("Can call only functions and classes!", parent);
+
+    return static_cast<Callable*>(callee.as_obj());
 }
 
-// Get the Instance class.
-std::shared_ptr<Instance> Interpreter::get_instance(Literal& callee,
-                                                    std::shared_ptr<Token> parent) {
-    return std::visit([&parent](auto& callee_value) {
-        using T = std::decay_t<decltype(callee_value)>;
-        if constexpr(std::is_same_v<T, std::shared_ptr<Instance>>)
-            return callee_value;
-        else {
-            throw Runtime_error("Only instances have fields!", parent);
-            return std::make_shared<Instance>();
+// Look up a property through the inline cache of the access site. A field
+// is stored in the result, a method is returned unbound.
+Function* Interpreter::look_up_property(Instance* instance, Get_expr& expr) {
+    Shape* shape = instance->get_shape();
+    Inline_cache& cache = expr.get_cache();
+
+    if (const Inline_cache::Entry* entry = cache.lookup(shape->get_id())) {
+        ic_stats.get_hits++;
+        if (entry->kind == Inline_cache::Kind::FIELD) {
+            result = instance->slot(entry->slot);
+            return nullptr;
         }
-    }, callee.value);
+        return static_cast<Function*>(entry->method);
+    }
+
+    ic_stats.get_misses++;
+    String* name = tokens.get_string(expr.get_name());
+    int64_t field = shape->find(name);
+    if (field >= 0) {
+        cache.add_field(shape->get_id(), field);
+        result = instance->slot(field);
+        return nullptr;
+    }
+
+    Obj* method = instance->get_klass()->find_method(name);
+    if (method == nullptr)
+        throw Runtime_error("Undefined property '"
+                            + std::string(tokens.get_lexeme(expr.get_name())) + "'.",
+                            expr.get_name());
+
+    cache.add_method(shape->get_id(), method);
+    return static_cast<Function*>(method);
 }
 
-std::shared_ptr<Class> Interpreter::get_superclass(Literal& callee,
-                                                   std::shared_ptr<Token> parent) {
-    return std::visit([&parent](auto& callee_value) {
-        using T = std::decay_t<decltype(callee_value)>;
-        if constexpr(std::is_same_v<T, std::shared_ptr<Class>>)
-            return callee_value;
+// Store a property through the inline cache of the access site.
+void Interpreter::set_property(Instance* instance, Set_expr& expr,
+                               Value value) {
+    // The shape is read after evaluating the value, which may have added
+    // fields to the object.
+    Shape* shape = instance->get_shape();
+    Inline_cache& cache = expr.get_cache();
+
+    if (const Inline_cache::Entry* entry = cache.lookup(shape->get_id())) {
+        ic_stats.set_hits++;
+        if (entry->kind == Inline_cache::Kind::FIELD)
+            instance->slot(entry->slot) = value;
         else {
-            throw Runtime_error("Superclass must be a class!", parent);
-            return std::make_shared<Class>();
+            instance->add_field(entry->shape, value);
+            heap.resize(instance);
         }
-    }, callee.value);
+        return;
+    }
+
+    ic_stats.set_misses++;
+    String* name = tokens.get_string(expr.get_name());
+    int64_t field = shape->find(name);
+    if (field >= 0) {
+        cache.add_field(shape->get_id(), field);
+        instance->slot(field) = value;
+        return;
+    }
+
+    Shape* child = shape->add(name);
+    cache.add_transition(shape->get_id(), child);
+    instance->add_field(child, value);
+    heap.resize(instance);
+    // The class owns the shapes, which may have grown.
+    heap.resize(instance->get_klass());
 }
 
-Literal Interpreter::look_up_variable(std::shared_ptr<Token> name,
-                                      std::shared_ptr<Expr> expr) {
-    if (locals.find(expr) != locals.end()) {
-        int distance = locals[expr];
-        return environment->get_at(distance, name->get_lexeme());
+// Get the Instance class.
+Instance* Interpreter::get_instance(Value callee, Token_id parent) {
+    if (!is_obj_type(callee, Obj_type::INSTANCE))
+        throw Runtime_error("Only instances have fields!", parent);
+
+    return static_cast<Instance*>(callee.as_obj());
+}
+
+Class* Interpreter::get_superclass(Value callee, Token_id parent) {
+    if (!is_obj_type(callee, Obj_type::CLASS))
+        throw Runtime_error("Superclass must be a class!", parent);
+
+    return static_cast<Class*>(callee.as_obj());
+}
+
+// Define a variable in the current scope, returns its slot: in the globals
+// at the top level, in the frame otherwise.
+uint32_t Interpreter::define(Token_id name, Value value) {
+    if (scope_depth == 0) {
+        uint32_t slot = globals->define_global(tokens.get_string(name), value);
+        heap.resize(globals);
+        return slot;
     }
 
-    return globals->get(name);
+    push_local(value);
+    return stack.size() - 1 - frame;
+}
+
+// Set a variable defined in the current scope, once its value is ready.
+void Interpreter::initialize(uint32_t slot, Value value) {
+    if (scope_depth == 0)
+        globals->assign_at(0, slot, value);
+    else
+        stack[frame + slot] = value;
+}
+
+// Look up a variable where the resolver found it, or in the globals if it
+// isn't in any local scope.
+Value Interpreter::look_up_variable(Token_id name,
+                                    Resolution& resolution) {
+    if (resolution.is_local())
+        return local(resolution);
+
+    return globals->get_global(tokens.get_string(name), name);
 }
 
 // Implementation of visitor interface.
 
 // Interpret a single literal.
-void Interpreter::visit_literal_expr(const std::shared_ptr<Literal_expr> expr) {
-    auto token = expr->get_literal();
-    assert(token->get_type() == Token_type::NIL
-           || token->get_type() == Token_type::NUMBER
-           || token->get_type() == Token_type::STRING
-           || token->get_type() == Token_type::TRUE
-           || token->get_type() == Token_type::FALSE);
-
-    if (token->get_type() == Token_type::NIL)
-        result.value = nullptr;
-    else if (token->get_type() == Token_type::NUMBER)
-        result.value = token->get_value();
-    else if (token->get_type() == Token_type::STRING)
-        result.value = token->get_lexeme();
-    else if (token->get_type() == Token_type::TRUE)
-        result.value = true;
+void Interpreter::visit_literal_expr(Literal_expr& expr) {
+    Token_id token = expr.get_literal();
+    Token_type type = tokens.get_type(token);
+    assert(type == Token_type::NIL
+           || type == Token_type::NUMBER
+           || type == Token_type::STRING
+           || type == Token_type::TRUE
+           || type == Token_type::FALSE);
+
+    if (type == Token_type::NIL)
+        result = Value();
+    else if (type == Token_type::NUMBER)
+        result = Value(tokens.get_value(token));
+    else if (type == Token_type::STRING)
+        result = Value(tokens.get_string(token));
+    else if (type == Token_type::TRUE)
+        result = Value(true);
     else
-        result.value = false;
+        result = Value(false);
 }
 
 // Interpret a grouping expression.
-void Interpreter::visit_grouping_expr(const std::shared_ptr<Grouping_expr> expr) {
-    evaluate(expr->get_expr());
+void Interpreter::visit_grouping_expr(Grouping_expr& expr) {
+    evaluate(expr.get_expr());
+}
+
+// Pick the specialised form of a binary operation for the operand types.
+static Quick_op quick_binary_op(Token_type op, Value left, Value right) {
+    switch (op) {
+    case Token_type::BANG_EQUAL:
+        return Quick_op::NOT_EQUAL;
+    case Token_type::EQUAL_EQUAL:
+        return Quick_op::EQUAL;
+    case Token_type::PLUS:
+        if (is_obj_type(left, Obj_type::STRING)
+            && is_obj_type(right, Obj_type::STRING))
+            return Quick_op::STRING_ADD;
+        break;
+    default:
+        break;
+    }
+
+    if (!left.is_number() || !right.is_number())
+        return Quick_op::GENERIC;
+
+    switch (op) {
+    case Token_type::PLUS:
+        return Quick_op::NUMBER_ADD;
+    case Token_type::MINUS:
+        return Quick_op::NUMBER_SUBTRACT;
+    case Token_type::STAR:
+        return Quick_op::NUMBER_MULTIPLY;
+    case Token_type::SLASH:
+        return Quick_op::NUMBER_DIVIDE;
+    case Token_type::GREATER:
+        return Quick_op::NUMBER_GREATER;
+    case Token_type::GREATER_EQUAL:
+        return Quick_op::NUMBER_GREATER_EQUAL;
+    case Token_type::LESS:
+        return Quick_op::NUMBER_LESS;
+    case Token_type::LESS_EQUAL:
+        return Quick_op::NUMBER_LESS_EQUAL;
+    default:
+        return Quick_op::GENERIC;
+    }
 }
 
 // Interpret a unary expression.
-void Interpreter::visit_unary_expr(const std::shared_ptr<Unary_expr> expr) {
-    evaluate(expr->get_right());
+void Interpreter::visit_unary_expr(Unary_expr& expr) {
+    evaluate(expr.get_right());
 
-    assert(expr->get_op()->get_type() == Token_type::MINUS
-           || expr->get_op()->get_type() == Token_type::BANG);
+    switch (expr.get_quick()) {
+    case Quick_op::NUMBER_NEGATE:
+        if (result.is_number()) {
+            result = Value(-result.as_number());
+            return;
+        }
+        break;
+    case Quick_op::NOT:
+        result = Value(!is_truthy());
+        return;
+    default:
+        break;
+    }
 
-    switch (expr->get_op()->get_type()) {
+    Token_type op = tokens.get_type(expr.get_op());
+    assert(op == Token_type::MINUS || op == Token_type::BANG);
+
+    // The first evaluation picks the specialised form, a failed guard
+    // leaves the node generic.
+    if (expr.get_quick() != Quick_op::UNQUICKENED)
+        expr.quicken(Quick_op::GENERIC);
+    else if (op == Token_type::BANG)
+        expr.quicken(Quick_op::NOT);
+    else
+        expr.quicken(result.is_number() ? Quick_op::NUMBER_NEGATE
+                                        : Quick_op::GENERIC);
+
+    switch (op) {
     case Token_type::MINUS:
-        result.value = -std::get<double>(result.value);
+        if (!result.is_number())
+            throw Runtime_error("Operand must be a number!", expr.get_op());
+        result = Value(-result.as_number());
         break;
     case Token_type::BANG:
-        result.value = !is_truthy();
+        result = Value(!is_truthy());
         break;
     // Unreachable.
     default:
@@ -207,94 +462,199 @@ void Interpreter::visit_unary_expr(const std::shared_ptr<Unary_expr> expr) {
 }
 
 // Interpret a binary expression.
-void Interpreter::visit_binary_expr(const std::shared_ptr<Binary_expr> expr) {
-    assert(expr->get_op()->get_type() == Token_type::MINUS
-           || expr->get_op()->get_type() == Token_type::SLASH
-           || expr->get_op()->get_type() == Token_type::STAR
-           || expr->get_op()->get_type() == Token_type::PLUS
-           || expr->get_op()->get_type() == Token_type::GREATER
-           || expr->get_op()->get_type() == Token_type::GREATER_EQUAL
-           || expr->get_op()->get_type() == Token_type::LESS
-           || expr->get_op()->get_type() == Token_type::LESS_EQUAL
-           || expr->get_op()->get_type() == Token_type::BANG_EQUAL
-           || expr->get_op()->get_type() == Token_type::EQUAL_EQUAL);
-
-    evaluate(expr->get_left());
-    Literal left = result;
-    evaluate(expr->get_right());
-
-    try {
-        switch(expr->get_op()->get_type()) {
-        case Token_type::GREATER:
-            result.value = std::get<double>(left.value)
-                           > std::get<double>(result.value);
-            break;
-        case Token_type::GREATER_EQUAL:
-            result.value = std::get<double>(left.value)
-                           >= std::get<double>(result.value);
-            break;
-        case Token_type::LESS:
-            result.value = std::get<double>(left.value)
-                           < std::get<double>(result.value);
-            break;
-        case Token_type::LESS_EQUAL:
-            result.value = std::get<double>(left.value)
-                           <= std::get<double>(result.value);
-            break;
-        case Token_type::BANG_EQUAL:
-            result.value = !is_equal(left);
-            break;
-        case Token_type::EQUAL_EQUAL:
-            result.value = is_equal(left);
-            break;
-        case Token_type::MINUS:
-            result.value = std::get<double>(left.value)
-                           - std::get<double>(result.value);
-            break;
-        case Token_type::SLASH:
-            result.value = std::get<double>(left.value)
-                           / std::get<double>(result.value);
-            break;
-        case Token_type::STAR:
-            result.value = std::get<double>(left.value)
-                           * std::get<double>(result.value);
-            break;
-        case Token_type::PLUS:
-        {
-            add(left.value);
-            break;
+void Interpreter::visit_binary_expr(Binary_expr& expr) {
+    evaluate(expr.get_left());
+    Value left = result;
+    push_root(left);
+    evaluate(expr.get_right());
+    pop_roots(1);
+
+    // Specialised forms, each guarded by a check of the operand types.
+    switch (expr.get_quick()) {
+    case Quick_op::NUMBER_ADD:
+        if (left.is_number() && result.is_number()) {
+            result = Value(left.as_number() + result.as_number());
+            return;
         }
-        default:
-            break;
+        break;
+    case Quick_op::NUMBER_SUBTRACT:
+        if (left.is_number() && result.is_number()) {
+            result = Value(left.as_number() - result.as_number());
+            return;
+        }
+        break;
+    case Quick_op::NUMBER_MULTIPLY:
+        if (left.is_number() && result.is_number()) {
+            result = Value(left.as_number() * result.as_number());
+            return;
+        }
+        break;
+    case Quick_op::NUMBER_DIVIDE:
+        if (left.is_number() && result.is_number()) {
+            result = Value(left.as_number() / result.as_number());
+            return;
+        }
+        break;
+    case Quick_op::NUMBER_GREATER:
+        if (left.is_number() && result.is_number()) {
+            result = Value(left.as_number() > result.as_number());
+            return;
+        }
+        break;
+    case Quick_op::NUMBER_GREATER_EQUAL:
+        if (left.is_number() && result.is_number()) {
+            result = Value(left.as_number() >= result.as_number());
+            return;
+        }
+        break;
+    case Quick_op::NUMBER_LESS:
+        if (left.is_number() && result.is_number()) {
+            result = Value(left.as_number() < result.as_number());
+            return;
+        }
+        break;
+    case Quick_op::NUMBER_LESS_EQUAL:
+        if (left.is_number() && result.is_number()) {
+            result = Value(left.as_number() <= result.as_number());
+            return;
+        }
+        break;
+    case Quick_op::STRING_ADD:
+        if (is_obj_type(left, Obj_type::STRING)
+            && is_obj_type(result, Obj_type::STRING)) {
+            add(left);
+            return;
         }
-    } catch (std::bad_variant_access&) {
-        throw Runtime_error("Operands must be numbers!", expr->get_op());
-    } catch (std::runtime_error& e) {
-        throw Runtime_error(e.what(), expr->get_op());
+        break;
+    case Quick_op::EQUAL:
+        result = Value(is_equal(left));
+        return;
+    case Quick_op::NOT_EQUAL:
+        result = Value(!is_equal(left));
+        return;
+    default:
+        break;
+    }
+
+    Token_type op = tokens.get_type(expr.get_op());
+    assert(op == Token_type::MINUS
+           || op == Token_type::SLASH
+           || op == Token_type::STAR
+           || op == Token_type::PLUS
+           || op == Token_type::GREATER
+           || op == Token_type::GREATER_EQUAL
+           || op == Token_type::LESS
+           || op == Token_type::LESS_EQUAL
+           || op == Token_type::BANG_EQUAL
+           || op == Token_type::EQUAL_EQUAL);
+
+    // The first evaluation picks the specialised form, a failed guard
+    // leaves the node generic.
+    if (expr.get_quick() == Quick_op::UNQUICKENED)
+        expr.quicken(quick_binary_op(op, left, result));
+    else
+        expr.quicken(Quick_op::GENERIC);
+
+    switch(op) {
+    case Token_type::BANG_EQUAL:
+        result = Value(!is_equal(left));
+        return;
+    case Token_type::EQUAL_EQUAL:
+        result = Value(is_equal(left));
+        return;
+    case Token_type::PLUS:
+        try {
+            add(left);
+        } catch (std::runtime_error& e) {
+            throw Runtime_error(e.what(), expr.get_op());
+        }
+        return;
+    default:
+        break;
+    }
+
+    if (!left.is_number() || !result.is_number())
+        throw Runtime_error("Operands must be numbers!", expr.get_op());
+
+    double left_number = left.as_number();
+    double right_number = result.as_number();
+    switch(op) {
+    case Token_type::GREATER:
+        result = Value(left_number > right_number);
+        break;
+    case Token_type::GREATER_EQUAL:
+        result = Value(left_number >= right_number);
+        break;
+    case Token_type::LESS:
+        result = Value(left_number < right_number);
+        break;
+    case Token_type::LESS_EQUAL:
+        result = Value(left_number <= right_number);
+        break;
+    case Token_type::MINUS:
+        result = Value(left_number - right_number);
+        break;
+    case Token_type::SLASH:
+        result = Value(left_number / right_number);
+        break;
+    case Token_type::STAR:
+        result = Value(left_number * right_number);
+        break;
+    // Unreachable.
+    default:
+        break;
     }
 }
 
 // Interpret a variable use.
-void Interpreter::visit_variable_expr(const std::shared_ptr<Variable_expr> expr) {
-    result = environment->get(expr->get_name());
+void Interpreter::visit_variable_expr(Variable_expr& expr) {
+    result = look_up_variable(expr.get_name(), expr);
 }
 
 // Interpret a variable assignment.
-void Interpreter::visit_assign_expr(const std::shared_ptr<Assign_expr> expr) {
-    evaluate(expr->get_value());
+void Interpreter::visit_assign_expr(Assign_expr& expr) {
+    evaluate(expr.get_value());
 
-    if (locals.find(expr) != locals.end()) {
-        environment->assign_at(locals[expr], expr->get_name(), result);
+    if (expr.is_local()) {
+        local(expr) = result;
     } else {
-        globals->assign(expr->get_name(), result);
+        globals->assign_global(tokens.get_string(expr.get_name()),
+                               expr.get_name(), result);
     }
 }
 
 // Interpret a logical expression.
-void Interpreter::visit_logical_expr(const std::shared_ptr<Logical_expr> expr) {
-    evaluate(expr->get_left());
+void Interpreter::visit_logical_expr(Logical_expr& expr) {
+    evaluate(expr.get_left());
+
+    switch (expr.get_quick()) {
+    case Quick_op::BOOL_OR:
+        if (result.is_bool()) {
+            if (!result.as_bool())
+                evaluate(expr.get_right());
+            return;
+        }
+        break;
+    case Quick_op::BOOL_AND:
+        if (result.is_bool()) {
+            if (result.as_bool())
+                evaluate(expr.get_right());
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    bool is_or = tokens.get_type(expr.get_op()) == Token_type::OR;
+    // The first evaluation picks the specialised form, a failed guard
+    // leaves the node generic.
+    if (expr.get_quick() != Quick_op::UNQUICKENED || !result.is_bool())
+        expr.quicken(Quick_op::GENERIC);
+    else
+        expr.quicken(is_or ? Quick_op::BOOL_OR : Quick_op::BOOL_AND);
 
-    if (expr->get_op()->get_type() == Token_type::OR) {
+    if (is_or) {
         if (is_truthy())
             return;
     } else {
@@ -302,199 +662,247 @@ void Interpreter::visit_logical_expr(const std::shared_ptr<Logical_expr> expr) {
             return;
     }
 
-    evaluate(expr->get_right());
+    evaluate(expr.get_right());
 }
 
 // Interpret a function call.
-void Interpreter::visit_call_expr(const std::shared_ptr<Call_expr> expr) {
-    evaluate(expr->get_callee());
-    std::shared_ptr<Callable> callee = get_callable(result, expr->get_paren());
+void Interpreter::visit_call_expr(Call_expr& expr) {
+    // A method called through a property access is invoked on the
+    // instance directly, without allocating a bound method.
+    Function* method = nullptr;
+    Instance* receiver = nullptr;
+    if (expr.is_invoke()) {
+        Get_expr& property = ast.get<Get_expr>(expr.get_callee());
+        evaluate(property.get_object());
+        if (!is_obj_type(result, Obj_type::INSTANCE))
+            throw Runtime_error("Only instances have properties!",
+                                property.get_name());
+
+        receiver = static_cast<Instance*>(result.as_obj());
+        method = look_up_property(receiver, property);
+        if (method != nullptr)
+            result = Value(receiver);
+    } else
+        evaluate(expr.get_callee());
+
+    Callable* callee = method;
+    if (callee == nullptr) {
+        callee = get_callable(result, expr.get_paren());
+        receiver = nullptr;
+    }
 
-    std::vector<Literal> arguments;
-    for (std::shared_ptr<Expr> arg : expr->get_arguments()) {
+    // The arguments are evaluated straight into the frame of the call,
+    // after the callee's slot.
+    size_t call_frame = stack.size();
+    push_local(result);
+    for (Expr_id arg : ast.get_list(expr.get_arguments())) {
         evaluate(arg);
-        arguments.push_back(result);
+        push_local(result);
     }
 
-    if (arguments.size() != callee->arity())
-        throw Runtime_error("Expected " + std::to_string(callee->arity())
-                            + " arguments, but got "
-                            + std::to_string(arguments.size()) + "!",
-                            expr->get_paren());
-
-    result = callee->call(shared_from_this(), arguments);
+    result = call(callee, receiver, call_frame, expr.get_paren());
 }
 
 // Interpret a lambda function.
-void Interpreter::visit_lambda_expr(const std::shared_ptr<Lambda_expr> expr) {
-    result.value = std::make_shared<Lambda>(expr, environment);
+void Interpreter::visit_lambda_expr(Lambda_expr& expr) {
+    result = Value(heap.allocate<Lambda>(expr, capture(expr.get_captures())));
 }
 
 // Interpret a class object get expression.
-void Interpreter::visit_get_expr(const std::shared_ptr<Get_expr> expr) {
-    evaluate(expr->get_object());
+void Interpreter::visit_get_expr(Get_expr& expr) {
+    evaluate(expr.get_object());
 
-    try {
-        std::shared_ptr<Instance> object
-                = std::get<std::shared_ptr<Instance>>(result.value);
-        result = object->get(expr->get_name());
-    } catch (std::bad_variant_access) {
+    if (!is_obj_type(result, Obj_type::INSTANCE))
         throw Runtime_error("Only instances have properties!",
-                            expr->get_name());
-    }
+                            expr.get_name());
+
+    Instance* instance = static_cast<Instance*>(result.as_obj());
+    Function* method = look_up_property(instance, expr);
+    if (method != nullptr)
+        result = Value(method->bind(heap, instance));
 }
 
 // Interpret a class object set expression.
-void Interpreter::visit_set_expr(const std::shared_ptr<Set_expr> expr) {
-    evaluate(expr->get_object());
-    std::shared_ptr<Instance> object = get_instance(result, expr->get_name());
+void Interpreter::visit_set_expr(Set_expr& expr) {
+    evaluate(expr.get_object());
+    Instance* object = get_instance(result, expr.get_name());
+    push_root(result);
 
-    evaluate(expr->get_value());
-    object->set(expr->get_name(), result);
+    evaluate(expr.get_value());
+    pop_roots(1);
+
+    set_property(object, expr, result);
 }
 
 // Interpret a this expression.
-void Interpreter::visit_this_expr(const std::shared_ptr<This_expr> expr) {
-    result = look_up_variable(expr->get_keyword(), expr);
+void Interpreter::visit_this_expr(This_expr& expr) {
+    result = look_up_variable(expr.get_keyword(), expr);
 }
 
 // Interpret a super expression.
-void Interpreter::visit_super_expr(const std::shared_ptr<Super_expr> expr) {
-    int distance = locals[expr];
-    std::shared_ptr<Class> superclass
-            = std::get<std::shared_ptr<Class>>(environment->get_at(distance, "super").value);
+void Interpreter::visit_super_expr(Super_expr& expr) {
+    Class* superclass
+            = static_cast<Class*>(look_up_variable(expr.get_keyword(), expr).as_obj());
 
-    std::shared_ptr<Instance> object
-            = std::get<std::shared_ptr<Instance>>(environment->get_at(distance - 1, "this").value);
+    Instance* object
+            = static_cast<Instance*>(local(expr.get_receiver()).as_obj());
 
-    std::shared_ptr<Function> method
-            = superclass->find_method(expr->get_method()->get_lexeme());
+    Obj* method = superclass->find_method(tokens.get_string(expr.get_method()));
 
-    if (!method)
+    if (method == nullptr)
         throw Runtime_error("Undefined property '"
-                            + expr->get_method()->get_lexeme() + "'!",
-                            expr->get_method());
+                            + std::string(tokens.get_lexeme(expr.get_method())) + "'!",
+                            expr.get_method());
 
-    result.value = method->bind(object);
+    result = Value(static_cast<Function*>(method)->bind(heap, object));
 }
 
 // Interpret a function declaration.
-void Interpreter::visit_function_stmt(const std::shared_ptr<Function_stmt> stmt) {
-    Literal function;
-    function.value = std::make_shared<Function>(stmt, environment, false);
-    environment->define(stmt->get_name()->get_lexeme(), function);
+void Interpreter::visit_function_stmt(Function_stmt& stmt) {
+    // A local function may capture itself, so its slot is defined before
+    // the function is created.
+    uint32_t slot = define(stmt.get_name(), Value());
+    Function* function = heap.allocate<Function>(stmt,
+                                                 tokens.get_string(stmt.get_name()),
+                                                 capture(stmt.get_captures()),
+                                                 false);
+    initialize(slot, Value(function));
 }
 
 // Interpret an expression statement.
-void Interpreter::visit_expression_stmt(const std::shared_ptr<Expression_stmt> stmt) {
-    evaluate(stmt->get_expr());
+void Interpreter::visit_expression_stmt(Expression_stmt& stmt) {
+    evaluate(stmt.get_expr());
 }
 
 // Interpret a print statement.
-void Interpreter::visit_print_stmt(const std::shared_ptr<Print_stmt> stmt) {
-    evaluate(stmt->get_expr());
-    std::cout << result << std::endl;
+void Interpreter::visit_print_stmt(Print_stmt& stmt) {
+    evaluate(stmt.get_expr());
+    out << result << std::endl;
 }
 
 // Interpret a variable declaration.
-void Interpreter::visit_var_stmt(const std::shared_ptr<Var_stmt> stmt) {
-    Literal value;
-    value.value = nullptr;
-    if (stmt->get_initializer() != nullptr) {
-        evaluate(stmt->get_initializer());
+void Interpreter::visit_var_stmt(Var_stmt& stmt) {
+    Value value;
+    if (stmt.get_initializer() != NO_NODE) {
+        evaluate(stmt.get_initializer());
         value = result;
     }
 
-    environment->define(stmt->get_name()->get_lexeme(), value);
+    define(stmt.get_name(), value);
 }
 
-// Interpret a block of statements.
-void Interpreter::visit_block_stmt(const std::shared_ptr<Block_stmt> stmt) {
-    execute_block(stmt->get_statements(),
-                  std::make_shared<Environment>(environment));
+// Interpret a block of statements. Its variables are popped when it's left.
+void Interpreter::visit_block_stmt(Block_stmt& stmt) {
+    size_t first = stack.size();
+    scope_depth++;
+    for (Stmt_id statement : ast.get_list(stmt.get_statements())) {
+        execute(statement);
+        if (returning)
+            break;
+    }
+    scope_depth--;
+    pop_locals(first, stmt.get_captured());
 }
 
 // Interpret an if statement.
-void Interpreter::visit_if_stmt(const std::shared_ptr<If_stmt> stmt) {
-    evaluate(stmt->get_condition());
+void Interpreter::visit_if_stmt(If_stmt& stmt) {
+    evaluate(stmt.get_condition());
     if (is_truthy())
-        execute(stmt->get_then_branch());
-    else if (stmt->get_else_branch() != nullptr)
-        execute(stmt->get_else_branch());
+        execute(stmt.get_then_branch());
+    else if (stmt.get_else_branch() != NO_NODE)
+        execute(stmt.get_else_branch());
 }
 
 // Interpret a while loop.
-void Interpreter::visit_while_stmt(const std::shared_ptr<While_stmt> stmt) {
-    evaluate(stmt->get_condition());
+void Interpreter::visit_while_stmt(While_stmt& stmt) {
+    evaluate(stmt.get_condition());
     while (is_truthy()) {
-        execute(stmt->get_body());
-        evaluate(stmt->get_condition());
+        execute(stmt.get_body());
+        if (returning)
+            break;
+        evaluate(stmt.get_condition());
     }
 }
 
 // Interpret a return statement.
-void Interpreter::visit_return_stmt(const std::shared_ptr<Return_stmt> stmt) {
-    Literal value;
-    value.value = nullptr;
-
-    if (stmt->get_value()) {
-        evaluate(stmt->get_value());
-        value = result;
-    }
+void Interpreter::visit_return_stmt(Return_stmt& stmt) {
+    if (stmt.get_value() != NO_NODE)
+        evaluate(stmt.get_value());
+    else
+        result = Value();
 
-    throw Return(result);
+    // The enclosing loops and blocks stop as soon as they see the flag,
+    // and the call which runs the function body clears it.
+    returning = true;
 }
 
 // Interpret a class declaration.
-void Interpreter::visit_class_stmt(const std::shared_ptr<Class_stmt> stmt) {
-    Literal temp;
-    temp.value = nullptr;
-
-    Literal superclass;
-    superclass.value = nullptr;
-    if (stmt->get_superclass()) {
-        evaluate(stmt->get_superclass());
-        superclass.value
-                = get_superclass(result, stmt->get_superclass()->get_name());
+void Interpreter::visit_class_stmt(Class_stmt& stmt) {
+    Class* superclass = nullptr;
+    if (stmt.get_superclass() != NO_NODE) {
+        evaluate(stmt.get_superclass());
+        superclass = get_superclass(result,
+                                    ast.get<Variable_expr>(stmt.get_superclass()).get_name());
     }
 
-    environment->define(stmt->get_name()->get_lexeme(), temp);
+    uint32_t slot = define(stmt.get_name(), Value());
 
-    if (stmt->get_superclass()) {
-        environment = std::make_shared<Environment>(environment);
-        environment->define("super", superclass);
-    }
+    // The superclass is a local which the methods capture as "super".
+    size_t super_slot = stack.size();
+    if (superclass != nullptr)
+        push_local(Value(superclass));
 
     Class::method_map methods;
-    for (auto method : stmt->get_methods()) {
-        std::shared_ptr<Function> function
-                = std::make_shared<Function>(method, environment,
-                                             method->get_name()->get_lexeme() == "init");
-        methods[method->get_name()->get_lexeme()] = function;
+    for (Stmt_id id : ast.get_list(stmt.get_methods())) {
+        Function_stmt& method = ast.get<Function_stmt>(id);
+        String* name = tokens.get_string(method.get_name());
+        Function* function
+                = heap.allocate<Function>(method, name,
+                                          capture(method.get_captures()),
+                                          name == heap.get_init_string());
+        methods[name] = Value(function);
     }
 
-    std::shared_ptr<Class> klass = nullptr;
-    if (stmt->get_superclass())
-        klass = std::make_shared<Class>(stmt->get_name()->get_lexeme(),
-                                        std::get<std::shared_ptr<Class>>(superclass.value),
-                                        methods);
-    else
-        klass = std::make_shared<Class>(stmt->get_name()->get_lexeme(),
-                                        nullptr, methods);
+    Class* klass = heap.allocate<Class>(tokens.get_string(stmt.get_name())->get_chars(),
+                                        tokens.get_line(stmt.get_name()),
+                                        superclass, methods);
+    klass->set_initializer(klass->find_method(heap.get_init_string()));
 
-    if (stmt->get_superclass())
-        environment = environment->get_enclosing();
+    if (superclass != nullptr)
+        pop_locals(super_slot, true);
+
+    initialize(slot, Value(klass));
+}
 
-    temp.value = klass;
-    environment->assign(stmt->get_name(), temp);
+// Drop the state of the calls a runtime error unwound. Closures which
+// escaped keep the last values of the variables they captured.
+void Interpreter::reset() {
+    close_upvalues(0);
+    stack.clear();
+    frame = 0;
+    call_depth = 1;
+    upvalues = nullptr;
+    scope_depth = 0;
+    temp_roots.clear();
 }
 
 // Start the interpreter run.
-void Interpreter::interpret(std::list<std::shared_ptr<Stmt>>& statements) {
+void Interpreter::interpret(Id_list statements) {
     try {
-        for (auto stmt : statements)
+        for (Stmt_id stmt : ast.get_list(statements))
             execute(stmt);
     } catch (Runtime_error& e) {
-        error_handling::error(e.get_token(), e.what());
+        errors.error(tokens, e.get_token(), e.what());
+        reset();
+    }
+}
+
+// Start the run of a script compiled by the Closure_compiler.
+void Interpreter::interpret(const Compiled_body& script) {
+    try {
+        script.code();
+    } catch (Runtime_error& e) {
+        errors.error(tokens, e.get_token(), e.what());
+        reset();
     }
 }
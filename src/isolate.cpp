@@ -0,0 +1,258 @@
+#include <chrono>
+#include <fstream>
+
+#include "isolate.h"
+#include "source.h"
+#include "scanner.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "resolver.h"
+#include "optimizer.h"
+#include "cache.h"
+#include "compiler.h"
+#include "closure_compiler.h"
+#include "vm.h"
+#include "profiler.h"
+#include "run_stats.h"
+#include "native_stack.h"
+
+// Isolate constructor.
+Isolate::Isolate(const Options& options)
+    : options(options), errors(*options.errors), heap(options.gc),
+      tokens(std::string_view()) {
+    if (options.stats_format != Stats_format::NONE)
+        run_stats = std::make_unique<Run_stats>(heap, tokens, ast);
+}
+
+// Isolate destructor. The tokens and the AST are dropped before the source
+// text they refer to.
+Isolate::~Isolate() = default;
+
+// Load the script in a file.
+bool Isolate::load_file(const std::string& path) {
+    if (loaded) {
+        errors.error(0, "A script is already loaded!");
+        return false;
+    }
+
+    file = std::make_unique<Source_file>(path);
+    if (!file->is_open()) {
+        errors.error(0, "Input file not opened correctly!");
+        return false;
+    }
+
+    return compile(file->get_text(), path);
+}
+
+// Load the script in a string.
+bool Isolate::load_source(std::string source) {
+    if (loaded) {
+        errors.error(0, "A script is already loaded!");
+        return false;
+    }
+
+    text = std::move(source);
+    return compile(text, "");
+}
+
+// Turn the source text into a resolved AST.
+bool Isolate::compile(std::string_view source, const std::string& path) {
+    loaded = true;
+
+    std::unique_ptr<Cache_file> cache;
+    if (options.cache && !path.empty())
+        cache = std::make_unique<Cache_file>(path, source, options.cache_dir,
+                                             options.optimize);
+
+    if (cache != nullptr) {
+        Run_stats::Phase phase(run_stats.get(), "cache load");
+        if (cache->load(heap, tokens, ast, statements))
+            return true;
+    }
+
+    {
+        Run_stats::Phase phase(run_stats.get(), "scan");
+        Scanner scanner(source, heap, errors);
+        tokens = scanner.scan_tokens();
+    }
+    {
+        Run_stats::Phase phase(run_stats.get(), "parse");
+        Parser parser(tokens, ast, errors);
+        statements = parser.parse();
+    }
+
+    if (errors.has_error())
+        return false;
+
+    {
+        Run_stats::Phase phase(run_stats.get(), "resolve");
+        Resolver resolver(tokens, ast, errors);
+        resolver.resolve(statements);
+    }
+
+    if (errors.has_error())
+        return false;
+
+    if (options.optimize) {
+        Run_stats::Phase phase(run_stats.get(), "optimize");
+        Optimizer optimizer(heap, tokens, ast);
+        statements = optimizer.optimize(statements);
+
+        if (options.fold_stats)
+            *options.stats << optimizer.get_stats() << std::endl;
+    }
+
+    // Cached before the run, while the nodes are still unquickened and
+    // their inline caches empty.
+    if (cache != nullptr) {
+        Run_stats::Phase phase(run_stats.get(), "cache store");
+        cache->store(tokens, ast, statements);
+    }
+
+    return true;
+}
+
+// Run the loaded script.
+bool Isolate::run() {
+    if (!loaded) {
+        errors.error(0, "No script loaded!");
+        return false;
+    }
+    // The script failed to load, the errors are already reported.
+    if (errors.has_error()) {
+        write_run_stats();
+        return false;
+    }
+    // The nodes have been quickened and their caches filled by the first
+    // run, which refer to its objects.
+    if (ran) {
+        errors.error(0, "The script has already run!");
+        return false;
+    }
+    ran = true;
+
+    std::ostream& stats = *options.stats;
+
+    std::unique_ptr<Profiler> profiler;
+    if (!options.profile.empty())
+        profiler = std::make_unique<Profiler>(
+                std::chrono::microseconds(options.profile_interval));
+
+    // Set before compiling, so that the closure engine compiles the line
+    // tracking in.
+    std::unique_ptr<Allocation_sites> allocation_sites;
+    if (options.allocation_sites > 0) {
+        allocation_sites = std::make_unique<Allocation_sites>();
+        heap.set_allocation_sites(allocation_sites.get());
+    }
+
+    // The tree-walking engines recurse on the C++ stack, so every engine
+    // runs on a stack of its own, deep enough for the call depth limit.
+    bool compiled = true;
+    if (!run_on_native_stack([&](uintptr_t stack_limit) {
+            compiled = execute(profiler.get(), stack_limit);
+        }))
+        errors.error(0, "Not enough memory for the interpreter stack!");
+
+    if (!compiled) {
+        heap.set_allocation_sites(nullptr);
+        write_run_stats();
+        return false;
+    }
+
+    if (allocation_sites != nullptr) {
+        heap.set_allocation_sites(nullptr);
+        allocation_sites->write(stats, options.allocation_sites);
+    }
+
+    if (profiler != nullptr) {
+        profiler->stop();
+
+        std::ofstream profile(options.profile);
+        profiler->write(profile);
+        profile.close();
+        if (!profile)
+            errors.error(0, "Profile not written to " + options.profile + "!");
+    }
+
+    if (options.gc_stats)
+        stats << heap.get_stats() << std::endl;
+    write_run_stats();
+
+    return !errors.has_error();
+}
+
+// Compile the script for the selected engine and run it. Returns false if
+// it failed to compile.
+bool Isolate::execute(Profiler* profiler, uintptr_t stack_limit) {
+    std::ostream& out = *options.out;
+    std::ostream& stats = *options.stats;
+
+    if (options.engine == Engine::VM) {
+        Vm vm(heap, tokens, errors, out);
+        Prototype* script;
+        {
+            Run_stats::Phase phase(run_stats.get(), "compile");
+            Compiler compiler(heap, tokens, ast, errors);
+            script = compiler.compile_script(statements);
+        }
+
+        if (errors.has_error())
+            return false;
+
+        vm.set_profiler(profiler);
+        if (profiler != nullptr)
+            profiler->start();
+        {
+            Run_stats::Phase phase(run_stats.get(), "run");
+            vm.interpret(script);
+        }
+    } else if (options.engine == Engine::CLOSURE) {
+        std::shared_ptr<Interpreter> interpreter
+                = std::make_shared<Interpreter>(heap, tokens, ast, errors, out);
+        // The closures poll the profiler only if it is set when they are
+        // compiled.
+        interpreter->set_profiler(profiler);
+        interpreter->set_stack_limit(stack_limit);
+        Closure_compiler compiler(*interpreter, tokens, ast);
+        const Compiled_body* script;
+        {
+            Run_stats::Phase phase(run_stats.get(), "compile");
+            script = &compiler.compile_script(statements);
+        }
+
+        if (profiler != nullptr)
+            profiler->start();
+        {
+            Run_stats::Phase phase(run_stats.get(), "run");
+            interpreter->interpret(*script);
+        }
+
+        if (options.ic_stats)
+            stats << interpreter->get_ic_stats() << std::endl;
+    } else {
+        std::shared_ptr<Interpreter> interpreter
+                = std::make_shared<Interpreter>(heap, tokens, ast, errors, out);
+        interpreter->set_profiler(profiler);
+        interpreter->set_stack_limit(stack_limit);
+        if (profiler != nullptr)
+            profiler->start();
+        {
+            Run_stats::Phase phase(run_stats.get(), "run");
+            interpreter->interpret(statements);
+        }
+
+        if (options.ic_stats)
+            stats << interpreter->get_ic_stats() << std::endl;
+    }
+
+    return true;
+}
+
+// Print the phase statistics to the statistics stream.
+void Isolate::write_run_stats() {
+    if (options.stats_format == Stats_format::TEXT)
+        run_stats->write_text(*options.stats);
+    else if (options.stats_format == Stats_format::JSON)
+        run_stats->write_json(*options.stats);
+}
@@ -1,28 +1,23 @@
 #include "lambda.h"
-#include "environment.h"
 #include "interpreter.h"
-#include "return.h"
+#include "heap.h"
 
 // Invoke a call operator on the function
-Literal Lambda::call(std::shared_ptr<Interpreter> interpreter,
-                     std::vector<Literal>& arguments) {
-    std::shared_ptr<Environment> environment
-            = std::make_shared<Environment>(closure);
-    for (unsigned int i = 0; i < declaration->get_params().size(); i++) {
-        environment->define(((declaration->get_params()).at(i)->get_lexeme()),
-                            arguments.at(i));
-    }
+Value Lambda::call(std::shared_ptr<Interpreter> interpreter, size_t frame) {
+    Profiler::Scope profile(interpreter->get_profiler(), "<lambda>");
 
-    try {
-        interpreter->execute_block(declaration->get_body(), environment);
-    } catch (Return return_value) {
-        return return_value.get_value();
-    }
-
-    Literal ret;
-    ret.value = nullptr;
-    return ret;
+    // The parameters are the arguments after the callee's slot, in order.
+    if (code != nullptr)
+        return interpreter->execute_body(*code, frame + 1, upvalues);
+    return interpreter->execute_body(declaration.get_body(), frame + 1,
+                                     upvalues);
 }
 
 // Check the arity of the function.
-uint32_t Lambda::arity() { return (declaration->get_params()).size(); }
+uint32_t Lambda::arity() { return (declaration.get_params()).size(); }
+
+// Mark the captured variables.
+void Lambda::trace(Heap& heap) {
+    for (Upvalue* upvalue : upvalues)
+        heap.mark_object(upvalue);
+}
@@ -1,16 +1,92 @@
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 
 #include "driver.h"
 #include "error_handling.h"
 
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-        error_handling::error(0, "Source file not provided!");
+// Parse the value of a numeric option, exits on malformed values.
+static double parse_number(error_handling::Reporter& errors,
+                           const char* option, const char* value) {
+    char* end;
+    double number = std::strtod(value, &end);
+    if (*value == '\0' || *end != '\0' || number <= 0) {
+        errors.error(0, "Invalid value of option " + std::string(option) + "!");
         exit(1);
     }
-    run(argv[1]);
 
-    if (error_handling::had_error)
+    return number;
+}
+
+int main(int argc, char* argv[]) {
+    error_handling::Reporter errors(std::cout);
+    Options options;
+    char* source = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--engine=tree") == 0)
+            options.engine = Engine::TREE_WALKER;
+        else if (std::strcmp(argv[i], "--engine=vm") == 0)
+            options.engine = Engine::VM;
+        else if (std::strcmp(argv[i], "--engine=closure") == 0)
+            options.engine = Engine::CLOSURE;
+        else if (std::strncmp(argv[i], "--gc-threshold=", 15) == 0)
+            options.gc.initial_threshold
+                    = static_cast<size_t>(parse_number(errors, "--gc-threshold",
+                                                       argv[i] + 15));
+        else if (std::strncmp(argv[i], "--gc-growth=", 12) == 0)
+            options.gc.growth_factor = parse_number(errors, "--gc-growth",
+                                                    argv[i] + 12);
+        else if (std::strcmp(argv[i], "--gc-stats") == 0)
+            options.gc_stats = true;
+        else if (std::strcmp(argv[i], "--ic-stats") == 0)
+            options.ic_stats = true;
+        else if (std::strcmp(argv[i], "--no-optimize") == 0)
+            options.optimize = false;
+        else if (std::strcmp(argv[i], "--fold-stats") == 0)
+            options.fold_stats = true;
+        else if (std::strcmp(argv[i], "--cache") == 0)
+            options.cache = true;
+        else if (std::strncmp(argv[i], "--cache-dir=", 12) == 0) {
+            options.cache = true;
+            options.cache_dir = argv[i] + 12;
+        }
+        else if (std::strcmp(argv[i], "--alloc-sites") == 0)
+            options.allocation_sites = 10;
+        else if (std::strncmp(argv[i], "--alloc-sites=", 14) == 0)
+            options.allocation_sites
+                    = static_cast<uint32_t>(parse_number(errors, "--alloc-sites",
+                                                         argv[i] + 14));
+        else if (std::strcmp(argv[i], "--stats") == 0
+                 || std::strcmp(argv[i], "--stats=text") == 0)
+            options.stats_format = Stats_format::TEXT;
+        else if (std::strcmp(argv[i], "--stats=json") == 0)
+            options.stats_format = Stats_format::JSON;
+        else if (std::strcmp(argv[i], "--profile") == 0)
+            options.profile = "cpplox.folded";
+        else if (std::strncmp(argv[i], "--profile=", 10) == 0)
+            options.profile = argv[i] + 10;
+        else if (std::strncmp(argv[i], "--profile-interval=", 19) == 0)
+            options.profile_interval
+                    = static_cast<uint32_t>(parse_number(errors, "--profile-interval",
+                                                         argv[i] + 19));
+        else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            errors.error(0, "Unknown option " + std::string(argv[i])
+                                  + "!");
+            exit(1);
+        } else if (source == nullptr)
+            source = argv[i];
+        else {
+            errors.error(0, "Only one source file can be provided!");
+            exit(1);
+        }
+    }
+
+    if (source == nullptr) {
+        errors.error(0, "Source file not provided!");
+        exit(1);
+    }
+    if (!run(source, options))
         exit(1);
 
     return 0;
@@ -0,0 +1,49 @@
+#include <exception>
+
+#include <pthread.h>
+
+#include "native_stack.h"
+
+// Part of the stack kept free below the limit. Calls only check the limit
+// as they start, so it has to hold everything a call may run before its
+// nested calls, e.g. deeply nested expressions, and the error handling.
+static constexpr size_t NATIVE_STACK_RESERVE = 16 * 1024 * 1024;
+
+// Code run on the thread of run_on_native_stack().
+struct Native_stack_task {
+    const std::function<void(uintptr_t)>* code;
+    std::exception_ptr exception;
+};
+
+static void* run_task(void* argument) {
+    Native_stack_task* task = static_cast<Native_stack_task*>(argument);
+    // The stack grows down from about here.
+    char base;
+    uintptr_t limit = reinterpret_cast<uintptr_t>(&base)
+                      - NATIVE_STACK_SIZE + NATIVE_STACK_RESERVE;
+    try {
+        (*task->code)(limit);
+    } catch (...) {
+        task->exception = std::current_exception();
+    }
+    return nullptr;
+}
+
+// Run the code on a new thread with a C++ stack of NATIVE_STACK_SIZE bytes,
+// and wait for it to finish.
+bool run_on_native_stack(const std::function<void(uintptr_t)>& code) {
+    Native_stack_task task{&code, nullptr};
+    pthread_attr_t attributes;
+    pthread_t thread;
+    pthread_attr_init(&attributes);
+    bool created = pthread_attr_setstacksize(&attributes, NATIVE_STACK_SIZE) == 0
+                   && pthread_create(&thread, &attributes, run_task, &task) == 0;
+    pthread_attr_destroy(&attributes);
+    if (!created)
+        return false;
+
+    pthread_join(thread, nullptr);
+    if (task.exception != nullptr)
+        std::rethrow_exception(task.exception);
+    return true;
+}
@@ -0,0 +1,56 @@
+#include "object.h"
+#include "heap.h"
+
+// Name of a kind of heap objects.
+const char* obj_type_name(Obj_type type) {
+    switch (type) {
+    case Obj_type::STRING:
+        return "string";
+    case Obj_type::NATIVE:
+        return "native";
+    case Obj_type::CLASS:
+        return "class";
+    case Obj_type::INSTANCE:
+        return "instance";
+    case Obj_type::ENVIRONMENT:
+        return "environment";
+    case Obj_type::FUNCTION:
+        return "function";
+    case Obj_type::LAMBDA:
+        return "lambda";
+    case Obj_type::PROTOTYPE:
+        return "prototype";
+    case Obj_type::CLOSURE:
+        return "closure";
+    case Obj_type::UPVALUE:
+        return "upvalue";
+    case Obj_type::BOUND_METHOD:
+        return "bound method";
+    }
+    return "unknown";
+}
+
+// Mark the name and the constants of the function.
+void Prototype::trace(Heap& heap) {
+    heap.mark_object(name);
+    for (auto constant : chunk.get_constants())
+        heap.mark_value(constant);
+}
+
+// Mark the captured variable once it has left the stack.
+void Upvalue::trace(Heap& heap) {
+    heap.mark_value(closed);
+}
+
+// Mark the function and the captured variables.
+void Closure::trace(Heap& heap) {
+    heap.mark_object(function);
+    for (auto upvalue : upvalues)
+        heap.mark_object(upvalue);
+}
+
+// Mark the receiver and the method.
+void Bound_method::trace(Heap& heap) {
+    heap.mark_value(receiver);
+    heap.mark_object(method);
+}
@@ -0,0 +1,393 @@
+#include "optimizer.h"
+#include "heap.h"
+
+// Overloaded ostream operator for printing out the statistics.
+std::ostream& operator<<(std::ostream& os, const Fold_stats& stats) {
+    return os << "constants folded: " << stats.folded << "\n"
+              << "variables propagated: " << stats.propagated << "\n"
+              << "branches pruned: " << stats.pruned;
+}
+
+// Rewrite the top level statements, returns the rewritten list.
+Id_list Optimizer::optimize(Id_list statements) {
+    find_assignments(statements);
+    return prune(statements);
+}
+
+// Find the variables which are assigned, and the globals which are declared
+// more than once. Neither kind is propagated.
+void Optimizer::find_assignments(Id_list statements) {
+    for (Assign_expr& assign : ast.get_nodes<Assign_expr>()) {
+        if (assign.is_local())
+            assigned_locals.insert(assign.get_declaration());
+        else
+            assigned_globals.insert(tokens.get_string(assign.get_name()));
+    }
+
+    // Globals are only declared by the top level statements.
+    for (Stmt_id stmt : ast.get_list(statements)) {
+        switch (stmt_kind(stmt)) {
+        case Stmt_kind::VAR:
+            global_declarations[tokens.get_string(ast.get<Var_stmt>(stmt).get_name())]++;
+            break;
+        case Stmt_kind::FUNCTION:
+            global_declarations[tokens.get_string(ast.get<Function_stmt>(stmt).get_name())]++;
+            break;
+        case Stmt_kind::CLASS:
+            global_declarations[tokens.get_string(ast.get<Class_stmt>(stmt).get_name())]++;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+// Rewrite an expression, returns the id which replaces it.
+Expr_id Optimizer::fold(Expr_id expr) {
+    // The replacement of the node being visited is kept, so that visit
+    // methods can fold their children first.
+    uint32_t parent = replacement;
+    replacement = expr;
+    ast.accept_expr(expr, *this);
+
+    Expr_id folded = replacement;
+    replacement = parent;
+    return folded;
+}
+
+// Rewrite a statement, returns the id which replaces it, or NO_NODE if it
+// has no effect.
+Stmt_id Optimizer::prune(Stmt_id stmt) {
+    uint32_t parent = replacement;
+    replacement = stmt;
+    ast.accept_stmt(stmt, *this);
+
+    Stmt_id pruned = replacement;
+    replacement = parent;
+    return pruned;
+}
+
+// Rewrite a statement which can't be removed from its parent, a removed
+// statement is replaced by an empty block.
+Stmt_id Optimizer::prune_child(Stmt_id stmt) {
+    Stmt_id pruned = prune(stmt);
+    if (pruned == NO_NODE)
+        return ast.add(Block_stmt(Id_list()));
+    return pruned;
+}
+
+// Rewrite a list of statements, dropping the removed ones.
+Id_list Optimizer::prune(Id_list statements) {
+    std::vector<Stmt_id> kept;
+    for (Stmt_id stmt : ast.get_list(statements)) {
+        Stmt_id pruned = prune(stmt);
+        if (pruned != NO_NODE)
+            kept.push_back(pruned);
+    }
+    return ast.set_list(statements, kept);
+}
+
+// Get the value of a literal, returns false if the expression isn't one.
+bool Optimizer::is_constant(Expr_id expr, Value& value) {
+    if (expr_kind(expr) != Expr_kind::LITERAL)
+        return false;
+
+    Token_id literal = ast.get<Literal_expr>(expr).get_literal();
+    switch (tokens.get_type(literal)) {
+    case Token_type::NUMBER:
+        value = Value(tokens.get_value(literal));
+        break;
+    case Token_type::STRING:
+        value = Value(tokens.get_string(literal));
+        break;
+    case Token_type::TRUE:
+        value = Value(true);
+        break;
+    case Token_type::FALSE:
+        value = Value(false);
+        break;
+    default:
+        value = Value();
+        break;
+    }
+    return true;
+}
+
+// Add a literal with the given value, located at the token.
+Expr_id Optimizer::make_literal(Value value, Token_id at) {
+    uint32_t line = tokens.get_line(at);
+    Token_id literal;
+
+    if (value.is_number())
+        literal = tokens.add_number(line, 0, 0, value.as_number());
+    else if (value.is_bool())
+        literal = tokens.add(value.as_bool() ? Token_type::TRUE
+                                             : Token_type::FALSE, line, 0, 0);
+    else if (value.is_nil())
+        literal = tokens.add(Token_type::NIL, line, 0, 0);
+    else {
+        // Literal strings live as long as the tokens, like the ones the
+        // scanner interns.
+        String* string = static_cast<String*>(value.as_obj());
+        heap.pin(string);
+        literal = tokens.add_string(Token_type::STRING, line, 0, 0, string);
+    }
+
+    stats.folded++;
+    return ast.add(Literal_expr(literal));
+}
+
+// Overridden visitor methods.
+
+void Optimizer::visit_binary_expr(Binary_expr& expr) {
+    Expr_id left = fold(expr.get_left());
+    Expr_id right = fold(expr.get_right());
+    expr.set_left(left);
+    expr.set_right(right);
+
+    Value a, b;
+    if (!is_constant(left, a) || !is_constant(right, b))
+        return;
+
+    // Operations which would fail are left for the runtime to report.
+    Token_id op = expr.get_op();
+    switch (tokens.get_type(op)) {
+    case Token_type::EQUAL_EQUAL:
+        replacement = make_literal(Value(a == b), op);
+        return;
+    case Token_type::BANG_EQUAL:
+        replacement = make_literal(Value(!(a == b)), op);
+        return;
+    case Token_type::PLUS:
+        if (is_obj_type(a, Obj_type::STRING) && is_obj_type(b, Obj_type::STRING)) {
+            String* string = heap.intern(static_cast<String*>(a.as_obj())->get_chars()
+                                         + static_cast<String*>(b.as_obj())->get_chars());
+            replacement = make_literal(Value(string), op);
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (!a.is_number() || !b.is_number())
+        return;
+
+    double x = a.as_number();
+    double y = b.as_number();
+    switch (tokens.get_type(op)) {
+    case Token_type::PLUS:
+        replacement = make_literal(Value(x + y), op);
+        break;
+    case Token_type::MINUS:
+        replacement = make_literal(Value(x - y), op);
+        break;
+    case Token_type::STAR:
+        replacement = make_literal(Value(x * y), op);
+        break;
+    case Token_type::SLASH:
+        replacement = make_literal(Value(x / y), op);
+        break;
+    case Token_type::GREATER:
+        replacement = make_literal(Value(x > y), op);
+        break;
+    case Token_type::GREATER_EQUAL:
+        replacement = make_literal(Value(x >= y), op);
+        break;
+    case Token_type::LESS:
+        replacement = make_literal(Value(x < y), op);
+        break;
+    case Token_type::LESS_EQUAL:
+        replacement = make_literal(Value(x <= y), op);
+        break;
+    default:
+        break;
+    }
+}
+
+void Optimizer::visit_unary_expr(Unary_expr& expr) {
+    Expr_id right = fold(expr.get_right());
+    expr.set_right(right);
+
+    Value value;
+    if (!is_constant(right, value))
+        return;
+
+    if (tokens.get_type(expr.get_op()) == Token_type::BANG)
+        replacement = make_literal(Value(!value.is_truthy()), expr.get_op());
+    else if (value.is_number())
+        replacement = make_literal(Value(-value.as_number()), expr.get_op());
+}
+
+void Optimizer::visit_grouping_expr(Grouping_expr& expr) {
+    // Parentheses only matter to the parser.
+    replacement = fold(expr.get_expr());
+}
+
+void Optimizer::visit_literal_expr(Literal_expr& expr) {
+    return;
+}
+
+void Optimizer::visit_variable_expr(Variable_expr& expr) {
+    if (expr.is_local()) {
+        auto constant = local_constants.find(expr.get_declaration());
+        if (constant != local_constants.end()) {
+            replacement = constant->second;
+            stats.propagated++;
+        }
+        return;
+    }
+
+    auto constant = global_constants.find(tokens.get_string(expr.get_name()));
+    if (constant != global_constants.end()) {
+        replacement = constant->second;
+        stats.propagated++;
+    }
+}
+
+void Optimizer::visit_assign_expr(Assign_expr& expr) {
+    expr.set_value(fold(expr.get_value()));
+}
+
+void Optimizer::visit_logical_expr(Logical_expr& expr) {
+    Expr_id left = fold(expr.get_left());
+    Expr_id right = fold(expr.get_right());
+    expr.set_left(left);
+    expr.set_right(right);
+
+    // With a constant left operand, the result is either the left operand,
+    // or the right one.
+    Value value;
+    if (!is_constant(left, value))
+        return;
+
+    bool is_or = tokens.get_type(expr.get_op()) == Token_type::OR;
+    replacement = value.is_truthy() == is_or ? left : right;
+    stats.folded++;
+}
+
+void Optimizer::visit_call_expr(Call_expr& expr) {
+    expr.set_callee(fold(expr.get_callee()));
+
+    std::vector<Expr_id> arguments;
+    for (Expr_id argument : ast.get_list(expr.get_arguments()))
+        arguments.push_back(fold(argument));
+    ast.set_list(expr.get_arguments(), arguments);
+}
+
+void Optimizer::visit_lambda_expr(Lambda_expr& expr) {
+    bool enclosing = top_level;
+    top_level = false;
+    expr.set_body(prune(expr.get_body()));
+    top_level = enclosing;
+}
+
+void Optimizer::visit_get_expr(Get_expr& expr) {
+    expr.set_object(fold(expr.get_object()));
+}
+
+void Optimizer::visit_set_expr(Set_expr& expr) {
+    expr.set_object(fold(expr.get_object()));
+    expr.set_value(fold(expr.get_value()));
+}
+
+void Optimizer::visit_this_expr(This_expr& expr) {
+    return;
+}
+
+void Optimizer::visit_super_expr(Super_expr& expr) {
+    return;
+}
+
+void Optimizer::visit_expression_stmt(Expression_stmt& stmt) {
+    stmt.set_expr(fold(stmt.get_expr()));
+}
+
+void Optimizer::visit_print_stmt(Print_stmt& stmt) {
+    stmt.set_expr(fold(stmt.get_expr()));
+}
+
+void Optimizer::visit_var_stmt(Var_stmt& stmt) {
+    if (stmt.get_initializer() == NO_NODE)
+        return;
+
+    Expr_id initializer = fold(stmt.get_initializer());
+    stmt.set_initializer(initializer);
+
+    Value value;
+    if (!is_constant(initializer, value))
+        return;
+
+    // A global can only be propagated into the code which follows its
+    // declaration, any code before it may run before the variable is
+    // defined.
+    if (top_level) {
+        String* name = tokens.get_string(stmt.get_name());
+        if (global_declarations[name] == 1 && !assigned_globals.count(name))
+            global_constants[name] = initializer;
+    } else if (!assigned_locals.count(stmt.get_name()))
+        local_constants[stmt.get_name()] = initializer;
+}
+
+void Optimizer::visit_block_stmt(Block_stmt& stmt) {
+    bool enclosing = top_level;
+    top_level = false;
+    stmt.set_statements(prune(stmt.get_statements()));
+    top_level = enclosing;
+
+    if (stmt.get_statements().empty())
+        replacement = NO_NODE;
+}
+
+void Optimizer::visit_if_stmt(If_stmt& stmt) {
+    Expr_id condition = fold(stmt.get_condition());
+    stmt.set_condition(condition);
+
+    Value value;
+    if (is_constant(condition, value)) {
+        stats.pruned++;
+        if (value.is_truthy())
+            replacement = prune(stmt.get_then_branch());
+        else if (stmt.get_else_branch() != NO_NODE)
+            replacement = prune(stmt.get_else_branch());
+        else
+            replacement = NO_NODE;
+        return;
+    }
+
+    stmt.set_then_branch(prune_child(stmt.get_then_branch()));
+    if (stmt.get_else_branch() != NO_NODE)
+        stmt.set_else_branch(prune(stmt.get_else_branch()));
+}
+
+void Optimizer::visit_while_stmt(While_stmt& stmt) {
+    Expr_id condition = fold(stmt.get_condition());
+    stmt.set_condition(condition);
+
+    Value value;
+    if (is_constant(condition, value) && !value.is_truthy()) {
+        stats.pruned++;
+        replacement = NO_NODE;
+        return;
+    }
+
+    stmt.set_body(prune_child(stmt.get_body()));
+}
+
+void Optimizer::visit_function_stmt(Function_stmt& stmt) {
+    bool enclosing = top_level;
+    top_level = false;
+    stmt.set_body(prune(stmt.get_body()));
+    top_level = enclosing;
+}
+
+void Optimizer::visit_return_stmt(Return_stmt& stmt) {
+    if (stmt.get_value() != NO_NODE)
+        stmt.set_value(fold(stmt.get_value()));
+}
+
+void Optimizer::visit_class_stmt(Class_stmt& stmt) {
+    // The superclass is looked up at runtime, it must stay a variable.
+    for (Stmt_id method : ast.get_list(stmt.get_methods()))
+        prune(method);
+}
@@ -1,5 +1,3 @@
-#include <typeinfo>
-
 #include "parser.h"
 #include "error_handling.h"
 
@@ -17,11 +15,11 @@ bool Parser::match(Token_type type) {
 bool Parser::check(Token_type type) {
     if (is_at_end())
         return false;
-    return peek()->get_type() == type;
+    return tokens.get_type(peek()) == type;
 }
 
 // Advance the token stream.
-std::shared_ptr<Token> Parser::advance() {
+Token_id Parser::advance() {
     if (!is_at_end())
         current++;
     return previous();
@@ -29,25 +27,22 @@ std::shared_ptr<Token> Parser::advance() {
 
 // Whether the current token signalizes the end of the token stream.
 bool Parser::is_at_end() {
-    return peek()->get_type() == Token_type::END;
+    return tokens.get_type(peek()) == Token_type::END;
 }
 
 // Return the next token, but don't advance the stream.
-std::shared_ptr<Token> Parser::peek() {
-    return *current;
+Token_id Parser::peek() {
+    return current;
 }
 
 // Return the previous token.
-std::shared_ptr<Token> Parser::previous() {
-    token_iterator help = --current;
-    current++;
-
-    return *help;
+Token_id Parser::previous() {
+    return current - 1;
 }
 
 // Check whether the next token matches the expected and advance the stream
 // if it does. Conversely, throw an error.
-std::shared_ptr<Token> Parser::consume(Token_type type, std::string msg) {
+Token_id Parser::consume(Token_type type, std::string msg) {
     if (check(type))
         return advance();
 
@@ -60,10 +55,10 @@ void Parser::synchronize() {
     advance();
 
     while (!is_at_end()) {
-        if (previous()->get_type() == Token_type::SEMICOLON)
+        if (tokens.get_type(previous()) == Token_type::SEMICOLON)
             return;
 
-        switch (peek()->get_type()) {
+        switch (tokens.get_type(peek())) {
         case Token_type::CLASS:
         case Token_type::FUN:
         case Token_type::VAR:
@@ -79,13 +74,13 @@ void Parser::synchronize() {
 }
 
 // Report an error and throw an exception.
-Parser::Parse_error Parser::error(std::shared_ptr<Token> tok, std::string msg) {
-    error_handling::error(tok, msg);
+Parser::Parse_error Parser::error(Token_id tok, std::string msg) {
+    errors.error(tokens, tok, msg);
     return Parse_error();
 }
 
-std::shared_ptr<Expr> Parser::finish_call(std::shared_ptr<Expr> callee) {
-    std::list<std::shared_ptr<Expr>> arguments;
+Expr_id Parser::finish_call(Expr_id callee) {
+    std::vector<Expr_id> arguments;
 
     if (!check(Token_type::RIGHT_PAREN)) {
         do {
@@ -95,18 +90,18 @@ std::shared_ptr<Expr> Parser::finish_call(std::shared_ptr<Expr> callee) {
         } while (match(Token_type::COMMA));
     }
 
-    std::shared_ptr<Token> paren = consume(Token_type::RIGHT_PAREN,
-                                           "Expect ')' after arguments.");
+    Token_id paren = consume(Token_type::RIGHT_PAREN,
+                             "Expect ')' after arguments.");
 
-    return std::make_shared<Call_expr>(callee, paren, std::move(arguments));
+    return ast.add(Call_expr(callee, paren, ast.add_list(arguments)));
 }
 
-std::shared_ptr<Function_stmt> Parser::function(std::string kind) {
-    std::shared_ptr<Token> name = consume(Token_type::IDENTIFIER,
-                                          "Expect " + kind + " name!");
+Stmt_id Parser::function(std::string kind) {
+    Token_id name = consume(Token_type::IDENTIFIER,
+                            "Expect " + kind + " name!");
     consume(Token_type::LEFT_PAREN, "Expect '(' after " + kind + "name!");
 
-    std::vector<std::shared_ptr<Token>> parameters;
+    std::vector<Token_id> parameters;
     if (!check(Token_type::RIGHT_PAREN)) {
         do {
             if (parameters.size() > 255)
@@ -119,15 +114,15 @@ std::shared_ptr<Function_stmt> Parser::function(std::string kind) {
     consume(Token_type::RIGHT_PAREN, "Expect ')' after parameters!");
 
     consume(Token_type::LEFT_BRACE, "Expect '{' before " + kind + " body!");
-    std::list<std::shared_ptr<Stmt>> body = block();
-    return std::make_shared<Function_stmt>(name, std::move(parameters),
-                                           std::move(body));
+    Id_list body = block();
+    return ast.add(Function_stmt(name, ast.add_list(parameters), body));
 }
 
-std::shared_ptr<Lambda_expr> Parser::lambda() {
+Expr_id Parser::lambda() {
+    Token_id keyword = previous();
     consume(Token_type::LEFT_PAREN, "Expect '(' after 'fun'!");
 
-    std::vector<std::shared_ptr<Token>> parameters;
+    std::vector<Token_id> parameters;
     if (!check(Token_type::RIGHT_PAREN)) {
         do {
             if (parameters.size() > 255)
@@ -140,14 +135,13 @@ std::shared_ptr<Lambda_expr> Parser::lambda() {
     consume(Token_type::RIGHT_PAREN, "Expect ')' after parameters!");
 
     consume(Token_type::LEFT_BRACE, "Expect '{' before function body!");
-    std::list<std::shared_ptr<Stmt>> body = block();
-    return std::make_shared<Lambda_expr>(std::move(parameters),
-                                         std::move(body));
+    Id_list body = block();
+    return ast.add(Lambda_expr(keyword, ast.add_list(parameters), body));
 }
 
 // Methods which represent the grammar nonterminals.
 
-std::shared_ptr<Stmt> Parser::declaration() {
+Stmt_id Parser::declaration() {
     try {
         if (match(Token_type::CLASS))
             return class_declaration();
@@ -158,44 +152,44 @@ std::shared_ptr<Stmt> Parser::declaration() {
         return statement();
     } catch (Parse_error& e) {
         synchronize();
-        return nullptr;
+        return NO_NODE;
     }
 }
 
-std::shared_ptr<Stmt> Parser::class_declaration() {
-    std::shared_ptr<Token> name = consume(Token_type::IDENTIFIER,
-                                          "Expect class name!");
+Stmt_id Parser::class_declaration() {
+    Token_id name = consume(Token_type::IDENTIFIER,
+                            "Expect class name!");
 
-    std::shared_ptr<Variable_expr> superclass = nullptr;
+    Expr_id superclass = NO_NODE;
     if (match(Token_type::LESS)) {
         consume(Token_type::IDENTIFIER, "Expect superclass name!");
-        superclass = std::make_shared<Variable_expr>(previous());
+        superclass = ast.add(Variable_expr(previous()));
     }
 
     consume(Token_type::LEFT_BRACE, "Expect '{' before class body!");
 
-    std::list<std::shared_ptr<Function_stmt>> methods;
+    std::vector<Stmt_id> methods;
     while (!check(Token_type::RIGHT_BRACE) && !is_at_end())
         methods.emplace_back(function("method"));
 
     consume(Token_type::RIGHT_BRACE, "Expect '}' after class body!");
 
-    return std::make_shared<Class_stmt>(name, superclass, std::move(methods));
+    return ast.add(Class_stmt(name, superclass, ast.add_list(methods)));
 }
 
-std::shared_ptr<Stmt> Parser::var_declaration() {
-    std::shared_ptr<Token> name = consume(Token_type::IDENTIFIER,
-                                          "Expect variable name!");
+Stmt_id Parser::var_declaration() {
+    Token_id name = consume(Token_type::IDENTIFIER,
+                            "Expect variable name!");
 
-    std::shared_ptr<Expr> initializer = nullptr;
+    Expr_id initializer = NO_NODE;
     if (match(Token_type::EQUAL))
         initializer = expression();
 
     consume(Token_type::SEMICOLON, "Expect ';' after variable declaration!");
-    return std::make_shared<Var_stmt>(name, initializer);
+    return ast.add(Var_stmt(name, initializer));
 }
 
-std::shared_ptr<Stmt> Parser::statement() {
+Stmt_id Parser::statement() {
     if (match(Token_type::FOR))
         return for_statement();
     if (match(Token_type::IF))
@@ -207,231 +201,235 @@ std::shared_ptr<Stmt> Parser::statement() {
     if (match(Token_type::WHILE))
         return while_statement();
     if (match(Token_type::LEFT_BRACE))
-        return std::make_shared<Block_stmt>(block());
+        return ast.add(Block_stmt(block()));
     return expression_statement();
 }
 
-std::shared_ptr<Stmt> Parser::if_statement() {
+Stmt_id Parser::if_statement() {
     consume(Token_type::LEFT_PAREN, "Expect '(' after 'if'!");
-    std::shared_ptr<Expr> condition = expression();
+    Expr_id condition = expression();
     consume(Token_type::RIGHT_PAREN, "Expect ')' after if condition!");
 
-    std::shared_ptr<Stmt> then_branch = statement();
-    std::shared_ptr<Stmt> else_branch = nullptr;
+    Stmt_id then_branch = statement();
+    Stmt_id else_branch = NO_NODE;
     if (match(Token_type::ELSE))
         else_branch = statement();
 
-    return std::make_shared<If_stmt>(condition, then_branch, else_branch);
+    return ast.add(If_stmt(condition, then_branch, else_branch));
 }
 
-std::shared_ptr<Stmt> Parser::while_statement() {
+Stmt_id Parser::while_statement() {
     consume(Token_type::LEFT_PAREN, "Expect '(' after 'while'!");
-    std::shared_ptr<Expr> condition = expression();
+    Expr_id condition = expression();
     consume(Token_type::RIGHT_PAREN, "Expect ')' after condition!");
-    std::shared_ptr<Stmt> body = statement();
+    Stmt_id body = statement();
 
-    return std::make_shared<While_stmt>(condition, body);
+    return ast.add(While_stmt(condition, body));
 }
 
-std::shared_ptr<Stmt> Parser::for_statement() {
+Stmt_id Parser::for_statement() {
     consume(Token_type::LEFT_PAREN, "Expect '(' after 'for'!");
 
-    std::shared_ptr<Stmt> initializer;
+    Stmt_id initializer;
     if (match(Token_type::SEMICOLON))
-        initializer = nullptr;
+        initializer = NO_NODE;
     else if (match(Token_type::VAR))
         initializer = var_declaration();
     else
         initializer = expression_statement();
 
-    std::shared_ptr<Expr> condition = nullptr;
+    Expr_id condition = NO_NODE;
     if (!check(Token_type::SEMICOLON))
         condition = expression();
     consume(Token_type::SEMICOLON, "Expect ';' after loop condition!");
 
-    std::shared_ptr<Expr> increment = nullptr;
+    Expr_id increment = NO_NODE;
     if (!check(Token_type::RIGHT_PAREN))
         increment = expression();
     consume(Token_type::RIGHT_PAREN, "Expect ')' after 'for' clauses!");
 
-    std::shared_ptr<Stmt> body = statement();
+    Stmt_id body = statement();
 
-    if (increment != nullptr) {
-        std::list<std::shared_ptr<Stmt>> body_and_inc;
+    if (increment != NO_NODE) {
+        std::vector<Stmt_id> body_and_inc;
         body_and_inc.push_back(body);
-        body_and_inc.push_back(std::make_shared<Expression_stmt>(increment));
+        body_and_inc.push_back(ast.add(Expression_stmt(increment)));
 
-        body = std::make_shared<Block_stmt>(std::move(body_and_inc));
+        body = ast.add(Block_stmt(ast.add_list(body_and_inc)));
     }
 
-    if (condition == nullptr)
-        condition = std::make_shared<Literal_expr>(
-                    std::make_shared<Token>(Token_type::TRUE, "true", 0));
-    body = std::make_shared<While_stmt>(condition, body);
+    if (condition == NO_NODE)
+        condition = ast.add(Literal_expr(
+                    tokens.add(Token_type::TRUE, tokens.get_line(previous()),
+                               0, 0)));
+    body = ast.add(While_stmt(condition, body));
 
-    if (initializer != nullptr) {
-        std::list<std::shared_ptr<Stmt>> init_and_body;
+    if (initializer != NO_NODE) {
+        std::vector<Stmt_id> init_and_body;
         init_and_body.push_back(initializer);
         init_and_body.push_back(body);
 
-        body = std::make_shared<Block_stmt>(std::move(init_and_body));
+        body = ast.add(Block_stmt(ast.add_list(init_and_body)));
     }
 
-
     return body;
 }
 
-std::shared_ptr<Stmt> Parser::print_statement() {
-    std::shared_ptr<Expr> expr = expression();
+Stmt_id Parser::print_statement() {
+    Expr_id expr = expression();
     consume(Token_type::SEMICOLON, "Expect ';' after value!");
-    return std::make_shared<Print_stmt>(expr);
+    return ast.add(Print_stmt(expr));
 }
 
-std::shared_ptr<Stmt> Parser::return_statement() {
-    std::shared_ptr<Token> keyword = previous();
-    std::shared_ptr<Expr> value = nullptr;
+Stmt_id Parser::return_statement() {
+    Token_id keyword = previous();
+    Expr_id value = NO_NODE;
 
     if (!check(Token_type::SEMICOLON))
         value = expression();
 
     consume(Token_type::SEMICOLON, "Expect ';' after return value!");
-    return std::make_shared<Return_stmt>(keyword, value);
+    return ast.add(Return_stmt(keyword, value));
 }
 
-std::shared_ptr<Stmt> Parser::expression_statement() {
-    std::shared_ptr<Expr> expr = expression();
+Stmt_id Parser::expression_statement() {
+    Expr_id expr = expression();
     consume(Token_type::SEMICOLON, "Expect ';' after value!");
-    return std::make_shared<Expression_stmt>(expr);
+    return ast.add(Expression_stmt(expr));
 }
 
-std::list<std::shared_ptr<Stmt>> Parser::block() {
-    std::list<std::shared_ptr<Stmt>> statements;
+Id_list Parser::block() {
+    std::vector<Stmt_id> statements;
 
     while (!check(Token_type::RIGHT_BRACE) && !is_at_end())
         statements.emplace_back(declaration());
 
     consume(Token_type::RIGHT_BRACE, "Expect '}' after block!");
-    return statements;
+    return ast.add_list(statements);
 }
 
-std::shared_ptr<Expr> Parser::expression() {
+Expr_id Parser::expression() {
     return assignment();
 }
 
-std::shared_ptr<Expr> Parser::assignment() {
-    std::shared_ptr<Expr> expr = logical_or();
+Expr_id Parser::assignment() {
+    Expr_id expr = logical_or();
 
     if (match(Token_type::EQUAL)) {
-        std::shared_ptr<Token> equals = previous();
-        std::shared_ptr<Expr> value = assignment();
-
-        std::shared_ptr<Expr> assign = expr->make_assignment_expr(expr, value);
-        if (assign != nullptr)
-            return assign;
+        Token_id equals = previous();
+        Expr_id value = assignment();
+
+        if (expr_kind(expr) == Expr_kind::VARIABLE) {
+            Token_id name = ast.get<Variable_expr>(expr).get_name();
+            return ast.add(Assign_expr(name, value));
+        } else if (expr_kind(expr) == Expr_kind::GET) {
+            Get_expr& get = ast.get<Get_expr>(expr);
+            return ast.add(Set_expr(get.get_object(), get.get_name(), value));
+        }
         error(equals, "Invalid assignment target!");
     }
 
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::logical_or() {
-    std::shared_ptr<Expr> expr = logical_and();
+Expr_id Parser::logical_or() {
+    Expr_id expr = logical_and();
 
     while (match(Token_type::OR)) {
-        std::shared_ptr<Token> op = previous();
-        std::shared_ptr<Expr> right = logical_and();
-        expr = std::make_shared<Logical_expr>(expr, right, op);
+        Token_id op = previous();
+        Expr_id right = logical_and();
+        expr = ast.add(Logical_expr(expr, right, op));
     }
 
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::logical_and() {
-    std::shared_ptr<Expr> expr = equality();
+Expr_id Parser::logical_and() {
+    Expr_id expr = equality();
 
     while (match(Token_type::AND)) {
-        std::shared_ptr<Token> op = previous();
-        std::shared_ptr<Expr> right = equality();
-        expr = std::make_shared<Logical_expr>(expr, right, op);
+        Token_id op = previous();
+        Expr_id right = equality();
+        expr = ast.add(Logical_expr(expr, right, op));
     }
 
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::equality() {
-    std::shared_ptr<Expr> expr = comparison();
+Expr_id Parser::equality() {
+    Expr_id expr = comparison();
 
     while (match(Token_type::BANG_EQUAL)
            || match(Token_type::EQUAL_EQUAL)) {
-        std::shared_ptr<Token> op = previous();
-        std::shared_ptr<Expr> right = comparison();
-        expr = std::make_shared<Binary_expr>(expr, right, op);
+        Token_id op = previous();
+        Expr_id right = comparison();
+        expr = ast.add(Binary_expr(expr, right, op));
     }
 
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::comparison() {
-    std::shared_ptr<Expr> expr = addition();
+Expr_id Parser::comparison() {
+    Expr_id expr = addition();
 
     while (match(Token_type::GREATER)
            || match(Token_type::GREATER_EQUAL)
            || match(Token_type::LESS)
            || match(Token_type::LESS_EQUAL)) {
-        std::shared_ptr<Token> op = previous();
-        std::shared_ptr<Expr> right = addition();
-        expr = std::make_shared<Binary_expr>(expr, right, op);
+        Token_id op = previous();
+        Expr_id right = addition();
+        expr = ast.add(Binary_expr(expr, right, op));
     }
 
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::addition() {
-    std::shared_ptr<Expr> expr = multiplication();
+Expr_id Parser::addition() {
+    Expr_id expr = multiplication();
 
     while (match(Token_type::MINUS)
            || match(Token_type::PLUS)) {
-        std::shared_ptr<Token> op = previous();
-        std::shared_ptr<Expr> right = multiplication();
-        expr = std::make_shared<Binary_expr>(expr, right, op);
+        Token_id op = previous();
+        Expr_id right = multiplication();
+        expr = ast.add(Binary_expr(expr, right, op));
     }
 
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::multiplication() {
-    std::shared_ptr<Expr> expr = unary();
+Expr_id Parser::multiplication() {
+    Expr_id expr = unary();
 
     while (match(Token_type::SLASH)
            || match(Token_type::STAR)) {
-        std::shared_ptr<Token> op = previous();
-        std::shared_ptr<Expr> right = unary();
-        expr = std::make_shared<Binary_expr>(expr, right, op);
+        Token_id op = previous();
+        Expr_id right = unary();
+        expr = ast.add(Binary_expr(expr, right, op));
     }
 
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::unary() {
+Expr_id Parser::unary() {
     if (match(Token_type::BANG)
         || match(Token_type::MINUS)) {
-        std::shared_ptr<Token> op = previous();
-        std::shared_ptr<Expr> right = unary();
-        return std::make_shared<Unary_expr>(right, op);
+        Token_id op = previous();
+        Expr_id right = unary();
+        return ast.add(Unary_expr(right, op));
     }
 
     return call();
 }
 
-std::shared_ptr<Expr> Parser::call() {
-    std::shared_ptr<Expr> expr = primary();
+Expr_id Parser::call() {
+    Expr_id expr = primary();
     while (true) {
         if (match(Token_type::LEFT_PAREN))
             expr = finish_call(expr);
         else if (match(Token_type::DOT)) {
-            std::shared_ptr<Token> name = consume(Token_type::IDENTIFIER,
-                                                  "Expect property name after '.'");
-            expr = std::make_shared<Get_expr>(expr, name);
+            Token_id name = consume(Token_type::IDENTIFIER,
+                                    "Expect property name after '.'");
+            expr = ast.add(Get_expr(expr, name));
         }
         else
             break;
@@ -440,37 +438,38 @@ std::shared_ptr<Expr> Parser::call() {
     return expr;
 }
 
-std::shared_ptr<Expr> Parser::primary() {
+Expr_id Parser::primary() {
     if (match(Token_type::FALSE)
         || match(Token_type::TRUE)
         || match(Token_type::NIL)
         || match(Token_type::STRING)
         || match(Token_type::NUMBER))
-        return std::make_shared<Literal_expr>(previous());
+        return ast.add(Literal_expr(previous()));
     else if (match(Token_type::SUPER)) {
-        std::shared_ptr<Token> keyword = previous();
+        Token_id keyword = previous();
         consume(Token_type::DOT, "Expect '.' after 'super'!");
-        std::shared_ptr<Token> method = consume(Token_type::IDENTIFIER,
-                                                "Expect superclass method name!");
-        return std::make_shared<Super_expr>(keyword, method);
+        Token_id method = consume(Token_type::IDENTIFIER,
+                                  "Expect superclass method name!");
+        return ast.add(Super_expr(keyword, method));
     }
     else if (match(Token_type::THIS))
-        return std::make_shared<This_expr>(previous());
+        return ast.add(This_expr(previous()));
     else if (match(Token_type::IDENTIFIER))
-        return std::make_shared<Variable_expr>(previous());
+        return ast.add(Variable_expr(previous()));
     else if (match(Token_type::FUN))
         return lambda();
     else if (match(Token_type::LEFT_PAREN)) {
-        std::shared_ptr<Expr> expr = expression();
+        Expr_id expr = expression();
         consume(Token_type::RIGHT_PAREN, "Expect ')' after expression!");
-        return std::make_shared<Grouping_expr>(expr);
+        return ast.add(Grouping_expr(expr));
     } else
         throw error(peek(), "Expect expression!");
 }
 
-// Parse the token stream and return the root of the AST.
-std::list<std::shared_ptr<Stmt>>& Parser::parse() {
+// Parse the token stream into the arena, returns the top level statements.
+Id_list Parser::parse() {
+    std::vector<Stmt_id> statements;
     while (!is_at_end())
         statements.emplace_back(declaration());
-    return statements;
+    return ast.add_list(statements);
 }
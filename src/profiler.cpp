@@ -0,0 +1,64 @@
+#include "profiler.h"
+
+// Profiler constructor. The shadow stack starts with the top level script.
+Profiler::Profiler(std::chrono::microseconds interval) : interval(interval) {
+    frames.push_back(Frame{"<script>", 0});
+}
+
+// Profiler destructor, stops the sampling thread if it still runs.
+Profiler::~Profiler() {
+    stop();
+}
+
+// Start the sampling thread.
+void Profiler::start() {
+    stopping = false;
+    sampler = std::thread(&Profiler::tick, this);
+}
+
+// Stop the sampling thread.
+void Profiler::stop() {
+    if (!sampler.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake_up.notify_one();
+    sampler.join();
+}
+
+// Body of the sampling thread, ticks once per interval until stopped.
+void Profiler::tick() {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto next = std::chrono::steady_clock::now() + interval;
+    while (!wake_up.wait_until(lock, next, [this]() { return stopping; })) {
+        ticks.fetch_add(1, std::memory_order_relaxed);
+        next += interval;
+    }
+}
+
+// Record a sample of the given call stack, weighted by the ticks since the
+// last one.
+void Profiler::record(const std::vector<Frame>& stack) {
+    uint32_t weight = ticks.exchange(0, std::memory_order_relaxed);
+    if (weight == 0)
+        return;
+
+    std::string folded;
+    for (const Frame& frame : stack) {
+        if (!folded.empty())
+            folded += ';';
+        folded += frame.name;
+        folded += ':';
+        folded += std::to_string(frame.line);
+    }
+    samples[folded] += weight;
+}
+
+// Write the folded stacks, one per line.
+void Profiler::write(std::ostream& out) {
+    for (auto& sample : samples)
+        out << sample.first << ' ' << sample.second << '\n';
+}
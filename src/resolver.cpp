@@ -1,244 +1,316 @@
 #include "resolver.h"
 #include "error_handling.h"
-#include "interpreter.h"
 
-// Resolve a list of statements.
-void Resolver::resolve(std::list<std::shared_ptr<Stmt>>& statements) {
-    for (auto stmt : statements)
-        resolve(stmt);
+// Resolve a list of statements. The outermost call adds the capture lists
+// once it is done.
+void Resolver::resolve(Id_list statements) {
+    bool outermost = scopes.empty();
+    for (Stmt_id stmt : ast.get_list(statements))
+        resolve_stmt(stmt);
+    if (!outermost)
+        return;
+
+    for (auto& [function, captures] : function_captures)
+        function->set_captures(ast.add_list(captures));
+    for (auto& [lambda, captures] : lambda_captures)
+        lambda->set_captures(ast.add_list(captures));
+    function_captures.clear();
+    lambda_captures.clear();
 }
 
 // Resolve a single statement.
-void Resolver::resolve(std::shared_ptr<Stmt> stmt) {
-    stmt->accept(shared_from_this());
+void Resolver::resolve_stmt(Stmt_id stmt) {
+    ast.accept_stmt(stmt, *this);
 }
 
 // Resolve a single expression.
-void Resolver::resolve(std::shared_ptr<Expr> expr) {
-    expr->accept(shared_from_this());
+void Resolver::resolve_expr(Expr_id expr) {
+    ast.accept_expr(expr, *this);
+}
+
+// Create a new scope. Its bindings take the next slots of the current
+// function's frame.
+void Resolver::begin_scope() {
+    scopes.push_back(Scope());
+    scopes.back().function = frames.size() - 1;
+    scopes.back().first_slot = frames.back().slots;
+}
+
+// Exit a scope, its slots are free again.
+bool Resolver::end_scope() {
+    bool captured = scopes.back().captured;
+    frames.back().slots = scopes.back().first_slot;
+    scopes.pop_back();
+    return captured;
+}
+
+// Start resolving a function body, in a frame of its own.
+void Resolver::begin_function() {
+    frames.push_back(Frame());
+    begin_scope();
+}
+
+// Finish resolving a function body, returns its captures.
+std::vector<uint32_t> Resolver::end_function() {
+    end_scope();
+    std::vector<uint32_t> captures = std::move(frames.back().captures);
+    frames.pop_back();
+    return captures;
+}
+
+// Find or add a capture of a function, returns its index.
+uint32_t Resolver::add_capture(size_t function, uint32_t index, bool is_local) {
+    std::vector<uint32_t>& captures = frames[function].captures;
+    uint32_t capture = encode_capture(index, is_local);
+    for (uint32_t i = 0; i < captures.size(); i++) {
+        if (captures[i] == capture)
+            return i;
+    }
+
+    captures.push_back(capture);
+    return captures.size() - 1;
 }
 
 // Declare a binding.
-void Resolver::declare(std::shared_ptr<Token> name) {
+void Resolver::declare(Token_id name) {
     if (scopes.empty())
         return;
 
-    scope& in_scope = scopes.back();
-    if (in_scope.find(name->get_lexeme()) != in_scope.end())
-        error_handling::error(name, "Already a variable with this name in"
-                              " this scope!");
+    auto& in_scope = scopes.back().bindings;
+    if (in_scope.find(tokens.get_lexeme(name)) != in_scope.end())
+        errors.error(tokens, name, "Already a variable with this name"
+                              " in this scope!");
 
-    in_scope[name->get_lexeme()] = false;
+    // Slots are handed out in declaration order, which is also the order
+    // in which the engines push the variables.
+    uint32_t slot = frames.back().slots++;
+    in_scope[tokens.get_lexeme(name)] = Binding{false, slot, name};
 }
 
 // Define a binding.
-void Resolver::define(std::shared_ptr<Token> name) {
+void Resolver::define(Token_id name) {
     if (scopes.empty())
         return;
 
-    scope& in_scope = scopes.back();
-    in_scope[name->get_lexeme()] = true;
+    scopes.back().bindings[tokens.get_lexeme(name)].defined = true;
 }
 
-// Resolve a local variable.
-void Resolver::resolve_local(std::shared_ptr<Expr> expr,
-                             std::shared_ptr<Token> name) {
+// Resolve a local variable. A variable of an enclosing function is captured
+// by every function from the declaring one down to the current one.
+void Resolver::resolve_local(Resolution& resolution, std::string_view name) {
     for (int i = scopes.size() - 1; i >= 0; i--) {
-        if (scopes.at(i).find(name->get_lexeme()) != scopes.at(i).end()) {
-            interpreter->resolve(expr, scopes.size() - 1 - i);
+        auto binding = scopes[i].bindings.find(name);
+        if (binding == scopes[i].bindings.end())
+            continue;
+
+        size_t function = scopes[i].function;
+        uint32_t slot = binding->second.slot;
+        if (function == frames.size() - 1) {
+            resolution.resolve(Access::LOCAL, slot, binding->second.declaration);
             return;
         }
+
+        scopes[i].captured = true;
+        uint32_t index = add_capture(function + 1, slot, true);
+        for (size_t inner = function + 2; inner < frames.size(); inner++)
+            index = add_capture(inner, index, false);
+        resolution.resolve(Access::UPVALUE, index, binding->second.declaration);
+        return;
     }
 }
 
 // Resolve a function.
-void Resolver::resolve_function(std::shared_ptr<Function_stmt> function,
+void Resolver::resolve_function(Function_stmt& function,
                                 Function_type type) {
     Function_type enclosing_function = current_function;
     current_function = type;
 
-    begin_scope();
-    for (auto param : function->get_params()) {
+    begin_function();
+    // Methods get "this" in slot 0 of their frame, before the parameters.
+    if (type == Function_type::METHOD || type == Function_type::INITIALIZER)
+        scopes.back().bindings["this"] = Binding{true, frames.back().slots++,
+                                                 NO_TOKEN};
+    for (Token_id param : ast.get_list(function.get_params())) {
         declare(param);
         define(param);
     }
-    resolve(function->get_body());
-    end_scope();
+    resolve(function.get_body());
+    function_captures.emplace_back(&function, end_function());
     current_function = enclosing_function;
 }
 
 // Resolve a lambda.
-void Resolver::resolve_lambda(std::shared_ptr<Lambda_expr> lambda) {
-    begin_scope();
-    for (auto param : lambda->get_params()) {
+void Resolver::resolve_lambda(Lambda_expr& lambda) {
+    begin_function();
+    for (Token_id param : ast.get_list(lambda.get_params())) {
         declare(param);
         define(param);
     }
-    resolve(lambda->get_body());
-    end_scope();
+    resolve(lambda.get_body());
+    lambda_captures.emplace_back(&lambda, end_function());
 }
 
 // Overridden visitor methods.
 
-void Resolver::visit_block_stmt(std::shared_ptr<Block_stmt> stmt) {
+void Resolver::visit_block_stmt(Block_stmt& stmt) {
     begin_scope();
-    resolve(stmt->get_statements());
-    end_scope();
+    resolve(stmt.get_statements());
+    stmt.set_captured(end_scope());
 }
 
-void Resolver::visit_var_stmt(std::shared_ptr<Var_stmt> stmt) {
-    declare(stmt->get_name());
-    if (stmt->get_initializer() != nullptr)
-        resolve(stmt->get_initializer());
-    define(stmt->get_name());
+void Resolver::visit_var_stmt(Var_stmt& stmt) {
+    declare(stmt.get_name());
+    if (stmt.get_initializer() != NO_NODE)
+        resolve_expr(stmt.get_initializer());
+    define(stmt.get_name());
 }
 
-void Resolver::visit_function_stmt(std::shared_ptr<Function_stmt> stmt) {
-    declare(stmt->get_name());
-    define(stmt->get_name());
+void Resolver::visit_function_stmt(Function_stmt& stmt) {
+    declare(stmt.get_name());
+    define(stmt.get_name());
 
     resolve_function(stmt, Function_type::FUNCTION);
 }
 
-void Resolver::visit_expression_stmt(std::shared_ptr<Expression_stmt> stmt) {
-    resolve(stmt->get_expr());
+void Resolver::visit_expression_stmt(Expression_stmt& stmt) {
+    resolve_expr(stmt.get_expr());
 }
 
-void Resolver::visit_if_stmt(std::shared_ptr<If_stmt> stmt) {
-    resolve(stmt->get_condition());
-    resolve(stmt->get_then_branch());
-    if (stmt->get_else_branch() != nullptr)
-        resolve(stmt->get_else_branch());
+void Resolver::visit_if_stmt(If_stmt& stmt) {
+    resolve_expr(stmt.get_condition());
+    resolve_stmt(stmt.get_then_branch());
+    if (stmt.get_else_branch() != NO_NODE)
+        resolve_stmt(stmt.get_else_branch());
 }
 
-void Resolver::visit_print_stmt(std::shared_ptr<Print_stmt> stmt) {
-    resolve(stmt->get_expr());
+void Resolver::visit_print_stmt(Print_stmt& stmt) {
+    resolve_expr(stmt.get_expr());
 }
 
-void Resolver::visit_return_stmt(std::shared_ptr<Return_stmt> stmt) {
+void Resolver::visit_return_stmt(Return_stmt& stmt) {
     if (current_function == Function_type::NONE)
-        error_handling::error(stmt->get_keyword(),
+        errors.error(tokens, stmt.get_keyword(),
                               "Can't return from top-level code!");
 
-    if (stmt->get_value() != nullptr) {
+    if (stmt.get_value() != NO_NODE) {
         if (current_function == Function_type::INITIALIZER)
-            error_handling::error(stmt->get_keyword(),
+            errors.error(tokens, stmt.get_keyword(),
                                   "Can't return a value from an initializer!");
-        resolve(stmt->get_value());
+        resolve_expr(stmt.get_value());
     }
 }
 
-void Resolver::visit_while_stmt(std::shared_ptr<While_stmt> stmt) {
-    resolve(stmt->get_condition());
-    resolve(stmt->get_body());
+void Resolver::visit_while_stmt(While_stmt& stmt) {
+    resolve_expr(stmt.get_condition());
+    resolve_stmt(stmt.get_body());
 }
 
-void Resolver::visit_class_stmt(std::shared_ptr<Class_stmt> stmt) {
+void Resolver::visit_class_stmt(Class_stmt& stmt) {
     Class_type enclosing_class = current_class;
     current_class = Class_type::CLASS;
 
-    declare(stmt->get_name());
-    define(stmt->get_name());
-
-    if (stmt->get_superclass()
-        && (stmt->get_name()->get_lexeme()
-            == stmt->get_superclass()->get_name()->get_lexeme()))
-        error_handling::error(stmt->get_superclass()->get_name(),
-                              "A class can't inherit from itself!");
-
-    if (stmt->get_superclass())
-        resolve(stmt->get_superclass());
+    declare(stmt.get_name());
+    define(stmt.get_name());
+
+    Expr_id superclass = stmt.get_superclass();
+    if (superclass != NO_NODE) {
+        Token_id superclass_name = ast.get<Variable_expr>(superclass).get_name();
+        if (tokens.get_lexeme(stmt.get_name())
+            == tokens.get_lexeme(superclass_name))
+            errors.error(tokens, superclass_name,
+                                  "A class can't inherit from itself!");
+        resolve_expr(superclass);
+    }
 
-    if (stmt->get_superclass()) {
+    // The superclass is a local of the scope the methods are declared in,
+    // so they capture it.
+    if (superclass != NO_NODE) {
         begin_scope();
-        auto& top = scopes.back();
-        top["super"] = true;
+        scopes.back().bindings["super"] = Binding{true, frames.back().slots++,
+                                                  NO_TOKEN};
     }
 
-    begin_scope();
-    auto& top_scope = scopes.back();
-    top_scope["this"] = true;
-
-    for (auto method : stmt->get_methods()) {
+    for (Stmt_id id : ast.get_list(stmt.get_methods())) {
+        Function_stmt& method = ast.get<Function_stmt>(id);
         Function_type declaration = Function_type::METHOD;
-        if (method->get_name()->get_lexeme() == "init")
+        if (tokens.get_lexeme(method.get_name()) == "init")
             declaration = Function_type::INITIALIZER;
         resolve_function(method, declaration);
     }
 
-    end_scope();
-
-    if (stmt->get_superclass())
+    if (superclass != NO_NODE)
         end_scope();
 
     current_class = enclosing_class;
 }
 
-void Resolver::visit_variable_expr(std::shared_ptr<Variable_expr> expr) {
+void Resolver::visit_variable_expr(Variable_expr& expr) {
     if (!scopes.empty()
-            && scopes.back().find(expr->get_name()->get_lexeme()) != scopes.back().end()
-            && scopes.back()[expr->get_name()->get_lexeme()] == false)
-        error_handling::error(expr->get_name(), "Can't read local variable"
-                              " in its own initializer!");
+            && scopes.back().bindings.find(tokens.get_lexeme(expr.get_name()))
+               != scopes.back().bindings.end()
+            && !scopes.back().bindings[tokens.get_lexeme(expr.get_name())].defined)
+        errors.error(tokens, expr.get_name(), "Can't read local"
+                              " variable in its own initializer!");
 
-    resolve_local(expr, expr->get_name());
+    resolve_local(expr, tokens.get_lexeme(expr.get_name()));
 }
 
-void Resolver::visit_assign_expr(std::shared_ptr<Assign_expr> expr) {
-    resolve(expr->get_value());
-    resolve_local(expr, expr->get_name());
+void Resolver::visit_assign_expr(Assign_expr& expr) {
+    resolve_expr(expr.get_value());
+    resolve_local(expr, tokens.get_lexeme(expr.get_name()));
 }
 
-void Resolver::visit_binary_expr(std::shared_ptr<Binary_expr> expr) {
-    resolve(expr->get_left());
-    resolve(expr->get_right());
+void Resolver::visit_binary_expr(Binary_expr& expr) {
+    resolve_expr(expr.get_left());
+    resolve_expr(expr.get_right());
 }
 
-void Resolver::visit_call_expr(std::shared_ptr<Call_expr> expr) {
-    resolve(expr->get_callee());
+void Resolver::visit_call_expr(Call_expr& expr) {
+    resolve_expr(expr.get_callee());
 
-    for (auto argument : expr->get_arguments())
-        resolve(argument);
+    for (Expr_id argument : ast.get_list(expr.get_arguments()))
+        resolve_expr(argument);
 }
 
-void Resolver::visit_grouping_expr(std::shared_ptr<Grouping_expr> expr) {
-    resolve(expr->get_expr());
+void Resolver::visit_grouping_expr(Grouping_expr& expr) {
+    resolve_expr(expr.get_expr());
 }
 
-void Resolver::visit_literal_expr(std::shared_ptr<Literal_expr> expr) {
+void Resolver::visit_literal_expr(Literal_expr& expr) {
     return;
 }
 
-void Resolver::visit_logical_expr(std::shared_ptr<Logical_expr> expr) {
-    resolve(expr->get_left());
-    resolve(expr->get_right());
+void Resolver::visit_logical_expr(Logical_expr& expr) {
+    resolve_expr(expr.get_left());
+    resolve_expr(expr.get_right());
 }
 
-void Resolver::visit_unary_expr(std::shared_ptr<Unary_expr> expr) {
-    resolve(expr->get_right());
+void Resolver::visit_unary_expr(Unary_expr& expr) {
+    resolve_expr(expr.get_right());
 }
 
-void Resolver::visit_lambda_expr(std::shared_ptr<Lambda_expr> expr) {
+void Resolver::visit_lambda_expr(Lambda_expr& expr) {
     resolve_lambda(expr);
 }
 
-void Resolver::visit_get_expr(std::shared_ptr<Get_expr> expr) {
-    resolve(expr->get_object());
+void Resolver::visit_get_expr(Get_expr& expr) {
+    resolve_expr(expr.get_object());
 }
 
-void Resolver::visit_set_expr(std::shared_ptr<Set_expr> expr) {
-    resolve(expr->get_value());
-    resolve(expr->get_object());
+void Resolver::visit_set_expr(Set_expr& expr) {
+    resolve_expr(expr.get_value());
+    resolve_expr(expr.get_object());
 }
 
-void Resolver::visit_this_expr(std::shared_ptr<This_expr> expr) {
+void Resolver::visit_this_expr(This_expr& expr) {
     if (current_class == Class_type::NONE)
-        error_handling::error(expr->get_keyword(),
+        errors.error(tokens, expr.get_keyword(),
                               "Can't use 'this' outside of a class!");
 
-    resolve_local(expr, expr->get_keyword());
+    resolve_local(expr, "this");
 }
 
-void Resolver::visit_super_expr(std::shared_ptr<Super_expr> expr) {
-    resolve_local(expr, expr->get_keyword());
+void Resolver::visit_super_expr(Super_expr& expr) {
+    resolve_local(expr, "super");
+    resolve_local(expr.get_receiver(), "this");
 }
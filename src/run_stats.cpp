@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <iomanip>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "run_stats.h"
+
+// CPU time used by the calling thread, so that isolates running on other
+// threads aren't counted.
+static double thread_cpu_seconds() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+// Peak resident set size of the process.
+static long peak_rss_kib() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // ru_maxrss is in KiB on Linux.
+    return usage.ru_maxrss;
+}
+
+// Start measuring a phase.
+void Run_stats::begin(std::string name) {
+    phases.push_back(Phase_stats());
+    phases.back().name = std::move(name);
+
+    objects_start = heap.get_stats().objects_by_type;
+    cpu_start = thread_cpu_seconds();
+    wall_start = std::chrono::steady_clock::now();
+}
+
+// Finish measuring the current phase.
+void Run_stats::end() {
+    Phase_stats& phase = phases.back();
+    phase.wall_seconds = std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - wall_start).count();
+    phase.cpu_seconds = thread_cpu_seconds() - cpu_start;
+
+    phase.tokens = tokens.size();
+    phase.nodes = ast.node_count();
+    const auto& objects = heap.get_stats().objects_by_type;
+    for (size_t type = 0; type < OBJ_TYPE_COUNT; type++)
+        phase.objects[type] = objects[type] - objects_start[type];
+    phase.peak_rss_kib = peak_rss_kib();
+}
+
+// Sum of all the phases. The sizes are the ones at the end of the run, and
+// the objects include the ones the engines allocate between the phases
+// (e.g. their globals).
+Phase_stats Run_stats::total() {
+    Phase_stats total;
+    total.name = "total";
+    for (const Phase_stats& phase : phases) {
+        total.wall_seconds += phase.wall_seconds;
+        total.cpu_seconds += phase.cpu_seconds;
+    }
+
+    total.objects = heap.get_stats().objects_by_type;
+    total.tokens = tokens.size();
+    total.nodes = ast.node_count();
+    total.peak_rss_kib = peak_rss_kib();
+    return total;
+}
+
+// Print a table with a row per phase. Only the kinds of objects which were
+// allocated get a column.
+void Run_stats::write_text(std::ostream& out) {
+    Phase_stats sum = total();
+    std::vector<size_t> types;
+    for (size_t type = 0; type < OBJ_TYPE_COUNT; type++) {
+        if (sum.objects[type] > 0)
+            types.push_back(type);
+    }
+
+    // Columns are as wide as their header, or 10 characters.
+    auto width = [](const char* header) {
+        return std::max<int>(std::char_traits<char>::length(header), 10);
+    };
+
+    out << std::left << std::setw(12) << "phase" << std::right
+        << ' ' << std::setw(10) << "wall ms"
+        << ' ' << std::setw(10) << "cpu ms"
+        << ' ' << std::setw(10) << "tokens"
+        << ' ' << std::setw(10) << "ast nodes";
+    for (size_t type : types) {
+        const char* name = obj_type_name(static_cast<Obj_type>(type));
+        out << ' ' << std::setw(width(name)) << name;
+    }
+    out << ' ' << std::setw(12) << "peak rss KiB" << '\n';
+
+    std::ios::fmtflags flags = out.flags();
+    out << std::fixed << std::setprecision(3);
+
+    phases.push_back(sum);
+    for (const Phase_stats& phase : phases) {
+        out << std::left << std::setw(12) << phase.name << std::right
+            << ' ' << std::setw(10) << phase.wall_seconds * 1000.
+            << ' ' << std::setw(10) << phase.cpu_seconds * 1000.
+            << ' ' << std::setw(10) << phase.tokens
+            << ' ' << std::setw(10) << phase.nodes;
+        for (size_t type : types) {
+            out << ' ' << std::setw(width(obj_type_name(static_cast<Obj_type>(type))))
+                << phase.objects[type];
+        }
+        out << ' ' << std::setw(12) << phase.peak_rss_kib << '\n';
+    }
+    phases.pop_back();
+
+    out.flags(flags);
+}
+
+// Print a JSON object with an entry per phase, and their sum.
+void Run_stats::write_json(std::ostream& out) {
+    auto write_phase = [&out](const Phase_stats& phase) {
+        out << "{\"name\": \"" << phase.name << "\""
+            << ", \"wall_ms\": " << phase.wall_seconds * 1000.
+            << ", \"cpu_ms\": " << phase.cpu_seconds * 1000.
+            << ", \"tokens\": " << phase.tokens
+            << ", \"ast_nodes\": " << phase.nodes
+            << ", \"objects\": {";
+        for (size_t type = 0; type < OBJ_TYPE_COUNT; type++) {
+            out << (type == 0 ? "" : ", ")
+                << '"' << obj_type_name(static_cast<Obj_type>(type)) << "\": "
+                << phase.objects[type];
+        }
+        out << "}, \"peak_rss_kib\": " << phase.peak_rss_kib << '}';
+    };
+
+    out << "{\"phases\": [";
+    for (size_t phase = 0; phase < phases.size(); phase++) {
+        out << (phase == 0 ? "\n  " : ",\n  ");
+        write_phase(phases[phase]);
+    }
+    out << "],\n \"total\": ";
+    write_phase(total());
+    out << "}\n";
+}
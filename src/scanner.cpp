@@ -1,3 +1,5 @@
+#include <charconv>
+
 #include "scanner.h"
 #include "error_handling.h"
 
@@ -21,145 +23,137 @@ const Scanner::keywords_map Scanner::keywords = {
     {"while", Token_type::WHILE}
 };
 
-// Scanner constructor. Opens the input stream and checks the size of the
-// source file.
-Scanner::Scanner(std::string source)
-    : source(source), current(0U), line(1U) {
-    filestream.open(source);
-    if (!filestream.is_open()) {
-        error_handling::had_error = true;
-        error_handling::error(line, "Input file not opened correctly!");
-        exit(1);
-    }
-
-    // Check the source file size.
-    struct stat stat_buf;
-    int rc = stat(source.c_str(), &stat_buf);
-    source_size = rc == 0 ? stat_buf.st_size - 1 : 0U;
-}
-
-// Whether the next character in the input stream matches the expected.
-bool Scanner::match(char expected) {
-    if (is_at_end())
-        return false;
-    if (static_cast<char>(filestream.peek()) != expected)
-        return false;
-
-    return true;
-}
+// Scanner constructor.
+Scanner::Scanner(std::string_view source, Heap& heap,
+                 error_handling::Reporter& errors)
+    : source(source), tokens(source), start(source.data()), current(source.data()),
+      end(source.data() + source.size()), line(1U), heap(heap), errors(errors) {}
 
 // Helper method which recognizes string literals.
 void Scanner::string_lit() {
-    std::string lexeme = "";
-
-    // Munch the characters until the end of the current line.
+    // Munch the characters until the closing ".
     while (!match('"') && !is_at_end()) {
         if (match('\n'))
             line++;
-        lexeme.push_back(advance());
+        advance();
     }
 
     // Unterminated string.
     if (is_at_end()) {
-        error_handling::error(line, "Unterminated string!");
+        errors.error(line, "Unterminated string!");
         return;
     }
 
     // The closing ".
     advance();
 
-    add_token(Token_type::STRING, lexeme);
+    // The lexeme of a string literal doesn't include the quotes.
+    std::string_view contents(start + 1, length() - 2);
+    tokens.add_string(Token_type::STRING, line, offset() + 1, length() - 2,
+                      intern(contents));
 }
 
 // Helper method which recognizes number literals.
 void Scanner::num_lit() {
-    std::string lexeme = "";
-
     // Munch the digits.
-    while (is_digit(static_cast<char>(filestream.peek())))
-        lexeme.push_back(advance());
+    while (is_digit(peek()))
+        advance();
 
     // Look for a fractional part.
     if (match('.')) {
         // Consume the "."
-        lexeme.push_back(advance());
+        advance();
 
         // Munch the fractional part.
-        while (is_digit(static_cast<char>(filestream.peek())))
-            lexeme.push_back(advance());
+        while (is_digit(peek()))
+            advance();
     }
 
-    add_token(Token_type::NUMBER, lexeme, atof(lexeme.c_str()));
+    // The lexeme is only digits and a dot, so it can't be out of range or
+    // malformed.
+    double value;
+    std::from_chars(start, current, value);
+    tokens.add_number(line, offset(), length(), value);
 }
 
 // Helper method which recognizes keywords and identifiers.
 void Scanner::identifier() {
-    std::string lexeme = "";
-    // Munch the first character (which mustn't be a digit).
-    lexeme.push_back(advance());
-
-    // Munch the characters.
-    while (is_alphanum(static_cast<char>(filestream.peek())))
-        lexeme.push_back(advance());
+    // Munch the characters. The first one has already been checked not to
+    // be a digit.
+    while (is_alphanum(peek()))
+        advance();
 
     // If this lexeme matches a keyword, set the matching token type.
-    auto type = keywords.find(lexeme);
+    auto type = keywords.find(lexeme());
     if (type == keywords.end())
-        add_token(Token_type::IDENTIFIER, lexeme);
+        tokens.add_string(Token_type::IDENTIFIER, line, offset(), length(),
+                          intern(lexeme()));
+    else if (type->second == Token_type::THIS
+             || type->second == Token_type::SUPER)
+        tokens.add_string(type->second, line, offset(), length(),
+                          intern(lexeme()));
     else
-        add_token(type->second, lexeme);
+        add_token(type->second);
+}
+
+// Intern a lexeme and pin it for the whole run.
+String* Scanner::intern(std::string_view lexeme) {
+    String* string = heap.intern(lexeme);
+    heap.pin(string);
+    return string;
 }
 
 // Helper method which extracts one token from the source file.
 void Scanner::scan_token() {
     // Munch the first character.
+    start = current;
     char c = advance();
 
     switch (c) {
-    case '(': add_token(Token_type::LEFT_PAREN, "("); break;
-    case ')': add_token(Token_type::RIGHT_PAREN, ")"); break;
-    case '{': add_token(Token_type::LEFT_BRACE, "{"); break;
-    case '}': add_token(Token_type::RIGHT_BRACE, "}"); break;
-    case ',': add_token(Token_type::COMMA, ","); break;
-    case '.': add_token(Token_type::DOT, "."); break;
-    case '-': add_token(Token_type::MINUS, "-"); break;
-    case '+': add_token(Token_type::PLUS, "+"); break;
-    case ';': add_token(Token_type::SEMICOLON, ";"); break;
-    case '*': add_token(Token_type::STAR, "*"); break;
+    case '(': add_token(Token_type::LEFT_PAREN); break;
+    case ')': add_token(Token_type::RIGHT_PAREN); break;
+    case '{': add_token(Token_type::LEFT_BRACE); break;
+    case '}': add_token(Token_type::RIGHT_BRACE); break;
+    case ',': add_token(Token_type::COMMA); break;
+    case '.': add_token(Token_type::DOT); break;
+    case '-': add_token(Token_type::MINUS); break;
+    case '+': add_token(Token_type::PLUS); break;
+    case ';': add_token(Token_type::SEMICOLON); break;
+    case '*': add_token(Token_type::STAR); break;
     case '!':
         if (match('=')) {
             advance();
-            add_token(Token_type::BANG_EQUAL, "!=");
+            add_token(Token_type::BANG_EQUAL);
         } else
-            add_token(Token_type::BANG, "!");
+            add_token(Token_type::BANG);
         break;
     case '=':
         if (match('=')) {
             advance();
-            add_token(Token_type::EQUAL_EQUAL, "==");
+            add_token(Token_type::EQUAL_EQUAL);
         } else
-            add_token(Token_type::EQUAL, "=");
+            add_token(Token_type::EQUAL);
         break;
     case '<':
         if (match('=')) {
             advance();
-            add_token(Token_type::LESS_EQUAL, "<=");
+            add_token(Token_type::LESS_EQUAL);
         } else
-            add_token(Token_type::LESS, "<");
+            add_token(Token_type::LESS);
         break;
     case '>':
         if (match('=')) {
             advance();
-            add_token(Token_type::GREATER_EQUAL, ">=");
+            add_token(Token_type::GREATER_EQUAL);
         } else
-            add_token(Token_type::GREATER, ">");
+            add_token(Token_type::GREATER);
         break;
     case '/':
         if (match('/')) {
             while(!match('\n') && !is_at_end())
                 advance();
         } else
-            add_token(Token_type::SLASH, "/");
+            add_token(Token_type::SLASH);
         break;
     case '\n': line++; break;
     case ' ':
@@ -168,25 +162,25 @@ void Scanner::scan_token() {
         // Ignore whitespace.
         break;
     case '"': string_lit(); break;
-    case '0' ... '9': rollback(); num_lit(); break;
+    case '0' ... '9': num_lit(); break;
     case 'a' ... 'z':
     case 'A' ... 'Z':
     case '_':
-        rollback();
         identifier();
         break;
-    default: error_handling::error(line, "Unexpected character!"); break;
+    default: errors.error(line, "Unexpected character!"); break;
     }
 }
 
 // Begin the scanning process.
-std::list<std::shared_ptr<Token>>&& Scanner::scan_tokens() {
+Tokens Scanner::scan_tokens() {
     while (!is_at_end()) {
         // We are at the beginning of the next lexeme.
         scan_token();
     }
 
     // END token signalizes the end of the token stream.
-    add_token(Token_type::END, "", 0);
+    start = current;
+    add_token(Token_type::END);
     return std::move(tokens);
 }
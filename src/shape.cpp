@@ -0,0 +1,85 @@
+#include <atomic>
+
+#include "shape.h"
+#include "heap.h"
+
+// Source of the shape ids. Shared by all the interpreter instances of the
+// process, which may run on different threads.
+static std::atomic<uint64_t> next_shape_id(0);
+
+// Create an empty root shape.
+Shape::Shape()
+    : id(next_shape_id++), parent(nullptr), root(this), name(nullptr),
+      field_count(0) {}
+
+// Create the shape of the parent with one more field.
+Shape::Shape(Shape& parent, String* name)
+    : id(next_shape_id++), parent(&parent), root(parent.root), name(name),
+      field_count(parent.field_count + 1) {
+    if (field_count <= INDEXED_FIELDS)
+        return;
+
+    size_t index_size = 0;
+    if (parent.index != nullptr && parent.index->field_count == parent.field_count) {
+        // Extend the index of the parent's chain.
+        index = parent.index;
+        index_size = map_payload_size(index->slots);
+    } else {
+        // Build an index of its own, either because the parent has none or
+        // because a sibling already extended it.
+        index = std::make_shared<Index>();
+        for (Shape* shape = &parent; shape->parent != nullptr; shape = shape->parent)
+            index->slots[shape->name] = shape->field_count - 1;
+        root->tree_size += sizeof(Index);
+    }
+
+    index->slots[name] = field_count - 1;
+    index->field_count = field_count;
+    root->tree_size += map_payload_size(index->slots) - index_size;
+}
+
+// Free the descendants. Each shape gives its children to a work list
+// instead of freeing them, so a long chain of fields doesn't recurse once
+// per field.
+Shape::~Shape() {
+    std::vector<std::unique_ptr<Shape>> pending;
+    for (auto& transition : transitions)
+        pending.push_back(std::move(transition.second));
+    transitions.clear();
+
+    while (!pending.empty()) {
+        std::unique_ptr<Shape> shape = std::move(pending.back());
+        pending.pop_back();
+        for (auto& transition : shape->transitions)
+            pending.push_back(std::move(transition.second));
+        shape->transitions.clear();
+    }
+}
+
+// Get the shape with the field added, creating it if needed.
+Shape* Shape::add(String* name) {
+    auto transition = transitions.find(name);
+    if (transition != transitions.end())
+        return transition->second.get();
+
+    size_t transitions_size = map_payload_size(transitions);
+    Shape* shape = new Shape(*this, name);
+    transitions[name] = std::unique_ptr<Shape>(shape);
+    root->tree_size += sizeof(Shape) + map_payload_size(transitions)
+                       - transitions_size;
+    return shape;
+}
+
+// Mark the field names of this shape and all of its descendants.
+void Shape::trace(Heap& heap) {
+    std::vector<Shape*> pending{this};
+    while (!pending.empty()) {
+        Shape* shape = pending.back();
+        pending.pop_back();
+        // The other names are marked by the ancestors.
+        if (shape->name != nullptr)
+            heap.mark_object(shape->name);
+        for (auto& transition : shape->transitions)
+            pending.push_back(transition.second.get());
+    }
+}
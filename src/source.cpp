@@ -0,0 +1,52 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.h"
+
+// Map the file, or read it if it can't be mapped.
+Source_file::Source_file(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat stat_buf;
+    if (fstat(fd, &stat_buf) < 0) {
+        close(fd);
+        return;
+    }
+
+    if (S_ISREG(stat_buf.st_mode) && stat_buf.st_size > 0) {
+        void* address = mmap(nullptr, stat_buf.st_size, PROT_READ, MAP_PRIVATE,
+                             fd, 0);
+        if (address != MAP_FAILED) {
+            mapping = static_cast<char*>(address);
+            mapping_size = stat_buf.st_size;
+            // The file is scanned front to back, once.
+            madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+            text = std::string_view(mapping, mapping_size);
+            opened = true;
+            close(fd);
+            return;
+        }
+    }
+
+    char chunk[65536];
+    ssize_t count;
+    while ((count = read(fd, chunk, sizeof(chunk))) > 0)
+        buffer.append(chunk, count);
+    close(fd);
+
+    if (count < 0)
+        return;
+
+    text = buffer;
+    opened = true;
+}
+
+// Unmap the file.
+Source_file::~Source_file() {
+    if (mapping != nullptr)
+        munmap(mapping, mapping_size);
+}
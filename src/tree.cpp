@@ -0,0 +1,148 @@
+#include "tree.h"
+
+// Call the visitor method for the kind of the expression.
+void Ast::accept_expr(Expr_id expr, Expr_visitor& visitor) {
+    switch (expr_kind(expr)) {
+    case Expr_kind::BINARY:
+        visitor.visit_binary_expr(get<Binary_expr>(expr));
+        break;
+    case Expr_kind::LOGICAL:
+        visitor.visit_logical_expr(get<Logical_expr>(expr));
+        break;
+    case Expr_kind::UNARY:
+        visitor.visit_unary_expr(get<Unary_expr>(expr));
+        break;
+    case Expr_kind::GROUPING:
+        visitor.visit_grouping_expr(get<Grouping_expr>(expr));
+        break;
+    case Expr_kind::LITERAL:
+        visitor.visit_literal_expr(get<Literal_expr>(expr));
+        break;
+    case Expr_kind::VARIABLE:
+        visitor.visit_variable_expr(get<Variable_expr>(expr));
+        break;
+    case Expr_kind::ASSIGN:
+        visitor.visit_assign_expr(get<Assign_expr>(expr));
+        break;
+    case Expr_kind::CALL:
+        visitor.visit_call_expr(get<Call_expr>(expr));
+        break;
+    case Expr_kind::LAMBDA:
+        visitor.visit_lambda_expr(get<Lambda_expr>(expr));
+        break;
+    case Expr_kind::GET:
+        visitor.visit_get_expr(get<Get_expr>(expr));
+        break;
+    case Expr_kind::SET:
+        visitor.visit_set_expr(get<Set_expr>(expr));
+        break;
+    case Expr_kind::SUPER:
+        visitor.visit_super_expr(get<Super_expr>(expr));
+        break;
+    case Expr_kind::THIS:
+        visitor.visit_this_expr(get<This_expr>(expr));
+        break;
+    }
+}
+
+// Call the visitor method for the kind of the statement.
+void Ast::accept_stmt(Stmt_id stmt, Stmt_visitor& visitor) {
+    switch (stmt_kind(stmt)) {
+    case Stmt_kind::EXPRESSION:
+        visitor.visit_expression_stmt(get<Expression_stmt>(stmt));
+        break;
+    case Stmt_kind::PRINT:
+        visitor.visit_print_stmt(get<Print_stmt>(stmt));
+        break;
+    case Stmt_kind::VAR:
+        visitor.visit_var_stmt(get<Var_stmt>(stmt));
+        break;
+    case Stmt_kind::BLOCK:
+        visitor.visit_block_stmt(get<Block_stmt>(stmt));
+        break;
+    case Stmt_kind::IF:
+        visitor.visit_if_stmt(get<If_stmt>(stmt));
+        break;
+    case Stmt_kind::WHILE:
+        visitor.visit_while_stmt(get<While_stmt>(stmt));
+        break;
+    case Stmt_kind::FUNCTION:
+        visitor.visit_function_stmt(get<Function_stmt>(stmt));
+        break;
+    case Stmt_kind::RETURN:
+        visitor.visit_return_stmt(get<Return_stmt>(stmt));
+        break;
+    case Stmt_kind::CLASS:
+        visitor.visit_class_stmt(get<Class_stmt>(stmt));
+        break;
+    }
+}
+
+// Line a statement starts on, 0 if it has no tokens.
+uint32_t Ast::line_of(const Tokens& tokens, Stmt_id stmt) {
+    Token_id token = first_token_stmt(stmt);
+    return token == NO_TOKEN ? 0 : tokens.get_line(token);
+}
+
+// First token of an expression, NO_TOKEN if it has none.
+Token_id Ast::first_token_expr(Expr_id expr) {
+    switch (expr_kind(expr)) {
+    case Expr_kind::BINARY:
+        return first_token_expr(get<Binary_expr>(expr).get_left());
+    case Expr_kind::LOGICAL:
+        return first_token_expr(get<Logical_expr>(expr).get_left());
+    case Expr_kind::UNARY:
+        return get<Unary_expr>(expr).get_op();
+    case Expr_kind::GROUPING:
+        return first_token_expr(get<Grouping_expr>(expr).get_expr());
+    case Expr_kind::LITERAL:
+        return get<Literal_expr>(expr).get_literal();
+    case Expr_kind::VARIABLE:
+        return get<Variable_expr>(expr).get_name();
+    case Expr_kind::ASSIGN:
+        return get<Assign_expr>(expr).get_name();
+    case Expr_kind::CALL:
+        return first_token_expr(get<Call_expr>(expr).get_callee());
+    case Expr_kind::LAMBDA: {
+        Id_list body = get<Lambda_expr>(expr).get_body();
+        return body.empty() ? NO_TOKEN : first_token_stmt(get_list(body)[0]);
+    }
+    case Expr_kind::GET:
+        return first_token_expr(get<Get_expr>(expr).get_object());
+    case Expr_kind::SET:
+        return first_token_expr(get<Set_expr>(expr).get_object());
+    case Expr_kind::SUPER:
+        return get<Super_expr>(expr).get_keyword();
+    case Expr_kind::THIS:
+        return get<This_expr>(expr).get_keyword();
+    }
+    return NO_TOKEN;
+}
+
+// First token of a statement, NO_TOKEN if it has none.
+Token_id Ast::first_token_stmt(Stmt_id stmt) {
+    switch (stmt_kind(stmt)) {
+    case Stmt_kind::EXPRESSION:
+        return first_token_expr(get<Expression_stmt>(stmt).get_expr());
+    case Stmt_kind::PRINT:
+        return first_token_expr(get<Print_stmt>(stmt).get_expr());
+    case Stmt_kind::VAR:
+        return get<Var_stmt>(stmt).get_name();
+    case Stmt_kind::BLOCK: {
+        Id_list statements = get<Block_stmt>(stmt).get_statements();
+        return statements.empty()
+               ? NO_TOKEN : first_token_stmt(get_list(statements)[0]);
+    }
+    case Stmt_kind::IF:
+        return first_token_expr(get<If_stmt>(stmt).get_condition());
+    case Stmt_kind::WHILE:
+        return first_token_expr(get<While_stmt>(stmt).get_condition());
+    case Stmt_kind::FUNCTION:
+        return get<Function_stmt>(stmt).get_name();
+    case Stmt_kind::RETURN:
+        return get<Return_stmt>(stmt).get_keyword();
+    case Stmt_kind::CLASS:
+        return get<Class_stmt>(stmt).get_name();
+    }
+    return NO_TOKEN;
+}
@@ -0,0 +1,61 @@
+#include "value.h"
+#include "object.h"
+#include "function.h"
+#include "class.h"
+#include "instance.h"
+
+// Are two values equal.
+bool operator==(const Value& left, const Value& right) {
+    // Compare numbers as doubles so that NaN != NaN and 0 == -0.
+    if (left.is_number() && right.is_number())
+        return left.as_number() == right.as_number();
+
+    // Strings are interned, so every object compares by identity.
+    return left.bits == right.bits;
+}
+
+// Print out a function prototype the same way the tree-walker does.
+static std::ostream& print_function(std::ostream& os, Prototype* function) {
+    if (function->get_name() == nullptr)
+        return os << "<lambda>";
+    return os << "<fn " << function->get_name()->get_chars() << ">";
+}
+
+// Overloaded ostream operator for printing out the value.
+std::ostream& operator<<(std::ostream& os, const Value& value) {
+    if (value.is_nil())
+        return os << "nil";
+    if (value.is_bool())
+        return os << (value.as_bool() ? "true" : "false");
+    if (value.is_number())
+        return os << value.as_number();
+
+    Obj* obj = value.as_obj();
+    switch (obj->get_type()) {
+    case Obj_type::STRING:
+        return os << static_cast<String*>(obj)->get_chars();
+    case Obj_type::NATIVE:
+        return os << "<native fn>";
+    case Obj_type::PROTOTYPE:
+        return print_function(os, static_cast<Prototype*>(obj));
+    case Obj_type::CLOSURE:
+        return print_function(os, static_cast<Closure*>(obj)->get_function());
+    case Obj_type::UPVALUE:
+        return os << "upvalue";
+    case Obj_type::ENVIRONMENT:
+        return os << "<environment>";
+    case Obj_type::FUNCTION:
+        return os << "<fn " << static_cast<Function*>(obj)->get_name() << ">";
+    case Obj_type::LAMBDA:
+        return os << "<lambda>";
+    case Obj_type::CLASS:
+        return os << static_cast<Class*>(obj)->get_name();
+    case Obj_type::INSTANCE:
+        return os << static_cast<Instance*>(obj)->get_klass()->get_name()
+                  << " instance";
+    case Obj_type::BOUND_METHOD:
+        return print_function(os, static_cast<Bound_method*>(obj)->get_method()->get_function());
+    }
+
+    return os;
+}
@@ -0,0 +1,529 @@
+#include <cstdlib>
+#include <ostream>
+#include <utility>
+
+#include "vm.h"
+#include "class.h"
+#include "instance.h"
+#include "runtime_error.h"
+#include "error_handling.h"
+
+// VM constructor. Allocates the stacks and defines the native functions.
+Vm::Vm(Heap& heap, const Tokens& tokens, error_handling::Reporter& errors,
+       std::ostream& out)
+    : heap(heap), tokens(tokens), errors(errors), out(out), frames(FRAMES_MAX) {
+    // The stack is only touched as it grows, so the pages are mapped lazily.
+    // Slots above stack_top are never read. If the allocation fails, the
+    // error is reported when the script is run.
+    stack = static_cast<Value*>(std::calloc(STACK_MAX, sizeof(Value)));
+    stack_top = stack;
+
+    heap.add_roots(this);
+    define_native("clock", clock_native, 0);
+}
+
+// VM destructor. Frees the stack, the heap objects are owned by the Heap.
+Vm::~Vm() {
+    heap.remove_roots(this);
+    std::free(stack);
+}
+
+// Mark the stack, the call frames, the open upvalues and the globals.
+void Vm::mark_roots(Heap& heap) {
+    for (Value* slot = stack; slot < stack_top; slot++)
+        heap.mark_value(*slot);
+
+    for (uint32_t i = 0; i < frame_count; i++)
+        heap.mark_object(frames[i].closure);
+
+    for (Upvalue* upvalue = open_upvalues; upvalue != nullptr;
+         upvalue = upvalue->get_next_open())
+        heap.mark_object(upvalue);
+
+    for (auto& global : globals) {
+        heap.mark_object(global.first);
+        heap.mark_value(global.second);
+    }
+}
+
+// Define a native function in the global scope.
+void Vm::define_native(std::string name, Native::native_fn function,
+                       uint32_t arity) {
+    globals[heap.intern(name)] = Value(heap.allocate<Native>(function, arity));
+}
+
+// Throw a runtime error attributed to the current instruction.
+void Vm::runtime_error(std::string msg) {
+    Call_frame& frame = frames[frame_count - 1];
+    Chunk& chunk = frame.closure->get_function()->get_chunk();
+    size_t offset = frame.ip - chunk.get_code().data() - 1;
+
+    throw Runtime_error(msg, chunk.token_at(offset));
+}
+
+// Push a new call frame for the closure.
+void Vm::call(Closure* closure, int arg_count) {
+    if (static_cast<uint32_t>(arg_count) != closure->get_function()->get_arity())
+        runtime_error("Expected "
+                      + std::to_string(closure->get_function()->get_arity())
+                      + " arguments, but got " + std::to_string(arg_count)
+                      + "!");
+
+    Value* slots = stack_top - arg_count - 1;
+    if (frame_count == FRAMES_MAX
+        || closure->get_function()->get_max_stack() > STACK_MAX - (slots - stack))
+        runtime_error("Stack overflow!");
+
+    Call_frame& frame = frames[frame_count++];
+    frame.closure = closure;
+    frame.ip = closure->get_function()->get_chunk().get_code().data();
+    frame.slots = slots;
+}
+
+// Invoke a call operator on any callable value.
+void Vm::call_value(Value callee, int arg_count) {
+    if (callee.is_obj()) {
+        switch (callee.as_obj()->get_type()) {
+        case Obj_type::BOUND_METHOD: {
+            Bound_method* bound = static_cast<Bound_method*>(callee.as_obj());
+            stack_top[-arg_count - 1] = bound->get_receiver();
+            call(bound->get_method(), arg_count);
+            return;
+        }
+        case Obj_type::CLASS: {
+            Class* klass = static_cast<Class*>(callee.as_obj());
+            stack_top[-arg_count - 1] = Value(heap.allocate<Instance>(klass));
+
+            Obj* initializer = klass->get_initializer();
+            if (initializer != nullptr)
+                call(static_cast<Closure*>(initializer), arg_count);
+            else if (arg_count != 0)
+                runtime_error("Expected 0 arguments, but got "
+                              + std::to_string(arg_count) + "!");
+            return;
+        }
+        case Obj_type::CLOSURE:
+            call(static_cast<Closure*>(callee.as_obj()), arg_count);
+            return;
+        case Obj_type::NATIVE: {
+            Native* native = static_cast<Native*>(callee.as_obj());
+            if (static_cast<uint32_t>(arg_count) != native->arity())
+                runtime_error("Expected " + std::to_string(native->arity())
+                              + " arguments, but got "
+                              + std::to_string(arg_count) + "!");
+
+            Value result = native->get_function()(arg_count,
+                                                  stack_top - arg_count);
+            stack_top -= arg_count + 1;
+            push(result);
+            return;
+        }
+        default:
+            break;
+        }
+    }
+
+    runtime_error("Can call only functions and classes!");
+}
+
+// Replace the instance on top of the stack with its method bound to it.
+bool Vm::bind_method(Class* klass, String* name) {
+    Obj* method = klass->find_method(name);
+    if (method == nullptr)
+        return false;
+
+    Bound_method* bound
+            = heap.allocate<Bound_method>(peek(0), static_cast<Closure*>(method));
+    pop();
+    push(Value(bound));
+    return true;
+}
+
+// Get the upvalue for the stack slot, creating it if needed.
+Upvalue* Vm::capture_upvalue(Value* local) {
+    Upvalue* prev = nullptr;
+    Upvalue* upvalue = open_upvalues;
+    while (upvalue != nullptr && upvalue->get_location() > local) {
+        prev = upvalue;
+        upvalue = upvalue->get_next_open();
+    }
+
+    if (upvalue != nullptr && upvalue->get_location() == local)
+        return upvalue;
+
+    Upvalue* created = heap.allocate<Upvalue>(local);
+    created->set_next_open(upvalue);
+    if (prev == nullptr)
+        open_upvalues = created;
+    else
+        prev->set_next_open(created);
+
+    return created;
+}
+
+// Close all the open upvalues which point at or above the stack slot.
+void Vm::close_upvalues(Value* last) {
+    while (open_upvalues != nullptr && open_upvalues->get_location() >= last) {
+        Upvalue* upvalue = open_upvalues;
+        upvalue->close();
+        open_upvalues = upvalue->get_next_open();
+    }
+}
+
+// Attribute the following allocations to the line of the current
+// instruction.
+void Vm::track_site() {
+    Call_frame& frame = frames[frame_count - 1];
+    Chunk& chunk = frame.closure->get_function()->get_chunk();
+    size_t offset = frame.ip - chunk.get_code().data() - 1;
+    heap.get_allocation_sites()->set_line(tokens.get_line(chunk.token_at(offset)));
+}
+
+// Record a profiler sample of the call frames. The ip of every frame has to
+// be stored.
+void Vm::sample_frames() {
+    profiled_frames.clear();
+    for (uint32_t i = 0; i < frame_count; i++) {
+        Prototype* function = frames[i].closure->get_function();
+        Chunk& chunk = function->get_chunk();
+        // The ip is past the instruction being executed.
+        size_t offset = frames[i].ip - chunk.get_code().data() - 1;
+
+        std::string_view name = i == 0 ? "<script>" : "<lambda>";
+        if (function->get_name() != nullptr)
+            name = function->get_name()->get_chars();
+        profiled_frames.push_back(
+                Profiler::Frame{name, tokens.get_line(chunk.token_at(offset))});
+    }
+    profiler->record(profiled_frames);
+}
+
+// Execute instructions until the top-level script returns.
+void Vm::run() {
+    Call_frame* frame = &frames[frame_count - 1];
+    // Cached copy of frame->ip, written back whenever the frame may change
+    // or an error may be reported.
+    uint8_t* ip = frame->ip;
+    Value* constants = frame->closure->get_function()->get_chunk().get_constants().data();
+    // High bits of the next operand, set by LONG prefixes.
+    uint32_t long_operand = 0;
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, static_cast<uint16_t>((ip[-2] << 8) | ip[-1]))
+// Operands extended by the preceding LONG prefixes.
+#define READ_LONG_BYTE() ((std::exchange(long_operand, 0) << 8) | READ_BYTE())
+#define READ_LONG_SHORT() ((std::exchange(long_operand, 0) << 16) | READ_SHORT())
+#define READ_CONSTANT() (constants[READ_LONG_SHORT()])
+#define READ_STRING() (static_cast<String*>(READ_CONSTANT().as_obj()))
+#define STORE_FRAME() (frame->ip = ip)
+#define LOAD_FRAME()                                                          \
+    do {                                                                      \
+        frame = &frames[frame_count - 1];                                     \
+        ip = frame->ip;                                                       \
+        constants = frame->closure->get_function()->get_chunk().get_constants().data(); \
+    } while (false)
+#define ERROR(msg)                                                            \
+    do {                                                                      \
+        STORE_FRAME();                                                        \
+        runtime_error(msg);                                                   \
+    } while (false)
+// Only the instructions which allocate track their line.
+#define TRACK_SITE()                                                          \
+    do {                                                                      \
+        if (heap.get_allocation_sites() != nullptr) {                         \
+            STORE_FRAME();                                                    \
+            track_site();                                                     \
+        }                                                                     \
+    } while (false)
+#define BINARY_OP(op)                                                         \
+    do {                                                                      \
+        if (!peek(0).is_number() || !peek(1).is_number())                     \
+            ERROR("Operands must be numbers!");                               \
+        double right = pop().as_number();                                     \
+        double left = pop().as_number();                                      \
+        push(Value(left op right));                                           \
+    } while (false)
+
+    while (true) {
+        switch (static_cast<Op_code>(READ_BYTE())) {
+        case Op_code::CONSTANT:
+            push(READ_CONSTANT());
+            break;
+        case Op_code::NIL: push(Value()); break;
+        case Op_code::TRUE: push(Value(true)); break;
+        case Op_code::FALSE: push(Value(false)); break;
+        case Op_code::POP: pop(); break;
+        case Op_code::GET_LOCAL:
+            push(frame->slots[READ_LONG_BYTE()]);
+            break;
+        case Op_code::SET_LOCAL:
+            frame->slots[READ_LONG_BYTE()] = peek(0);
+            break;
+        case Op_code::GET_GLOBAL: {
+            String* name = READ_STRING();
+            auto global = globals.find(name);
+            if (global == globals.end())
+                ERROR("Undefined variable " + name->get_chars() + "!");
+            push(global->second);
+            break;
+        }
+        case Op_code::DEFINE_GLOBAL: {
+            String* name = READ_STRING();
+            globals[name] = peek(0);
+            pop();
+            break;
+        }
+        case Op_code::SET_GLOBAL: {
+            String* name = READ_STRING();
+            auto global = globals.find(name);
+            if (global == globals.end())
+                ERROR("Undefined variable " + name->get_chars() + "!");
+            global->second = peek(0);
+            break;
+        }
+        case Op_code::GET_UPVALUE:
+            push(*frame->closure->get_upvalues()[READ_LONG_BYTE()]->get_location());
+            break;
+        case Op_code::SET_UPVALUE:
+            *frame->closure->get_upvalues()[READ_LONG_BYTE()]->get_location() = peek(0);
+            break;
+        case Op_code::GET_PROPERTY: {
+            String* name = READ_STRING();
+            if (!is_obj_type(peek(0), Obj_type::INSTANCE))
+                ERROR("Only instances have properties!");
+
+            Instance* instance = static_cast<Instance*>(peek(0).as_obj());
+            Value field;
+            if (instance->get_field(name, field)) {
+                pop();
+                push(field);
+                break;
+            }
+
+            TRACK_SITE();
+            if (!bind_method(instance->get_klass(), name))
+                ERROR("Undefined property '" + name->get_chars() + "'.");
+            break;
+        }
+        case Op_code::SET_PROPERTY: {
+            String* name = READ_STRING();
+            if (!is_obj_type(peek(1), Obj_type::INSTANCE))
+                ERROR("Only instances have fields!");
+
+            Instance* instance = static_cast<Instance*>(peek(1).as_obj());
+            Shape* shape = instance->get_shape();
+            instance->set_field(name, peek(0));
+            if (instance->get_shape() != shape) {
+                heap.resize(instance);
+                // The class owns the shapes, which may have grown.
+                heap.resize(instance->get_klass());
+            }
+            Value value = pop();
+            pop();
+            push(value);
+            break;
+        }
+        case Op_code::GET_SUPER: {
+            String* name = READ_STRING();
+            Class* superclass = static_cast<Class*>(pop().as_obj());
+            TRACK_SITE();
+            if (!bind_method(superclass, name))
+                ERROR("Undefined property '" + name->get_chars() + "'!");
+            break;
+        }
+        case Op_code::EQUAL: {
+            Value right = pop();
+            Value left = pop();
+            push(Value(left == right));
+            break;
+        }
+        case Op_code::GREATER: BINARY_OP(>); break;
+        case Op_code::GREATER_EQUAL: BINARY_OP(>=); break;
+        case Op_code::LESS: BINARY_OP(<); break;
+        case Op_code::LESS_EQUAL: BINARY_OP(<=); break;
+        case Op_code::ADD: {
+            if (is_obj_type(peek(0), Obj_type::STRING)
+                && is_obj_type(peek(1), Obj_type::STRING)) {
+                String* right = static_cast<String*>(peek(0).as_obj());
+                String* left = static_cast<String*>(peek(1).as_obj());
+                String* result = heap.intern(left->get_chars()
+                                             + right->get_chars());
+                pop();
+                pop();
+                push(Value(result));
+            } else if (peek(0).is_number() && peek(1).is_number()) {
+                double right = pop().as_number();
+                double left = pop().as_number();
+                push(Value(left + right));
+            } else
+                ERROR("Operands must be two numbers or two strings!");
+            break;
+        }
+        case Op_code::SUBTRACT: BINARY_OP(-); break;
+        case Op_code::MULTIPLY: BINARY_OP(*); break;
+        case Op_code::DIVIDE: BINARY_OP(/); break;
+        case Op_code::NOT:
+            push(Value(!pop().is_truthy()));
+            break;
+        case Op_code::NEGATE:
+            if (!peek(0).is_number())
+                ERROR("Operand must be a number!");
+            push(Value(-pop().as_number()));
+            break;
+        case Op_code::PRINT:
+            out << pop() << std::endl;
+            break;
+        case Op_code::JUMP: {
+            uint32_t offset = READ_LONG_SHORT();
+            ip += offset;
+            break;
+        }
+        case Op_code::JUMP_IF_FALSE: {
+            uint32_t offset = READ_LONG_SHORT();
+            if (!peek(0).is_truthy())
+                ip += offset;
+            break;
+        }
+        // Backward jumps and calls are the collector's and the profiler's
+        // safe points: every live object is reachable from the stack there,
+        // and any unbounded allocation or loop has to pass through one of
+        // them.
+        case Op_code::LOOP: {
+            uint32_t offset = READ_LONG_SHORT();
+            ip -= offset;
+            heap.maybe_collect();
+            if (profiler != nullptr && profiler->is_sample_due()) {
+                STORE_FRAME();
+                sample_frames();
+            }
+            break;
+        }
+        case Op_code::CALL: {
+            int arg_count = READ_BYTE();
+            heap.maybe_collect();
+            STORE_FRAME();
+            if (profiler != nullptr && profiler->is_sample_due())
+                sample_frames();
+            if (heap.get_allocation_sites() != nullptr)
+                track_site();
+            call_value(peek(arg_count), arg_count);
+            LOAD_FRAME();
+            break;
+        }
+        case Op_code::CLOSURE: {
+            Prototype* function = static_cast<Prototype*>(READ_CONSTANT().as_obj());
+            TRACK_SITE();
+            Closure* closure = heap.allocate<Closure>(function);
+            push(Value(closure));
+
+            std::vector<Upvalue*>& upvalues = closure->get_upvalues();
+            for (uint32_t i = 0; i < upvalues.size(); i++) {
+                uint8_t is_local = READ_BYTE();
+                uint16_t index = READ_SHORT();
+                if (is_local)
+                    upvalues[i] = capture_upvalue(frame->slots + index);
+                else
+                    upvalues[i] = frame->closure->get_upvalues()[index];
+            }
+            break;
+        }
+        case Op_code::CLOSE_UPVALUE:
+            close_upvalues(stack_top - 1);
+            pop();
+            break;
+        // Returns are a profiler safe point too, so that a leaf function
+        // without loops gets the ticks seen while it ran, not its caller.
+        case Op_code::RETURN: {
+            if (profiler != nullptr && profiler->is_sample_due()) {
+                STORE_FRAME();
+                sample_frames();
+            }
+            Value result = pop();
+            close_upvalues(frame->slots);
+            frame_count--;
+            if (frame_count == 0) {
+                pop();
+                return;
+            }
+
+            stack_top = frame->slots;
+            push(result);
+            LOAD_FRAME();
+            break;
+        }
+        case Op_code::CLASS: {
+            TRACK_SITE();
+            // The instruction is attributed to the name of the class.
+            Chunk& chunk = frame->closure->get_function()->get_chunk();
+            uint32_t line = tokens.get_line(
+                    chunk.token_at(ip - chunk.get_code().data() - 1));
+            push(Value(heap.allocate<Class>(READ_STRING()->get_chars(), line,
+                                            nullptr, Class::method_map())));
+            break;
+        }
+        case Op_code::INHERIT: {
+            if (!is_obj_type(peek(1), Obj_type::CLASS))
+                ERROR("Superclass must be a class!");
+
+            Class* superclass = static_cast<Class*>(peek(1).as_obj());
+            Class* subclass = static_cast<Class*>(peek(0).as_obj());
+            // Copy the inherited methods down so that the lookups never
+            // have to walk the superclass chain.
+            subclass->get_methods().insert(superclass->get_methods().begin(),
+                                           superclass->get_methods().end());
+            heap.resize(subclass);
+            subclass->set_superclass(superclass);
+            subclass->set_initializer(superclass->get_initializer());
+            pop();
+            break;
+        }
+        case Op_code::METHOD: {
+            String* name = READ_STRING();
+            Class* klass = static_cast<Class*>(peek(1).as_obj());
+            klass->get_methods()[name] = peek(0);
+            heap.resize(klass);
+            if (name == heap.get_init_string())
+                klass->set_initializer(peek(0).as_obj());
+            pop();
+            break;
+        }
+        case Op_code::LONG:
+            long_operand = (long_operand << 8) | READ_BYTE();
+            break;
+        }
+    }
+
+#undef BINARY_OP
+#undef TRACK_SITE
+#undef ERROR
+#undef LOAD_FRAME
+#undef STORE_FRAME
+#undef READ_STRING
+#undef READ_CONSTANT
+#undef READ_LONG_SHORT
+#undef READ_LONG_BYTE
+#undef READ_SHORT
+#undef READ_BYTE
+}
+
+// Start the VM run.
+void Vm::interpret(Prototype* script) {
+    if (stack == nullptr) {
+        errors.error(0, "Not enough memory for the VM stack!");
+        return;
+    }
+
+    Closure* closure = heap.allocate<Closure>(script);
+    push(Value(closure));
+
+    try {
+        call(closure, 0);
+        run();
+    } catch (Runtime_error& e) {
+        errors.error(tokens, e.get_token(), e.what());
+
+        stack_top = stack;
+        frame_count = 0;
+        open_upvalues = nullptr;
+    }
+}
@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Run generated scripts on every engine and compare their output.
+
+The scripts exceed the limits of the narrow bytecode operands: functions
+with hundreds of locals and captured variables, and branches and loops
+over more code than a u16 jump offset reaches. Others recurse past the
+call depth limit, or give instances thousands of fields. Every engine has to print the expected output, and exit
+with the expected status, for each of them.
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+
+ENGINES = ["tree", "closure", "vm"]
+
+
+def many_locals(count):
+    """A function with more locals than a u8 slot operand addresses."""
+    lines = ["fun f() {"]
+    lines += ["  var v{} = {};".format(i, i) for i in range(count)]
+    lines += ["  v{} = v{} + v0;".format(count - 1, count - 1),
+              "  print v{};".format(count - 1),
+              "}",
+              "f();"]
+    return "\n".join(lines) + "\n", "{}\n".format(count - 1), 0
+
+
+def many_captures(count):
+    """Closures capturing more variables than a u8 upvalue operand
+    addresses, directly and through an intermediate function."""
+    lines = ["fun outer() {"]
+    lines += ["  var c{} = {};".format(i, i) for i in range(count)]
+    lines += ["  fun sum() {",
+              "    return " + " + ".join("c{}".format(i)
+                                         for i in range(count)) + ";",
+              "  }",
+              "  fun middle() {",
+              "    fun inner() {",
+              "      c{0} = c{0} + 1;".format(count - 1),
+              "      return c{};".format(count - 1),
+              "    }",
+              "    return inner;",
+              "  }",
+              "  print sum();",
+              "  print middle()();",
+              "}",
+              "outer();"]
+    return "\n".join(lines) + "\n", "{}\n{}\n".format(
+        count * (count - 1) // 2, count), 0
+
+
+def long_jumps(statements):
+    """Branches and loops over more code than a u16 offset reaches, at the
+    top level and in a function."""
+    body = ["  x = x + {};".format(i % 10) for i in range(statements)]
+    total = sum(i % 10 for i in range(statements))
+    lines = ["var x = 0;",
+             "if (x == 0) {"] + body + ["} else {",
+             "  print \"else\";",
+             "}",
+             "print x;",
+             "fun loop() {",
+             "  var i = 0;",
+             "  while (i < 2) {"] + ["  " + line for line in body] + [
+             "    i = i + 1;",
+             "  }",
+             "  return x > 0 and i == 2;",
+             "}",
+             "print loop();",
+             "print x;"]
+    return "\n".join(lines) + "\n", "{}\ntrue\n{}\n".format(total, 3 * total), 0
+
+
+def deep_recursion(depth):
+    """Calls as deep as the call stack allows, then unbounded recursion,
+    which has to fail with a stack overflow instead of crashing."""
+    source = ("fun f(n) {{ if (n == {}) return n; return f(n + 1); }}\n"
+              "print f(0);\n"
+              "fun g(n) {{ return g(n + 1); }}\n"
+              "g(0);\n").format(depth)
+    return source, "{}\n[line 3] Error at ')': Stack overflow!\n".format(depth), 1
+
+
+def many_fields(count):
+    """Instances with thousands of fields, the second one sharing all but
+    the last few shapes of the first one."""
+    lines = ["class P {}", "var p = P();", "var q = P();"]
+    lines += ["p.f{} = {};".format(i, i) for i in range(count)]
+    lines += ["q.f{} = {};".format(i, i) for i in range(count - 3)]
+    lines += ["q.g = -1;",
+              "print p.f{} + p.f0;".format(count - 1),
+              "print q.f{} + q.g;".format(count - 4),
+              "print q.f{};".format(count - 1)]
+    return "\n".join(lines) + "\n", "{}\n{}\n[line {}] Error at 'f{}': " \
+        "Undefined property 'f{}'.\n".format(
+            count - 1, count - 5, len(lines), count - 1, count - 1), 1
+
+
+CHECKS = {
+    "many_locals": many_locals(300),
+    "many_captures": many_captures(400),
+    "long_jumps": long_jumps(20000),
+    # The top-level script takes one of the 16384 frames.
+    "deep_recursion": deep_recursion(16382),
+    "many_fields": many_fields(20000),
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--binary", required=True)
+    args = parser.parse_args()
+
+    failed = 0
+    with tempfile.TemporaryDirectory() as directory:
+        for name, (source, expected, status) in CHECKS.items():
+            script = os.path.join(directory, name + ".lox")
+            with open(script, "w") as f:
+                f.write(source)
+
+            for engine in ENGINES:
+                result = subprocess.run(
+                    [args.binary, "--engine=" + engine, script],
+                    stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+                output = result.stdout.decode(errors="replace")
+                if result.returncode != status or output != expected:
+                    failed += 1
+                    print("FAIL {} ({}): exit code {}, output:\n{}".format(
+                        name, engine, result.returncode, output))
+                else:
+                    print("ok   {} ({})".format(name, engine))
+
+    if failed:
+        sys.exit("{} checks failed".format(failed))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,80 @@
+// Run scripts which recurse without bound through isolates of every engine,
+// at the same time on separate threads. Every run has to fail with a stack
+// overflow error instead of taking the process down, and the process has
+// to keep running scripts afterwards.
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "isolate.h"
+
+struct Check {
+    const char* name;
+    Engine engine;
+    std::string source;
+    std::string expected;
+};
+
+// Run the source in a new isolate, returns whether the run succeeded and
+// what it printed (errors included).
+static bool run(Engine engine, const std::string& source, std::string& output) {
+    std::ostringstream out;
+    Options options;
+    options.engine = engine;
+    options.out = &out;
+    options.errors = &out;
+
+    Isolate isolate(options);
+    bool ok = isolate.load_source(source) && isolate.run();
+    output = out.str();
+    return ok;
+}
+
+int main() {
+    const std::string recursion = "fun f(n) { return f(n + 1); }\nf(0);\n";
+    const std::string overflow = "[line 1] Error at ')': Stack overflow!\n";
+
+    std::vector<Check> checks = {
+        {"tree", Engine::TREE_WALKER, recursion, overflow},
+        {"closure", Engine::CLOSURE, recursion, overflow},
+        {"vm", Engine::VM, recursion, overflow},
+    };
+
+    std::vector<std::thread> threads;
+    std::vector<std::string> outputs(checks.size());
+    std::vector<char> results(checks.size());
+    for (size_t i = 0; i < checks.size(); i++)
+        threads.emplace_back([&, i]() {
+            results[i] = run(checks[i].engine, checks[i].source, outputs[i]);
+        });
+    for (std::thread& thread : threads)
+        thread.join();
+
+    int failed = 0;
+    for (size_t i = 0; i < checks.size(); i++) {
+        if (results[i] || outputs[i] != checks[i].expected) {
+            std::cout << "FAIL isolate deep_recursion (" << checks[i].name
+                      << "): " << outputs[i] << std::endl;
+            failed++;
+        } else
+            std::cout << "ok   isolate deep_recursion (" << checks[i].name
+                      << ")" << std::endl;
+    }
+
+    // The process survived, and still runs scripts.
+    for (Check& check : checks) {
+        std::string output;
+        if (!run(check.engine, "print 1 + 2;", output) || output != "3\n") {
+            std::cout << "FAIL isolate after_overflow (" << check.name
+                      << "): " << output << std::endl;
+            failed++;
+        } else
+            std::cout << "ok   isolate after_overflow (" << check.name << ")"
+                      << std::endl;
+    }
+
+    return failed == 0 ? 0 : 1;
+}